@@ -0,0 +1,129 @@
+/*
+ * bench-batch.c
+ *
+ * Compares adding a large selection to the queue one command at a
+ * time (the way gimmix used to do it through libmpd) with a single
+ * GimmixBatch commit.
+ *
+ * usage: bench-batch [count]
+ * The server is taken from MPD_HOST / MPD_PORT / MPD_PASSWORD.
+ * WARNING: the queue of that server is cleared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libmpd/libmpd.h>
+
+#include "gimmix-batch.h"
+#include "gimmix-mpdio.h"
+
+MpdObj		*gmo = NULL;
+
+static GMainLoop	*loop;
+static GPtrArray	*files;
+
+static void
+cb_listall (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	int i;
+
+	if (reply->ok)
+	{
+		for (i = 0; reply->lines[i] != NULL; i++)
+		{
+			if (!strncmp (reply->lines[i], "file: ", 6))
+				g_ptr_array_add (files, g_strdup (reply->lines[i] + 6));
+		}
+	}
+	else
+	{
+		fprintf (stderr, "listall failed: %s\n", reply->error);
+	}
+	g_main_loop_quit (loop);
+
+	return;
+}
+
+static void
+cb_batch_done (gboolean ok, const char *error, G_GNUC_UNUSED gpointer data)
+{
+	if (!ok)
+		fprintf (stderr, "batch failed: %s\n", error);
+	g_main_loop_quit (loop);
+
+	return;
+}
+
+int
+main (int argc, char **argv)
+{
+	const char	*host;
+	const char	*pass;
+	int		port;
+	guint		count = 10000;
+	guint		i;
+	GTimer		*timer;
+	GimmixBatch	*batch;
+	MpdObj		*mo;
+	gdouble		single;
+	gdouble		batched;
+
+	if (argc > 1)
+		count = atoi (argv[1]);
+	host = g_getenv ("MPD_HOST") ? g_getenv ("MPD_HOST") : "localhost";
+	port = g_getenv ("MPD_PORT") ? atoi (g_getenv ("MPD_PORT")) : 6600;
+	pass = g_getenv ("MPD_PASSWORD");
+
+	loop = g_main_loop_new (NULL, FALSE);
+	files = g_ptr_array_new_with_free_func (g_free);
+	gimmix_mpdio_start (host, port, pass, -1);
+
+	gimmix_mpdio_command (cb_listall, NULL, "listall");
+	g_main_loop_run (loop);
+	if (files->len == 0)
+	{
+		fprintf (stderr, "no songs in the database\n");
+		return 1;
+	}
+
+	/* one round trip per song plus a status update, like before */
+	mo = mpd_new ((char*)host, port, (char*)pass);
+	if (mpd_connect (mo) != MPD_OK)
+	{
+		fprintf (stderr, "could not connect to %s:%d\n", host, port);
+		return 1;
+	}
+	mpd_send_password (mo);
+	mpd_playlist_clear (mo);
+	timer = g_timer_new ();
+	for (i = 0; i < count; i++)
+	{
+		mpd_playlist_add (mo, g_ptr_array_index (files, i % files->len));
+		mpd_status_update (mo);
+	}
+	single = g_timer_elapsed (timer, NULL);
+	mpd_playlist_clear (mo);
+
+	/* one command list, one status update */
+	gmo = mo;
+	g_timer_start (timer);
+	batch = gimmix_batch_new ();
+	for (i = 0; i < count; i++)
+		gimmix_batch_add (batch, g_ptr_array_index (files, i % files->len));
+	gimmix_batch_commit (batch, cb_batch_done, NULL);
+	g_main_loop_run (loop);
+	batched = g_timer_elapsed (timer, NULL);
+	mpd_playlist_clear (mo);
+
+	printf ("%u songs: single %.3fs, batched %.3fs (%.1fx)\n",
+		count, single, batched, batched > 0 ? single / batched : 0.0);
+
+	gimmix_mpdio_stop ();
+	mpd_free (mo);
+	g_timer_destroy (timer);
+	g_ptr_array_free (files, TRUE);
+	g_main_loop_unref (loop);
+
+	return 0;
+}
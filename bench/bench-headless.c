@@ -0,0 +1,471 @@
+/*
+ * bench-headless.c
+ *
+ * Drives the status, playlist, queue sorting, library, search and tag
+ * browser code paths the way
+ * gimmix does, without a display, and reports the time and memory
+ * each of them takes. The requests go through the I/O thread and
+ * their replies through the parsers the interface uses. Meant to be
+ * run against mock-mpd, see run-bench.sh.
+ *
+ * usage: bench-headless [rounds]
+ * The server is taken from MPD_HOST / MPD_PORT / MPD_PASSWORD.
+ * WARNING: songs are appended to the queue of that server.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <glib/gstdio.h>
+#include <libmpd/libmpd.h>
+
+#include "gimmix-batch.h"
+#include "gimmix-mpdio.h"
+#include "gimmix-queue.h"
+#include "gimmix-library.h"
+#include "gimmix-tags.h"
+#include "gimmix-intern.h"
+#include "gimmix-sort.h"
+#include "gimmix-reorder.h"
+
+#define LIBRARY_DIRS	20
+#define BATCH_SONGS	1000
+
+MpdObj		*gmo = NULL;
+
+static GMainLoop	*loop;
+
+/* resident set size in KiB */
+static glong
+bench_rss (void)
+{
+	FILE	*fp;
+	glong	pages = 0;
+	glong	resident = 0;
+
+	if ((fp = fopen ("/proc/self/statm", "r")) == NULL)
+		return 0;
+	if (fscanf (fp, "%ld %ld", &pages, &resident) != 2)
+		resident = 0;
+	fclose (fp);
+
+	return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static glong
+bench_peak_rss (void)
+{
+	struct rusage usage;
+
+	getrusage (RUSAGE_SELF, &usage);
+
+	return usage.ru_maxrss;
+}
+
+static void
+bench_report (const char *phase, guint rounds, guint items, GTimer *timer, glong rss_before)
+{
+	gdouble secs = g_timer_elapsed (timer, NULL);
+
+	printf ("%-10s %6u rounds %9u items %10.2f ms %9.3f ms/round %+9ld KiB\n",
+		phase, rounds, items, secs * 1000, rounds ? secs * 1000 / rounds : 0.0,
+		bench_rss () - rss_before);
+
+	return;
+}
+
+/* what the string pool holds and how much copying it avoids */
+static void
+bench_intern_report (void)
+{
+	guint	strings;
+	gsize	bytes;
+	gsize	saved;
+
+	gimmix_intern_get_stats (&strings, &bytes, &saved);
+	printf ("%-10s %u pooled strings, %lu KiB pooled, %lu KiB saved\n", "",
+		strings, (gulong)(bytes / 1024), (gulong)(saved / 1024));
+
+	return;
+}
+
+/* what the request callbacks of a phase count */
+static guint		bench_items;
+static guint		bench_left;	/* rounds still to send */
+static guint		bench_pending;	/* requests on their way */
+static guint		bench_budget;	/* directories still to open */
+static GPtrArray	*bench_queue;	/* mpd_Song * of the last playlistinfo */
+
+/* send the next round of a phase, or end it */
+static void
+bench_next (GimmixMpdCallback cb, const char *command)
+{
+	if (--bench_left > 0)
+		gimmix_mpdio_command (cb, NULL, "%s", command);
+	else
+		g_main_loop_quit (loop);
+
+	return;
+}
+
+/* the periodic status poll, one at a time like the interface */
+static void
+cb_status_polled (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	if (!reply->ok)
+		fprintf (stderr, "status: %s\n", reply->error);
+	bench_items++;
+	bench_next (cb_status_polled, "status");
+
+	return;
+}
+
+static void
+cb_playlist_listed (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	if (reply->ok)
+	{
+		if (bench_queue != NULL)
+			g_ptr_array_free (bench_queue, TRUE);
+		bench_queue = gimmix_queue_parse (reply);
+		bench_items += bench_queue->len;
+	}
+	else
+		fprintf (stderr, "playlistinfo: %s\n", reply->error);
+	bench_next (cb_playlist_listed, "playlistinfo");
+
+	return;
+}
+
+static void bench_list (const char *path);
+
+/* a directory has been listed, open the directories in it like the
+ * user expanding them in the library browser, at most bench_budget */
+static void
+cb_library_listed (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	GPtrArray	*entries;
+	guint		i;
+
+	if (reply->ok)
+	{
+		entries = gimmix_library_parse_listing (reply);
+		bench_items += entries->len;
+		for (i = 0; i < entries->len && bench_budget > 0; i++)
+		{
+			GimmixLibraryEntry *entry = g_ptr_array_index (entries, i);
+
+			if (entry->type == GIMMIX_FILE_DIR)
+			{
+				bench_budget--;
+				bench_list (entry->path);
+			}
+		}
+		g_ptr_array_free (entries, TRUE);
+	}
+	else
+		fprintf (stderr, "lsinfo: %s\n", reply->error);
+	if (--bench_pending == 0)
+		g_main_loop_quit (loop);
+
+	return;
+}
+
+static void
+bench_list (const char *path)
+{
+	gchar *arg;
+
+	arg = gimmix_mpd_quote (path);
+	bench_pending++;
+	gimmix_mpdio_command (cb_library_listed, NULL, "lsinfo %s", arg);
+	g_free (arg);
+
+	return;
+}
+
+static void
+cb_library_searched (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	GPtrArray *songs;
+
+	if (reply->ok)
+	{
+		songs = gimmix_queue_parse (reply);
+		bench_items += songs->len;
+		g_ptr_array_free (songs, TRUE);
+	}
+	else
+		fprintf (stderr, "search: %s\n", reply->error);
+	if (--bench_pending == 0)
+		g_main_loop_quit (loop);
+
+	return;
+}
+
+/* the search box, quoted the way the interface does */
+static void
+bench_search (const char *tag, const char *text)
+{
+	gchar *arg;
+
+	arg = gimmix_mpd_quote (text);
+	bench_pending++;
+	gimmix_mpdio_command (cb_library_searched, NULL, "search %s %s", tag, arg);
+	g_free (arg);
+
+	return;
+}
+
+static guint		window_rows;
+static guint		window_pages;
+
+static void
+cb_window_fill (G_GNUC_UNUSED guint first, GPtrArray *songs, G_GNUC_UNUSED gpointer data)
+{
+	window_rows += songs->len;
+	if (--window_pages == 0)
+		g_main_loop_quit (loop);
+
+	return;
+}
+
+static void
+cb_tags_ready (G_GNUC_UNUSED gpointer data)
+{
+	g_main_loop_quit (loop);
+
+	return;
+}
+
+static void
+cb_batch_done (gboolean ok, const char *error, G_GNUC_UNUSED gpointer data)
+{
+	if (!ok)
+		fprintf (stderr, "batch failed: %s\n", error);
+	g_main_loop_quit (loop);
+
+	return;
+}
+
+int
+main (int argc, char **argv)
+{
+	const char	*host;
+	const char	*pass;
+	int		port;
+	guint		rounds = 100;
+	guint		items;
+	guint		i;
+	GTimer		*timer;
+	GimmixBatch	*batch;
+	MpdObj		*mo;
+	glong		rss;
+	GPtrArray	*values;
+	GPtrArray	*pooled;
+	gchar		*tags_path;
+	GimmixSortCache	*sort;
+	GArray		*ids;
+	gint		*order;
+	gint		*sorted;
+	GArray		*moves;
+
+	if (argc > 1)
+		rounds = atoi (argv[1]);
+	host = g_getenv ("MPD_HOST") ? g_getenv ("MPD_HOST") : "localhost";
+	port = g_getenv ("MPD_PORT") ? atoi (g_getenv ("MPD_PORT")) : 6600;
+	pass = g_getenv ("MPD_PASSWORD");
+
+	loop = g_main_loop_new (NULL, FALSE);
+	timer = g_timer_new ();
+	printf ("%-10s %6s %16s %13s %19s %13s\n", "phase", "", "", "total", "", "rss delta");
+
+	/* connect, libmpd fetches status, stats and the command list */
+	rss = bench_rss ();
+	g_timer_start (timer);
+	mo = mpd_new ((char*)host, port, (char*)pass);
+	if (mpd_connect (mo) != MPD_OK)
+	{
+		fprintf (stderr, "could not connect to %s:%d\n", host, port);
+		return 1;
+	}
+	mpd_send_password (mo);
+	gmo = mo;
+	if (!gimmix_mpdio_start (host, port, pass, -1))
+	{
+		fprintf (stderr, "could not start the I/O thread\n");
+		return 1;
+	}
+	bench_report ("connect", 1, 1, timer, rss);
+
+	/* the periodic status poll */
+	rss = bench_rss ();
+	g_timer_start (timer);
+	bench_items = 0;
+	bench_left = MAX (rounds, 1);
+	gimmix_mpdio_command (cb_status_polled, NULL, "status");
+	g_main_loop_run (loop);
+	bench_report ("status", MAX (rounds, 1), bench_items, timer, rss);
+
+	/* fetch the whole queue, as on connect and on every change */
+	rss = bench_rss ();
+	g_timer_start (timer);
+	bench_items = 0;
+	bench_left = MAX (rounds / 10, 1);
+	gimmix_mpdio_command (cb_playlist_listed, NULL, "playlistinfo");
+	g_main_loop_run (loop);
+	bench_report ("playlist", MAX (rounds / 10, 1), bench_items, timer, rss);
+	if (bench_queue == NULL)
+		bench_queue = g_ptr_array_new ();
+
+	/* the queue view keeps a reference to the pooled artist and album
+	 * of every row instead of a copy of each */
+	rss = bench_rss ();
+	g_timer_start (timer);
+	pooled = g_ptr_array_new_with_free_func ((GDestroyNotify)gimmix_intern_unref);
+	for (i = 0; i < bench_queue->len; i++)
+	{
+		mpd_Song *song = g_ptr_array_index (bench_queue, i);
+
+		g_ptr_array_add (pooled, (gpointer)gimmix_intern (song->artist));
+		g_ptr_array_add (pooled, (gpointer)gimmix_intern (song->album));
+	}
+	bench_report ("intern", 1, pooled->len, timer, rss);
+	bench_intern_report ();
+	g_ptr_array_free (pooled, TRUE);
+
+	/* sorting the queue view collates every song once, clicking a
+	 * column header after that only compares the keys */
+	rss = bench_rss ();
+	g_timer_start (timer);
+	sort = gimmix_sort_cache_new ();
+	ids = g_array_new (FALSE, FALSE, sizeof (gint));
+	gimmix_sort_cache_begin (sort);
+	for (i = 0; i < bench_queue->len; i++)
+	{
+		mpd_Song *song = g_ptr_array_index (bench_queue, i);
+
+		gimmix_sort_cache_set (sort, song->id, song->pos, song->file, song->title, song->artist, song->album, song->time);
+		g_array_append_val (ids, song->id);
+	}
+	gimmix_sort_cache_end (sort);
+	bench_report ("sortkeys", 1, ids->len, timer, rss);
+
+	rss = bench_rss ();
+	g_timer_start (timer);
+	for (i = 0; i < MAX (rounds / 10, 1); i++)
+	{
+		order = gimmix_sort_cache_order (sort, (gint*)ids->data, ids->len,
+						GIMMIX_SORT_TITLE + i % 4, i % 2);
+		g_free (order);
+	}
+	bench_report ("sort", i, ids->len * i, timer, rss);
+
+	/* putting the server queue into title order, the moves are only
+	 * planned here, not sent */
+	order = gimmix_sort_cache_order (sort, (gint*)ids->data, ids->len, GIMMIX_SORT_TITLE, FALSE);
+	sorted = g_new (gint, ids->len);
+	for (i = 0; i < ids->len; i++)
+		sorted[i] = g_array_index (ids, gint, order[i]);
+	rss = bench_rss ();
+	g_timer_start (timer);
+	moves = gimmix_reorder_plan ((gint*)ids->data, sorted, ids->len, -1);
+	bench_report ("reorder", 1, moves->len, timer, rss);
+	g_array_free (moves, TRUE);
+	g_free (sorted);
+	g_free (order);
+	g_array_free (ids, TRUE);
+	gimmix_sort_cache_free (sort);
+
+	/* open the library and some of its directories */
+	rss = bench_rss ();
+	g_timer_start (timer);
+	bench_items = 0;
+	for (i = 0; i < MAX (rounds / 10, 1); i++)
+	{
+		bench_budget = LIBRARY_DIRS;
+		bench_list ("/");
+		g_main_loop_run (loop);
+	}
+	bench_report ("library", i, bench_items, timer, rss);
+
+	/* the search box, one substring search per tag */
+	rss = bench_rss ();
+	g_timer_start (timer);
+	bench_items = 0;
+	for (i = 0; i < MAX (rounds / 10, 1); i++)
+	{
+		bench_search ("artist", "artist 0001");
+		bench_search ("album", "album 07");
+		bench_search ("title", "song 4242");
+		g_main_loop_run (loop);
+	}
+	bench_report ("search", i, bench_items, timer, rss);
+
+	/* a paged queue scrolled to the top only fetches the first page
+	 * and one page of read-ahead */
+	gimmix_queue_init (cb_window_fill, NULL, NULL);
+	rss = bench_rss ();
+	g_timer_start (timer);
+	gimmix_queue_reset (mpd_playlist_get_playlist_length (mo));
+	window_rows = 0;
+	window_pages = MIN (2, (mpd_playlist_get_playlist_length (mo) + 127) / 128);
+	gimmix_queue_request (0, 30);
+	if (window_pages > 0)
+		g_main_loop_run (loop);
+	bench_report ("window", 1, window_rows, timer, rss);
+
+	/* the tag browser builds its index from one listallinfo, then
+	 * every facet value is a lookup */
+	tags_path = g_build_filename (g_get_tmp_dir (), "bench-headless-tags", NULL);
+	g_unlink (tags_path);
+	gimmix_tags_init (tags_path, cb_tags_ready, NULL);
+	rss = bench_rss ();
+	g_timer_start (timer);
+	gimmix_tags_refresh ();
+	g_main_loop_run (loop);
+	bench_report ("tags", 1, mpd_stats_get_total_songs (mo), timer, rss);
+	bench_intern_report ();
+
+	rss = bench_rss ();
+	g_timer_start (timer);
+	values = gimmix_tags_get_values (GIMMIX_TAG_ARTIST);
+	for (i = 0, items = 0; values != NULL && i < values->len; i++)
+	{
+		GArray *songs = gimmix_tags_get_songs (GIMMIX_TAG_ARTIST, g_ptr_array_index (values, i));
+
+		items += songs->len;
+	}
+	bench_report ("facets", values ? values->len : 0, items, timer, rss);
+	gimmix_tags_cleanup ();
+	g_unlink (tags_path);
+	g_free (tags_path);
+
+	/* adding a large selection goes through one command list */
+	rss = bench_rss ();
+	g_timer_start (timer);
+	batch = gimmix_batch_new ();
+	for (i = 0; i < BATCH_SONGS; i++)
+	{
+		gchar *file = g_strdup_printf ("Artist %04u/Album %02u/%02u - Song %u.mp3",
+					i / 100, (i / 10) % 10, i % 10 + 1, i);
+
+		gimmix_batch_add (batch, file);
+		g_free (file);
+	}
+	gimmix_batch_commit (batch, cb_batch_done, NULL);
+	g_main_loop_run (loop);
+	bench_report ("add", 1, BATCH_SONGS, timer, rss);
+
+	printf ("peak rss %ld KiB\n", bench_peak_rss ());
+
+	g_ptr_array_free (bench_queue, TRUE);
+	gimmix_mpdio_stop ();
+	mpd_free (mo);
+	g_timer_destroy (timer);
+	g_main_loop_unref (loop);
+
+	return 0;
+}
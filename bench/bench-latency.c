@@ -0,0 +1,115 @@
+/*
+ * bench-latency.c
+ *
+ * Measures the round trip time of a trivial mpd command over TCP
+ * loopback and over the unix domain socket of the same server.
+ *
+ * usage: bench-latency [count]
+ * MPD_HOST / MPD_PORT select the TCP endpoint (default 127.0.0.1:6600),
+ * MPD_SOCKET the unix socket (default /run/mpd/socket).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gimmix-net.h"
+
+static int
+compare_double (const void *a, const void *b)
+{
+	double d = *(const double*)a - *(const double*)b;
+
+	return (d > 0) - (d < 0);
+}
+
+/* read until a line starting with OK or ACK, FALSE on error */
+static gboolean
+read_reply (int fd)
+{
+	char	buf[512];
+	size_t	len = 0;
+
+	while (TRUE)
+	{
+		ssize_t	n;
+		char	*nl;
+
+		n = read (fd, buf + len, sizeof(buf) - len - 1);
+		if (n <= 0)
+			return FALSE;
+		len += n;
+		buf[len] = '\0';
+		/* ping and the greeting only ever answer with one line */
+		if ((nl = strchr (buf, '\n')) != NULL)
+			return (!strncmp (buf, "OK", 2));
+		if (len == sizeof(buf) - 1)
+			return FALSE;
+	}
+}
+
+static gboolean
+run (const char *name, const char *host, int port, int count)
+{
+	double	*samples;
+	GTimer	*timer;
+	double	total = 0;
+	int	fd;
+	int	i;
+
+	fd = gimmix_net_connect (host, port, 5000, NULL);
+	if (fd < 0 || !read_reply (fd))
+	{
+		fprintf (stderr, "%s: could not connect to %s\n", name, host);
+		return FALSE;
+	}
+
+	samples = g_new (double, count);
+	timer = g_timer_new ();
+	for (i = 0; i < count; i++)
+	{
+		g_timer_start (timer);
+		if (write (fd, "ping\n", 5) != 5 || !read_reply (fd))
+		{
+			fprintf (stderr, "%s: connection lost\n", name);
+			break;
+		}
+		samples[i] = g_timer_elapsed (timer, NULL) * 1e6;
+		total += samples[i];
+	}
+	if (i == count)
+	{
+		qsort (samples, count, sizeof(double), compare_double);
+		printf ("%-6s mean %7.1f us  p50 %7.1f us  p99 %7.1f us\n",
+			name, total / count, samples[count / 2], samples[count * 99 / 100]);
+	}
+
+	g_timer_destroy (timer);
+	g_free (samples);
+	close (fd);
+
+	return (i == count);
+}
+
+int
+main (int argc, char **argv)
+{
+	const char	*host;
+	const char	*path;
+	int		port;
+	int		count = 10000;
+	gboolean	ok;
+
+	if (argc > 1)
+		count = MAX (1, atoi (argv[1]));
+	host = g_getenv ("MPD_HOST") ? g_getenv ("MPD_HOST") : "127.0.0.1";
+	port = g_getenv ("MPD_PORT") ? atoi (g_getenv ("MPD_PORT")) : 6600;
+	path = g_getenv ("MPD_SOCKET") ? g_getenv ("MPD_SOCKET") : "/run/mpd/socket";
+
+	printf ("%d round trips of \"ping\"\n", count);
+	ok = run ("tcp", host, port, count);
+	ok = run ("unix", path, 0, count) && ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,1110 @@
+/*
+ * mock-mpd.c
+ *
+ * A stand-in for mpd that serves a synthetic library and queue, for
+ * benchmarking gimmix without a real music collection.
+ *
+ * usage: mock-mpd [options]
+ *   -p port      listen on 127.0.0.1:port (default 6601)
+ *   -s path      listen on a unix domain socket instead
+ *   -n songs     size of the library (default 10000)
+ *   -q songs     initial length of the queue (default 1000)
+ *   -P count     number of stored playlists (default 10)
+ *   -l msec      latency added to every response (default 0)
+ *   -v           log the commands to stderr
+ *
+ * Song i lives in "Artist AAAA/Album BB/TT - Song i.mp3", with 100
+ * songs per artist and 10 per album. Only the parts of the protocol
+ * gimmix and libmpd use are implemented.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <glib.h>
+
+#define MOCK_VERSION		"0.16.0"
+#define SONGS_PER_ARTIST	100
+#define SONGS_PER_ALBUM		10
+
+#define ACK_ERROR_ARG		2
+#define ACK_ERROR_UNKNOWN	5
+#define ACK_ERROR_NO_EXIST	50
+
+static const char *mock_genres[] = {
+	"Rock", "Jazz", "Classical", "Electronic", "Folk", "Hip-Hop", "Pop", "Blues"
+};
+
+static const char *mock_commands[] = {
+	"add", "addid", "clear", "close", "command_list_begin", "command_list_end",
+	"command_list_ok_begin", "commands", "crossfade", "currentsong", "delete",
+	"deleteid", "disableoutput", "enableoutput", "find", "list", "listall",
+	"listallinfo", "listplaylist", "listplaylistinfo", "listplaylists", "load",
+	"lsinfo", "move", "moveid", "next", "notcommands", "outputs", "password",
+	"pause", "ping", "play", "playid", "playlistid", "playlistinfo",
+	"plchanges", "plchangesposid", "previous", "random", "repeat", "rescan",
+	"rm", "save", "search", "seek", "seekcur", "seekid", "setvol", "single",
+	"consume", "stats", "status", "stop", "tagtypes", "update", "urlhandlers",
+	NULL
+};
+
+typedef struct _mock_state {
+	GMutex		lock;
+	guint		songs;
+	guint		playlists;
+	/* the queue: song index, id and the version it last changed in */
+	GArray		*queue;
+	GArray		*ids;
+	GArray		*versions;
+	guint		version;
+	guint		next_id;
+	gint		current;	/* queue position, -1 if none */
+	gint		state;		/* 0 stop, 1 play, 2 pause */
+	gdouble		elapsed;
+	GTimer		*clock;
+	gint		volume;
+	gboolean	repeat;
+	gboolean	random;
+	gboolean	single;
+	gboolean	consume;
+	gint		xfade;
+	guint		db_update;
+	gboolean	output;
+} MockState;
+
+static MockState	mock;
+static gulong		mock_latency = 0;
+static gboolean		mock_verbose = FALSE;
+
+static void
+mock_song_path (GString *out, guint i)
+{
+	g_string_append_printf (out, "Artist %04u/Album %02u/%02u - Song %u.mp3",
+				i / SONGS_PER_ARTIST,
+				(i / SONGS_PER_ALBUM) % (SONGS_PER_ARTIST / SONGS_PER_ALBUM),
+				i % SONGS_PER_ALBUM + 1,
+				i);
+
+	return;
+}
+
+static void
+mock_song (GString *out, guint i)
+{
+	guint artist = i / SONGS_PER_ARTIST;
+
+	g_string_append (out, "file: ");
+	mock_song_path (out, i);
+	g_string_append_printf (out,
+			"\nLast-Modified: 2013-01-01T00:00:00Z\n"
+			"Time: %u\n"
+			"Artist: Artist %04u\n"
+			"Album: Album %02u\n"
+			"Title: Song %u\n"
+			"Track: %u\n"
+			"Genre: %s\n"
+			"Date: %u\n",
+			120 + i % 240,
+			artist,
+			(i / SONGS_PER_ALBUM) % (SONGS_PER_ARTIST / SONGS_PER_ALBUM),
+			i,
+			i % SONGS_PER_ALBUM + 1,
+			mock_genres[artist % G_N_ELEMENTS (mock_genres)],
+			1970 + artist % 50);
+
+	return;
+}
+
+static void
+mock_queue_entry (GString *out, guint pos)
+{
+	mock_song (out, g_array_index (mock.queue, guint, pos));
+	g_string_append_printf (out, "Pos: %u\nId: %u\n", pos, g_array_index (mock.ids, guint, pos));
+
+	return;
+}
+
+/* the song a file name refers to */
+static gboolean
+mock_parse_song (const char *uri, guint *song)
+{
+	guint	artist, album, track, i;
+	GString	*check;
+	gboolean ret;
+
+	if (sscanf (uri, "Artist %u/Album %u/%u - Song %u.mp3", &artist, &album, &track, &i) != 4 ||
+		i >= mock.songs)
+		return FALSE;
+
+	/* reject names that only look similar */
+	check = g_string_new (NULL);
+	mock_song_path (check, i);
+	ret = !strcmp (check->str, uri);
+	g_string_free (check, TRUE);
+	if (ret)
+		*song = i;
+
+	return ret;
+}
+
+/* the range of songs below a directory, depth is 0 for the root,
+ * 1 for an artist and 2 for an album */
+static gboolean
+mock_parse_dir (const char *uri, guint *start, guint *end, gint *depth)
+{
+	guint	artist, album;
+	gchar	rest;
+
+	if (uri == NULL || *uri == '\0' || !strcmp (uri, "/"))
+	{
+		*start = 0;
+		*end = mock.songs;
+		*depth = 0;
+		return TRUE;
+	}
+	if (sscanf (uri, "Artist %u/Album %u%c", &artist, &album, &rest) == 2 &&
+		album < SONGS_PER_ARTIST / SONGS_PER_ALBUM)
+	{
+		*start = artist * SONGS_PER_ARTIST + album * SONGS_PER_ALBUM;
+		*end = MIN (*start + SONGS_PER_ALBUM, mock.songs);
+		*depth = 2;
+		return (*start < mock.songs);
+	}
+	if (sscanf (uri, "Artist %u%c", &artist, &rest) == 1)
+	{
+		*start = artist * SONGS_PER_ARTIST;
+		*end = MIN (*start + SONGS_PER_ARTIST, mock.songs);
+		*depth = 1;
+		return (*start < mock.songs);
+	}
+
+	return FALSE;
+}
+
+/* list the songs and directories below [start, end) */
+static void
+mock_list_tree (GString *out, guint start, guint end, gboolean info)
+{
+	guint i;
+
+	for (i = start; i < end; i++)
+	{
+		if (i % SONGS_PER_ARTIST == 0 || i == start)
+			g_string_append_printf (out, "directory: Artist %04u\n", i / SONGS_PER_ARTIST);
+		if (i % SONGS_PER_ALBUM == 0 || i == start)
+			g_string_append_printf (out, "directory: Artist %04u/Album %02u\n",
+					i / SONGS_PER_ARTIST,
+					(i / SONGS_PER_ALBUM) % (SONGS_PER_ARTIST / SONGS_PER_ALBUM));
+		if (info)
+		{
+			mock_song (out, i);
+		}
+		else
+		{
+			g_string_append (out, "file: ");
+			mock_song_path (out, i);
+			g_string_append_c (out, '\n');
+		}
+	}
+
+	return;
+}
+
+static void
+mock_playlist_name (GString *out, guint n)
+{
+	g_string_append_printf (out, "Mix %02u", n);
+
+	return;
+}
+
+/* songs of stored playlist n: every 7th song from n on, up to 100 */
+static guint
+mock_playlist_song (guint n, guint i)
+{
+	return (n + i * 7) % MAX (mock.songs, 1);
+}
+
+static gboolean
+mock_parse_playlist (const char *name, guint *n)
+{
+	return (sscanf (name, "Mix %u", n) == 1 && *n < mock.playlists);
+}
+
+static void
+mock_queue_changed (guint from)
+{
+	guint i;
+
+	mock.version++;
+	for (i = from; i < mock.queue->len; i++)
+		g_array_index (mock.versions, guint, i) = mock.version;
+
+	return;
+}
+
+static guint
+mock_queue_add (guint song, gint pos)
+{
+	guint id = mock.next_id++;
+
+	if (pos < 0 || (guint)pos > mock.queue->len)
+		pos = mock.queue->len;
+	g_array_insert_val (mock.queue, pos, song);
+	g_array_insert_val (mock.ids, pos, id);
+	g_array_insert_val (mock.versions, pos, mock.version);
+	if (mock.current >= pos)
+		mock.current++;
+
+	return id;
+}
+
+static void
+mock_queue_delete (guint pos)
+{
+	g_array_remove_index (mock.queue, pos);
+	g_array_remove_index (mock.ids, pos);
+	g_array_remove_index (mock.versions, pos);
+	if (mock.current == (gint)pos)
+	{
+		mock.current = -1;
+		mock.state = 0;
+	}
+	else if (mock.current > (gint)pos)
+	{
+		mock.current--;
+	}
+
+	return;
+}
+
+static void
+mock_queue_move (guint from, guint to)
+{
+	guint	song = g_array_index (mock.queue, guint, from);
+	guint	id = g_array_index (mock.ids, guint, from);
+
+	g_array_remove_index (mock.queue, from);
+	g_array_remove_index (mock.ids, from);
+	g_array_remove_index (mock.versions, from);
+	g_array_insert_val (mock.queue, to, song);
+	g_array_insert_val (mock.ids, to, id);
+	g_array_insert_val (mock.versions, to, mock.version);
+	if (mock.current == (gint)from)
+		mock.current = to;
+	else if (from < to && mock.current > (gint)from && mock.current <= (gint)to)
+		mock.current--;
+	else if (from > to && mock.current >= (gint)to && mock.current < (gint)from)
+		mock.current++;
+
+	return;
+}
+
+static gint
+mock_queue_find_id (guint id)
+{
+	guint i;
+
+	for (i = 0; i < mock.ids->len; i++)
+	{
+		if (g_array_index (mock.ids, guint, i) == id)
+			return i;
+	}
+
+	return -1;
+}
+
+static gdouble
+mock_elapsed (void)
+{
+	if (mock.state == 1)
+		return mock.elapsed + g_timer_elapsed (mock.clock, NULL);
+
+	return mock.elapsed;
+}
+
+static void
+mock_play (gint pos, gdouble seek)
+{
+	mock.current = pos;
+	mock.state = 1;
+	mock.elapsed = seek;
+	g_timer_start (mock.clock);
+
+	return;
+}
+
+/* "N" or "START:END", END defaults to the end of the queue */
+static gboolean
+mock_parse_range (const char *arg, guint *start, guint *end)
+{
+	gchar *colon;
+
+	*start = strtoul (arg, &colon, 10);
+	if (*colon == ':')
+		*end = colon[1] ? strtoul (colon + 1, NULL, 10) : mock.queue->len;
+	else
+		*end = *start + 1;
+	*end = MIN (*end, mock.queue->len);
+
+	return (*start < *end);
+}
+
+/* does song i match a search/find condition */
+static gboolean
+mock_match (guint i, const char *type, const char *what, gboolean exact)
+{
+	GString		*field;
+	gboolean	ret;
+	guint		artist = i / SONGS_PER_ARTIST;
+
+	field = g_string_new (NULL);
+	if (!g_ascii_strcasecmp (type, "artist"))
+		g_string_printf (field, "Artist %04u", artist);
+	else if (!g_ascii_strcasecmp (type, "album"))
+		g_string_printf (field, "Album %02u", (i / SONGS_PER_ALBUM) % (SONGS_PER_ARTIST / SONGS_PER_ALBUM));
+	else if (!g_ascii_strcasecmp (type, "title"))
+		g_string_printf (field, "Song %u", i);
+	else if (!g_ascii_strcasecmp (type, "genre"))
+		g_string_assign (field, mock_genres[artist % G_N_ELEMENTS (mock_genres)]);
+	else if (!g_ascii_strcasecmp (type, "date"))
+		g_string_printf (field, "%u", 1970 + artist % 50);
+	else
+		mock_song_path (field, i);	/* file, filename, any */
+
+	if (exact)
+	{
+		ret = !strcmp (field->str, what);
+	}
+	else
+	{
+		gchar *haystack = g_ascii_strdown (field->str, -1);
+		gchar *needle = g_ascii_strdown (what, -1);
+
+		ret = (strstr (haystack, needle) != NULL);
+		g_free (haystack);
+		g_free (needle);
+	}
+	g_string_free (field, TRUE);
+
+	return ret;
+}
+
+static void
+mock_status (GString *out)
+{
+	static const char *states[] = { "stop", "play", "pause" };
+
+	g_string_append_printf (out,
+			"volume: %d\nrepeat: %d\nrandom: %d\nsingle: %d\nconsume: %d\n"
+			"playlist: %u\nplaylistlength: %u\nxfade: %d\nstate: %s\n",
+			mock.volume, mock.repeat, mock.random, mock.single, mock.consume,
+			mock.version, mock.queue->len, mock.xfade, states[mock.state]);
+	if (mock.current >= 0)
+	{
+		guint song = g_array_index (mock.queue, guint, mock.current);
+
+		g_string_append_printf (out,
+				"song: %d\nsongid: %u\ntime: %u:%u\nelapsed: %.3f\n"
+				"bitrate: 320\naudio: 44100:24:2\n",
+				mock.current,
+				g_array_index (mock.ids, guint, mock.current),
+				(guint)mock_elapsed (), 120 + song % 240,
+				mock_elapsed ());
+	}
+
+	return;
+}
+
+/* Run one command. Returns NULL or the error message, in which case
+ * *code is set to the ACK error number. */
+static const char *
+mock_exec (gchar **argv, GString *out, gint *code)
+{
+	const char	*cmd = argv[0];
+	guint		argc = g_strv_length (argv);
+	guint		start, end, i, song;
+	gint		depth, pos;
+
+	*code = ACK_ERROR_ARG;
+
+#define NEED_ARGS(n)	if (argc < (n) + 1) return "wrong number of arguments"
+
+	if (!strcmp (cmd, "ping") || !strcmp (cmd, "password") ||
+		!strcmp (cmd, "enableoutput") || !strcmp (cmd, "disableoutput") ||
+		!strcmp (cmd, "urlhandlers") || !strcmp (cmd, "notcommands"))
+	{
+		if (!strcmp (cmd, "enableoutput") || !strcmp (cmd, "disableoutput"))
+			mock.output = (cmd[0] == 'e');
+		return NULL;
+	}
+	if (!strcmp (cmd, "commands"))
+	{
+		for (i = 0; mock_commands[i] != NULL; i++)
+			g_string_append_printf (out, "command: %s\n", mock_commands[i]);
+		return NULL;
+	}
+	if (!strcmp (cmd, "tagtypes"))
+	{
+		g_string_append (out, "tagtype: Artist\ntagtype: Album\ntagtype: Title\n"
+				"tagtype: Track\ntagtype: Genre\ntagtype: Date\n");
+		return NULL;
+	}
+	if (!strcmp (cmd, "status"))
+	{
+		mock_status (out);
+		return NULL;
+	}
+	if (!strcmp (cmd, "stats"))
+	{
+		g_string_append_printf (out,
+				"artists: %u\nalbums: %u\nsongs: %u\nuptime: 1000\n"
+				"playtime: 0\ndb_playtime: %u\ndb_update: %u\n",
+				(mock.songs + SONGS_PER_ARTIST - 1) / SONGS_PER_ARTIST,
+				(mock.songs + SONGS_PER_ALBUM - 1) / SONGS_PER_ALBUM,
+				mock.songs, mock.songs * 240, mock.db_update);
+		return NULL;
+	}
+	if (!strcmp (cmd, "outputs"))
+	{
+		g_string_append_printf (out, "outputid: 0\noutputname: Mock output\noutputenabled: %d\n", mock.output);
+		return NULL;
+	}
+	if (!strcmp (cmd, "currentsong"))
+	{
+		if (mock.current >= 0)
+			mock_queue_entry (out, mock.current);
+		return NULL;
+	}
+	if (!strcmp (cmd, "update") || !strcmp (cmd, "rescan"))
+	{
+		mock.db_update++;
+		g_string_append_printf (out, "updating_db: %u\n", mock.db_update);
+		return NULL;
+	}
+
+	/* database */
+	if (!strcmp (cmd, "lsinfo"))
+	{
+		if (argc > 1 && mock_parse_song (argv[1], &song))
+		{
+			mock_song (out, song);
+			return NULL;
+		}
+		*code = ACK_ERROR_NO_EXIST;
+		if (!mock_parse_dir (argc > 1 ? argv[1] : NULL, &start, &end, &depth))
+			return "directory not found";
+		for (i = start; i < end; i++)
+		{
+			if (depth == 0 && i % SONGS_PER_ARTIST == 0)
+				g_string_append_printf (out, "directory: Artist %04u\n", i / SONGS_PER_ARTIST);
+			else if (depth == 1 && i % SONGS_PER_ALBUM == 0)
+				g_string_append_printf (out, "directory: Artist %04u/Album %02u\n",
+						i / SONGS_PER_ARTIST,
+						(i / SONGS_PER_ALBUM) % (SONGS_PER_ARTIST / SONGS_PER_ALBUM));
+			else if (depth == 2)
+				mock_song (out, i);
+		}
+		if (depth == 0)
+		{
+			for (i = 0; i < mock.playlists; i++)
+			{
+				g_string_append (out, "playlist: ");
+				mock_playlist_name (out, i);
+				g_string_append (out, "\nLast-Modified: 2013-01-01T00:00:00Z\n");
+			}
+		}
+		return NULL;
+	}
+	if (!strcmp (cmd, "listall") || !strcmp (cmd, "listallinfo"))
+	{
+		*code = ACK_ERROR_NO_EXIST;
+		if (argc > 1 && mock_parse_song (argv[1], &song))
+		{
+			mock_list_tree (out, song, song + 1, !strcmp (cmd, "listallinfo"));
+			return NULL;
+		}
+		if (!mock_parse_dir (argc > 1 ? argv[1] : NULL, &start, &end, &depth))
+			return "directory not found";
+		mock_list_tree (out, start, end, !strcmp (cmd, "listallinfo"));
+		return NULL;
+	}
+	if (!strcmp (cmd, "search") || !strcmp (cmd, "find"))
+	{
+		NEED_ARGS (2);
+		for (i = 0; i < mock.songs; i++)
+		{
+			guint k;
+
+			for (k = 1; k + 1 < argc; k += 2)
+			{
+				if (!mock_match (i, argv[k], argv[k + 1], cmd[0] == 'f'))
+					break;
+			}
+			if (k + 1 >= argc)
+				mock_song (out, i);
+		}
+		return NULL;
+	}
+	if (!strcmp (cmd, "list"))
+	{
+		NEED_ARGS (1);
+		if (!g_ascii_strcasecmp (argv[1], "artist"))
+		{
+			for (i = 0; i < mock.songs; i += SONGS_PER_ARTIST)
+				g_string_append_printf (out, "Artist: Artist %04u\n", i / SONGS_PER_ARTIST);
+		}
+		else if (!g_ascii_strcasecmp (argv[1], "album"))
+		{
+			for (i = 0; i < MIN (mock.songs, SONGS_PER_ARTIST); i += SONGS_PER_ALBUM)
+				g_string_append_printf (out, "Album: Album %02u\n", i / SONGS_PER_ALBUM);
+		}
+		else if (!g_ascii_strcasecmp (argv[1], "genre"))
+		{
+			for (i = 0; i < G_N_ELEMENTS (mock_genres) && i * SONGS_PER_ARTIST < mock.songs; i++)
+				g_string_append_printf (out, "Genre: %s\n", mock_genres[i]);
+		}
+		else if (!g_ascii_strcasecmp (argv[1], "date"))
+		{
+			for (i = 0; i < 50 && i * SONGS_PER_ARTIST < mock.songs; i++)
+				g_string_append_printf (out, "Date: %u\n", 1970 + i);
+		}
+		else
+		{
+			return "unknown tag type";
+		}
+		return NULL;
+	}
+
+	/* stored playlists */
+	if (!strcmp (cmd, "listplaylists"))
+	{
+		for (i = 0; i < mock.playlists; i++)
+		{
+			g_string_append (out, "playlist: ");
+			mock_playlist_name (out, i);
+			g_string_append (out, "\nLast-Modified: 2013-01-01T00:00:00Z\n");
+		}
+		return NULL;
+	}
+	if (!strcmp (cmd, "listplaylist") || !strcmp (cmd, "listplaylistinfo") || !strcmp (cmd, "load"))
+	{
+		guint n;
+
+		NEED_ARGS (1);
+		*code = ACK_ERROR_NO_EXIST;
+		if (!mock_parse_playlist (argv[1], &n))
+			return "No such playlist";
+		for (i = 0; i < 100 && i < mock.songs; i++)
+		{
+			song = mock_playlist_song (n, i);
+			if (!strcmp (cmd, "load"))
+			{
+				mock_queue_add (song, -1);
+			}
+			else if (!strcmp (cmd, "listplaylistinfo"))
+			{
+				mock_song (out, song);
+			}
+			else
+			{
+				g_string_append (out, "file: ");
+				mock_song_path (out, song);
+				g_string_append_c (out, '\n');
+			}
+		}
+		if (!strcmp (cmd, "load"))
+			mock_queue_changed (mock.queue->len);
+		return NULL;
+	}
+	if (!strcmp (cmd, "save") || !strcmp (cmd, "rm"))
+	{
+		/* the synthetic playlists are fixed */
+		NEED_ARGS (1);
+		return NULL;
+	}
+
+	/* queue */
+	if (!strcmp (cmd, "playlistinfo") || !strcmp (cmd, "playlist"))
+	{
+		start = 0;
+		end = mock.queue->len;
+		if (argc > 1 && !mock_parse_range (argv[1], &start, &end))
+			return "Bad song index";
+		for (i = start; i < end; i++)
+			mock_queue_entry (out, i);
+		return NULL;
+	}
+	if (!strcmp (cmd, "playlistid"))
+	{
+		if (argc < 2)
+		{
+			for (i = 0; i < mock.queue->len; i++)
+				mock_queue_entry (out, i);
+			return NULL;
+		}
+		*code = ACK_ERROR_NO_EXIST;
+		if ((pos = mock_queue_find_id (atoi (argv[1]))) < 0)
+			return "No such song";
+		mock_queue_entry (out, pos);
+		return NULL;
+	}
+	if (!strcmp (cmd, "plchanges") || !strcmp (cmd, "plchangesposid"))
+	{
+		guint version;
+
+		NEED_ARGS (1);
+		version = strtoul (argv[1], NULL, 10);
+		for (i = 0; i < mock.queue->len; i++)
+		{
+			if (version != 0 && g_array_index (mock.versions, guint, i) <= version)
+				continue;
+			if (cmd[9] == '\0')
+				mock_queue_entry (out, i);
+			else
+				g_string_append_printf (out, "cpos: %u\nId: %u\n", i, g_array_index (mock.ids, guint, i));
+		}
+		return NULL;
+	}
+	if (!strcmp (cmd, "add") || !strcmp (cmd, "addid"))
+	{
+		NEED_ARGS (1);
+		*code = ACK_ERROR_NO_EXIST;
+		start = mock.queue->len;
+		if (mock_parse_song (argv[1], &song))
+		{
+			guint id = mock_queue_add (song, argc > 2 ? atoi (argv[2]) : -1);
+
+			if (!strcmp (cmd, "addid"))
+				g_string_append_printf (out, "Id: %u\n", id);
+		}
+		else if (!strcmp (cmd, "add") && mock_parse_dir (argv[1], &i, &end, &depth))
+		{
+			for (; i < end; i++)
+				mock_queue_add (i, -1);
+		}
+		else
+		{
+			return "No such directory";
+		}
+		mock_queue_changed (start);
+		return NULL;
+	}
+	if (!strcmp (cmd, "delete"))
+	{
+		NEED_ARGS (1);
+		if (!mock_parse_range (argv[1], &start, &end))
+			return "Bad song index";
+		for (i = end; i > start; i--)
+			mock_queue_delete (i - 1);
+		mock_queue_changed (start);
+		return NULL;
+	}
+	if (!strcmp (cmd, "deleteid"))
+	{
+		NEED_ARGS (1);
+		*code = ACK_ERROR_NO_EXIST;
+		if ((pos = mock_queue_find_id (atoi (argv[1]))) < 0)
+			return "No such song";
+		mock_queue_delete (pos);
+		mock_queue_changed (pos);
+		return NULL;
+	}
+	if (!strcmp (cmd, "move") || !strcmp (cmd, "moveid"))
+	{
+		guint to;
+
+		NEED_ARGS (2);
+		if (cmd[4] == 'i')
+			pos = mock_queue_find_id (atoi (argv[1]));
+		else
+			pos = atoi (argv[1]);
+		to = atoi (argv[2]);
+		*code = ACK_ERROR_NO_EXIST;
+		if (pos < 0 || (guint)pos >= mock.queue->len || to >= mock.queue->len)
+			return "Bad song index";
+		mock_queue_move (pos, to);
+		mock_queue_changed (MIN ((guint)pos, to));
+		return NULL;
+	}
+	if (!strcmp (cmd, "clear"))
+	{
+		g_array_set_size (mock.queue, 0);
+		g_array_set_size (mock.ids, 0);
+		g_array_set_size (mock.versions, 0);
+		mock.current = -1;
+		mock.state = 0;
+		mock_queue_changed (0);
+		return NULL;
+	}
+
+	/* playback */
+	if (!strcmp (cmd, "play") || !strcmp (cmd, "playid"))
+	{
+		pos = (mock.current >= 0) ? mock.current : 0;
+		if (argc > 1 && cmd[4] == 'i')
+			pos = mock_queue_find_id (atoi (argv[1]));
+		else if (argc > 1)
+			pos = atoi (argv[1]);
+		*code = ACK_ERROR_NO_EXIST;
+		if (pos < 0 || (guint)pos >= mock.queue->len)
+			return "Bad song index";
+		mock_play (pos, 0);
+		return NULL;
+	}
+	if (!strcmp (cmd, "pause"))
+	{
+		gboolean pause = (argc > 1) ? atoi (argv[1]) : (mock.state == 1);
+
+		if (pause && mock.state == 1)
+		{
+			mock.elapsed = mock_elapsed ();
+			mock.state = 2;
+		}
+		else if (!pause && mock.state == 2)
+		{
+			mock_play (mock.current, mock.elapsed);
+		}
+		return NULL;
+	}
+	if (!strcmp (cmd, "stop"))
+	{
+		mock.state = 0;
+		mock.elapsed = 0;
+		return NULL;
+	}
+	if (!strcmp (cmd, "next") || !strcmp (cmd, "previous"))
+	{
+		if (mock.current < 0)
+			return NULL;
+		pos = mock.current + (cmd[0] == 'n' ? 1 : -1);
+		if (pos < 0 || (guint)pos >= mock.queue->len)
+		{
+			mock.state = 0;
+			return NULL;
+		}
+		mock_play (pos, 0);
+		return NULL;
+	}
+	if (!strcmp (cmd, "seek") || !strcmp (cmd, "seekid") || !strcmp (cmd, "seekcur"))
+	{
+		if (!strcmp (cmd, "seekcur"))
+		{
+			NEED_ARGS (1);
+			pos = mock.current;
+		}
+		else
+		{
+			NEED_ARGS (2);
+			pos = (cmd[4] == 'i') ? mock_queue_find_id (atoi (argv[1])) : atoi (argv[1]);
+		}
+		*code = ACK_ERROR_NO_EXIST;
+		if (pos < 0 || (guint)pos >= mock.queue->len)
+			return "Bad song index";
+		mock_play (pos, g_ascii_strtod (argv[argc - 1], NULL));
+		return NULL;
+	}
+	if (!strcmp (cmd, "setvol"))
+	{
+		NEED_ARGS (1);
+		mock.volume = CLAMP (atoi (argv[1]), 0, 100);
+		return NULL;
+	}
+	if (!strcmp (cmd, "repeat") || !strcmp (cmd, "random") ||
+		!strcmp (cmd, "single") || !strcmp (cmd, "consume") || !strcmp (cmd, "crossfade"))
+	{
+		NEED_ARGS (1);
+		if (!strcmp (cmd, "repeat"))
+			mock.repeat = atoi (argv[1]) != 0;
+		else if (!strcmp (cmd, "random"))
+			mock.random = atoi (argv[1]) != 0;
+		else if (!strcmp (cmd, "single"))
+			mock.single = atoi (argv[1]) != 0;
+		else if (!strcmp (cmd, "consume"))
+			mock.consume = atoi (argv[1]) != 0;
+		else
+			mock.xfade = atoi (argv[1]);
+		return NULL;
+	}
+
+#undef NEED_ARGS
+
+	*code = ACK_ERROR_UNKNOWN;
+	return "unknown command";
+}
+
+/* split a command line into its arguments, honouring quotes */
+static gchar **
+mock_split (const char *line)
+{
+	GPtrArray	*args;
+	const char	*p = line;
+
+	args = g_ptr_array_new ();
+	while (*p)
+	{
+		GString *arg;
+
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '\0')
+			break;
+		arg = g_string_new (NULL);
+		if (*p == '"')
+		{
+			for (p++; *p && *p != '"'; p++)
+			{
+				if (*p == '\\' && p[1])
+					p++;
+				g_string_append_c (arg, *p);
+			}
+			if (*p == '"')
+				p++;
+		}
+		else
+		{
+			while (*p && *p != ' ' && *p != '\t')
+				g_string_append_c (arg, *p++);
+		}
+		g_ptr_array_add (args, g_string_free (arg, FALSE));
+	}
+	g_ptr_array_add (args, NULL);
+
+	return (gchar**)g_ptr_array_free (args, FALSE);
+}
+
+/* run a single command or a command list, appending the response */
+static void
+mock_run (GPtrArray *lines, gboolean list_ok, GString *out)
+{
+	guint i;
+
+	g_mutex_lock (&mock.lock);
+	for (i = 0; i < lines->len; i++)
+	{
+		gchar		**argv = mock_split (g_ptr_array_index (lines, i));
+		const char	*error;
+		gint		code;
+
+		if (argv[0] == NULL)
+		{
+			g_strfreev (argv);
+			continue;
+		}
+		error = mock_exec (argv, out, &code);
+		if (error != NULL)
+		{
+			g_string_append_printf (out, "ACK [%d@%u] {%s} %s\n", code, i, argv[0], error);
+			g_strfreev (argv);
+			g_mutex_unlock (&mock.lock);
+			return;
+		}
+		if (list_ok)
+			g_string_append (out, "list_OK\n");
+		g_strfreev (argv);
+	}
+	g_mutex_unlock (&mock.lock);
+	g_string_append (out, "OK\n");
+
+	return;
+}
+
+static gboolean
+mock_write (int fd, const GString *out)
+{
+	gsize	done = 0;
+
+	if (mock_latency)
+		g_usleep (mock_latency);
+
+	while (done < out->len)
+	{
+		ssize_t n = write (fd, out->str + done, out->len - done);
+
+		if (n <= 0)
+			return FALSE;
+		done += n;
+	}
+
+	return TRUE;
+}
+
+static gpointer
+mock_client (gpointer data)
+{
+	int		fd = GPOINTER_TO_INT (data);
+	FILE		*in;
+	gchar		*line = NULL;
+	size_t		size = 0;
+	ssize_t		len;
+	GPtrArray	*list = NULL;
+	gboolean	list_ok = FALSE;
+	GString		*out;
+
+	in = fdopen (dup (fd), "r");
+	out = g_string_new ("OK MPD " MOCK_VERSION "\n");
+	if (!mock_write (fd, out))
+		goto done;
+
+	while ((len = getline (&line, &size, in)) > 0)
+	{
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (mock_verbose)
+			fprintf (stderr, "%d: %s\n", fd, line);
+
+		if (list != NULL)
+		{
+			if (strcmp (line, "command_list_end"))
+			{
+				g_ptr_array_add (list, g_strdup (line));
+				continue;
+			}
+			g_string_truncate (out, 0);
+			mock_run (list, list_ok, out);
+			g_ptr_array_free (list, TRUE);
+			list = NULL;
+		}
+		else if (!strcmp (line, "command_list_begin") || !strcmp (line, "command_list_ok_begin"))
+		{
+			list = g_ptr_array_new_with_free_func (g_free);
+			list_ok = !strcmp (line, "command_list_ok_begin");
+			continue;
+		}
+		else if (!strcmp (line, "close"))
+		{
+			break;
+		}
+		else
+		{
+			GPtrArray *single = g_ptr_array_new ();
+
+			g_ptr_array_add (single, line);
+			g_string_truncate (out, 0);
+			mock_run (single, FALSE, out);
+			g_ptr_array_free (single, TRUE);
+		}
+		if (!mock_write (fd, out))
+			break;
+	}
+
+	done:
+	if (list != NULL)
+		g_ptr_array_free (list, TRUE);
+	g_string_free (out, TRUE);
+	free (line);
+	fclose (in);
+	close (fd);
+
+	return NULL;
+}
+
+static int
+mock_listen (int port, const char *path)
+{
+	int	fd;
+	int	one = 1;
+
+	if (path != NULL)
+	{
+		struct sockaddr_un sun;
+
+		fd = socket (AF_UNIX, SOCK_STREAM, 0);
+		memset (&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		g_strlcpy (sun.sun_path, path, sizeof(sun.sun_path));
+		unlink (path);
+		if (bind (fd, (struct sockaddr*)&sun, sizeof(sun)) < 0)
+			return -1;
+	}
+	else
+	{
+		struct sockaddr_in sin;
+
+		fd = socket (AF_INET, SOCK_STREAM, 0);
+		setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		memset (&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons (port);
+		sin.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+		if (bind (fd, (struct sockaddr*)&sin, sizeof(sin)) < 0)
+			return -1;
+	}
+	if (listen (fd, 16) < 0)
+		return -1;
+
+	return fd;
+}
+
+int
+main (int argc, char **argv)
+{
+	const char	*path = NULL;
+	int		port = 6601;
+	guint		queue = 1000;
+	int		opt;
+	int		fd;
+	guint		i;
+
+	mock.songs = 10000;
+	mock.playlists = 10;
+	while ((opt = getopt (argc, argv, "p:s:n:q:P:l:v")) > 0)
+	{
+		switch (opt)
+		{
+			case 'p': port = atoi (optarg); break;
+			case 's': path = optarg; break;
+			case 'n': mock.songs = strtoul (optarg, NULL, 10); break;
+			case 'q': queue = strtoul (optarg, NULL, 10); break;
+			case 'P': mock.playlists = strtoul (optarg, NULL, 10); break;
+			case 'l': mock_latency = strtoul (optarg, NULL, 10) * 1000; break;
+			case 'v': mock_verbose = TRUE; break;
+			default:
+				fprintf (stderr, "usage: %s [-p port | -s socket] [-n songs] [-q queue] [-P playlists] [-l msec] [-v]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	mock.queue = g_array_new (FALSE, FALSE, sizeof(guint));
+	mock.ids = g_array_new (FALSE, FALSE, sizeof(guint));
+	mock.versions = g_array_new (FALSE, FALSE, sizeof(guint));
+	mock.version = 1;
+	mock.current = -1;
+	mock.volume = 80;
+	mock.output = TRUE;
+	mock.clock = g_timer_new ();
+	/* spread the initial queue over the whole library */
+	for (i = 0; i < queue && mock.songs > 0; i++)
+		mock_queue_add ((guint)((guint64)i * mock.songs / MAX (queue, 1)) % mock.songs, -1);
+
+	signal (SIGPIPE, SIG_IGN);
+	fd = mock_listen (port, path);
+	if (fd < 0)
+	{
+		perror ("mock-mpd");
+		return 1;
+	}
+	if (path != NULL)
+		fprintf (stderr, "mock-mpd: %u songs, %u queued, listening on %s\n", mock.songs, mock.queue->len, path);
+	else
+		fprintf (stderr, "mock-mpd: %u songs, %u queued, listening on 127.0.0.1:%d\n", mock.songs, mock.queue->len, port);
+
+	while (TRUE)
+	{
+		int client = accept (fd, NULL, NULL);
+
+		if (client < 0)
+			continue;
+		g_thread_unref (g_thread_new ("client", mock_client, GINT_TO_POINTER (client)));
+	}
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Run bench-headless against mock-mpd at increasing library sizes.
+#
+# usage: bench/run-bench.sh [latency_ms] [rounds]
+# Build the programs first with
+#   make -C bench mock-mpd bench-headless
+
+dir=$(dirname "$0")
+latency=${1:-0}
+rounds=${2:-100}
+port=6601
+
+for songs in 1000 10000 100000 1000000; do
+	"$dir/mock-mpd" -p $port -n $songs -q $songs -l $latency &
+	mock=$!
+	sleep 1
+	echo "== $songs songs, ${latency}ms latency"
+	MPD_HOST=127.0.0.1 MPD_PORT=$port "$dir/bench-headless" $rounds
+	kill $mock
+	wait $mock 2>/dev/null
+done
@@ -0,0 +1,242 @@
+/*
+ * gimmix-arena.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gimmix-arena.h"
+
+/* enough for a few hundred formatted rows, a refresh of a long queue
+ * chains more of them */
+#define ARENA_BLOCK_SIZE	(64 * 1024)
+#define ARENA_ALIGN		(sizeof(gpointer))
+
+typedef struct _arena_block {
+	struct _arena_block	*next;
+	gsize			size;
+	gsize			used;
+	gchar			data[1];
+} ArenaBlock;
+
+struct _gimmix_arena {
+	ArenaBlock	*first;
+	ArenaBlock	*current;
+};
+
+static ArenaBlock *
+gimmix_arena_block_new (gsize size)
+{
+	ArenaBlock *block;
+
+	block = g_malloc (G_STRUCT_OFFSET (ArenaBlock, data) + size);
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+
+	return block;
+}
+
+GimmixArena *
+gimmix_arena_new (void)
+{
+	GimmixArena *arena;
+
+	arena = g_new (GimmixArena, 1);
+	arena->first = arena->current = gimmix_arena_block_new (ARENA_BLOCK_SIZE);
+
+	return arena;
+}
+
+/* room for size bytes, without taking it yet */
+static gchar *
+gimmix_arena_reserve (GimmixArena *arena, gsize size)
+{
+	ArenaBlock *block = arena->current;
+
+	/* move on to the blocks left over from earlier refreshes first */
+	while (block->size - block->used < size)
+	{
+		if (block->next == NULL)
+			block->next = gimmix_arena_block_new (MAX (size, ARENA_BLOCK_SIZE));
+		block = block->next;
+		block->used = 0;
+	}
+	arena->current = block;
+
+	return block->data + block->used;
+}
+
+static void
+gimmix_arena_commit (GimmixArena *arena, gsize size)
+{
+	ArenaBlock *block = arena->current;
+
+	block->used = MIN (block->size, (block->used + size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1));
+
+	return;
+}
+
+gpointer
+gimmix_arena_alloc (GimmixArena *arena, gsize size)
+{
+	gchar *ret;
+
+	ret = gimmix_arena_reserve (arena, size);
+	gimmix_arena_commit (arena, size);
+
+	return ret;
+}
+
+gchar *
+gimmix_arena_strdup (GimmixArena *arena, const gchar *str)
+{
+	gsize size;
+
+	if (str == NULL)
+		return NULL;
+
+	size = strlen (str) + 1;
+
+	return memcpy (gimmix_arena_alloc (arena, size), str, size);
+}
+
+gchar *
+gimmix_arena_printf (GimmixArena *arena, const gchar *format, ...)
+{
+	ArenaBlock	*block;
+	va_list		args;
+	gchar		*ret;
+	gsize		avail;
+	gint		len;
+
+	/* most rows fit what is left of the block, print right into it */
+	block = arena->current;
+	avail = block->size - block->used;
+	ret = block->data + block->used;
+	va_start (args, format);
+	len = g_vsnprintf (ret, avail, format, args);
+	va_end (args);
+
+	if ((gsize)len >= avail)
+	{
+		ret = gimmix_arena_reserve (arena, len + 1);
+		va_start (args, format);
+		g_vsnprintf (ret, len + 1, format, args);
+		va_end (args);
+	}
+	gimmix_arena_commit (arena, len + 1);
+
+	return ret;
+}
+
+gchar *
+gimmix_arena_markup_escape (GimmixArena *arena, const gchar *text)
+{
+	const gchar	*p;
+	gchar		*ret;
+	gchar		*q;
+	gsize		size = 1;
+
+	if (text == NULL)
+		return NULL;
+
+	for (p = text; *p != '\0'; p++)
+	{
+		switch (*p)
+		{
+			case '&': size += 5; break;
+			case '<':
+			case '>': size += 4; break;
+			case '\'':
+			case '"': size += 6; break;
+			default: size++; break;
+		}
+	}
+
+	ret = q = gimmix_arena_alloc (arena, size);
+	for (p = text; *p != '\0'; p++)
+	{
+		switch (*p)
+		{
+			case '&': memcpy (q, "&amp;", 5); q += 5; break;
+			case '<': memcpy (q, "&lt;", 4); q += 4; break;
+			case '>': memcpy (q, "&gt;", 4); q += 4; break;
+			case '\'': memcpy (q, "&apos;", 6); q += 6; break;
+			case '"': memcpy (q, "&quot;", 6); q += 6; break;
+			default: *q++ = *p; break;
+		}
+	}
+	*q = '\0';
+
+	return ret;
+}
+
+gchar *
+gimmix_arena_song_name (GimmixArena *arena, const gchar *path)
+{
+	const gchar	*base;
+	const gchar	*ext;
+	gchar		*ret;
+	gsize		len;
+
+	if (path == NULL)
+		return NULL;
+
+	base = strrchr (path, '/');
+	base = (base != NULL) ? base + 1 : path;
+	/* like gimmix_strip_file_ext (), a leading dot is kept */
+	ext = strrchr (base, '.');
+	len = (ext != NULL && ext != base) ? (gsize)(ext - base) : strlen (base);
+
+	ret = gimmix_arena_alloc (arena, len + 1);
+	memcpy (ret, base, len);
+	ret[len] = '\0';
+
+	return ret;
+}
+
+void
+gimmix_arena_reset (GimmixArena *arena)
+{
+	arena->current = arena->first;
+	arena->first->used = 0;
+
+	return;
+}
+
+void
+gimmix_arena_free (GimmixArena *arena)
+{
+	ArenaBlock *block;
+
+	if (arena == NULL)
+		return;
+
+	while ((block = arena->first) != NULL)
+	{
+		arena->first = block->next;
+		g_free (block);
+	}
+	g_free (arena);
+
+	return;
+}
@@ -0,0 +1,29 @@
+#ifndef GIMMIX_ARENA_H
+#define GIMMIX_ARENA_H
+
+#include <glib.h>
+
+/* A bump allocator for the short lived strings made while the rows of
+ * a view are formatted. Allocations are never freed one by one, the
+ * whole arena is reset once the rows are in the store, and its blocks
+ * are reused by the next refresh. */
+typedef struct _gimmix_arena GimmixArena;
+
+GimmixArena *gimmix_arena_new (void);
+
+gpointer gimmix_arena_alloc (GimmixArena *arena, gsize size);
+gchar *gimmix_arena_strdup (GimmixArena *arena, const gchar *str);
+gchar *gimmix_arena_printf (GimmixArena *arena, const gchar *format, ...) G_GNUC_PRINTF (2, 3);
+
+/* text with &, <, >, ' and " replaced by entities, for markup */
+gchar *gimmix_arena_markup_escape (GimmixArena *arena, const gchar *text);
+
+/* the last component of path without its extension */
+gchar *gimmix_arena_song_name (GimmixArena *arena, const gchar *path);
+
+/* forget everything allocated, the memory is kept for reuse */
+void gimmix_arena_reset (GimmixArena *arena);
+
+void gimmix_arena_free (GimmixArena *arena);
+
+#endif
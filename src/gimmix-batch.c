@@ -0,0 +1,248 @@
+/*
+ * gimmix-batch.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <libmpd/libmpd.h>
+
+#include "gimmix-batch.h"
+#include "gimmix-mpdio.h"
+#include "gimmix-status.h"
+
+/* mpd refuses command lists above max_command_list_size (2 MB by
+ * default), so large selections are split. A chunk is only sent once
+ * the one before it went through, mpd must not run the rest of a batch
+ * whose beginning failed. */
+#define BATCH_CHUNK_BYTES	(256 * 1024)
+
+extern MpdObj		*gmo;
+
+struct _gimmix_batch {
+	GPtrArray	*commands;
+};
+
+typedef struct _gimmix_batch_commit {
+	GPtrArray	*commands;
+	guint		next;		/* first command not sent yet */
+	GimmixBatchDone	done;
+	gpointer	data;
+} GimmixBatchCommit;
+
+GimmixBatch *
+gimmix_batch_new (void)
+{
+	GimmixBatch *batch;
+
+	batch = g_new0 (GimmixBatch, 1);
+	batch->commands = g_ptr_array_new_with_free_func (g_free);
+
+	return batch;
+}
+
+static void
+gimmix_batch_append (GimmixBatch *batch, gchar *command)
+{
+	g_ptr_array_add (batch->commands, command);
+
+	return;
+}
+
+void
+gimmix_batch_add (GimmixBatch *batch, const char *path)
+{
+	gchar *arg = gimmix_mpd_quote (path);
+
+	gimmix_batch_append (batch, g_strconcat ("add ", arg, NULL));
+	g_free (arg);
+
+	return;
+}
+
+void
+gimmix_batch_delete_id (GimmixBatch *batch, int id)
+{
+	gimmix_batch_append (batch, g_strdup_printf ("deleteid %d", id));
+
+	return;
+}
+
+void
+gimmix_batch_delete_range (GimmixBatch *batch, int start, int end)
+{
+	gimmix_batch_append (batch, g_strdup_printf ("delete %d:%d", start, end));
+
+	return;
+}
+
+void
+gimmix_batch_move_id (GimmixBatch *batch, int id, int pos)
+{
+	gimmix_batch_append (batch, g_strdup_printf ("moveid %d %d", id, pos));
+
+	return;
+}
+
+void
+gimmix_batch_play_id (GimmixBatch *batch, int id)
+{
+	gimmix_batch_append (batch, g_strdup_printf ("playid %d", id));
+
+	return;
+}
+
+void
+gimmix_batch_play_pos (GimmixBatch *batch, int pos)
+{
+	gimmix_batch_append (batch, g_strdup_printf ("play %d", pos));
+
+	return;
+}
+
+void
+gimmix_batch_play (GimmixBatch *batch)
+{
+	gimmix_batch_append (batch, g_strdup ("play"));
+
+	return;
+}
+
+void
+gimmix_batch_clear (GimmixBatch *batch)
+{
+	gimmix_batch_append (batch, g_strdup ("clear"));
+
+	return;
+}
+
+void
+gimmix_batch_load (GimmixBatch *batch, const char *playlist)
+{
+	gchar *arg = gimmix_mpd_quote (playlist);
+
+	gimmix_batch_append (batch, g_strconcat ("load ", arg, NULL));
+	g_free (arg);
+
+	return;
+}
+
+guint
+gimmix_batch_length (GimmixBatch *batch)
+{
+	return batch->commands->len;
+}
+
+static void gimmix_batch_send_chunk (GimmixBatchCommit *commit);
+
+static void
+gimmix_batch_commit_finish (GimmixBatchCommit *commit, gboolean ok, const char *error)
+{
+	/* one refresh for the whole batch */
+	gimmix_status_refresh ();
+	if (commit->done)
+		commit->done (ok, error, commit->data);
+	g_ptr_array_free (commit->commands, TRUE);
+	g_free (commit);
+
+	return;
+}
+
+static void
+gimmix_batch_chunk_done (const GimmixMpdReply *reply, gpointer data)
+{
+	GimmixBatchCommit *commit = data;
+
+	if (!reply->ok)
+	{
+		/* mpd stops executing a list at the first failing command,
+		 * the chunks after it are not sent at all */
+		fprintf (stderr, "batch: %s\n", reply->error);
+		gimmix_batch_commit_finish (commit, FALSE, reply->error);
+		return;
+	}
+	if (commit->next < commit->commands->len)
+	{
+		gimmix_batch_send_chunk (commit);
+		return;
+	}
+	gimmix_batch_commit_finish (commit, TRUE, NULL);
+
+	return;
+}
+
+static void
+gimmix_batch_send_chunk (GimmixBatchCommit *commit)
+{
+	GPtrArray	*chunk;
+	gsize		bytes = 0;
+
+	chunk = g_ptr_array_new ();
+	while (commit->next < commit->commands->len)
+	{
+		gchar	*cmd = g_ptr_array_index (commit->commands, commit->next);
+		gsize	len = strlen (cmd) + 1;
+
+		if (bytes && bytes + len > BATCH_CHUNK_BYTES)
+			break;
+		g_ptr_array_add (chunk, cmd);
+		bytes += len;
+		commit->next++;
+	}
+	g_ptr_array_add (chunk, NULL);
+	gimmix_mpdio_command_list (gimmix_batch_chunk_done, commit, (const char * const *)chunk->pdata);
+	g_ptr_array_free (chunk, TRUE);
+
+	return;
+}
+
+void
+gimmix_batch_commit (GimmixBatch *batch, GimmixBatchDone done, gpointer data)
+{
+	GimmixBatchCommit	*commit;
+
+	if (batch->commands->len == 0)
+	{
+		gimmix_batch_free (batch);
+		if (done)
+			done (TRUE, NULL, data);
+		return;
+	}
+
+	/* the commit takes over the commands */
+	commit = g_new0 (GimmixBatchCommit, 1);
+	commit->commands = batch->commands;
+	commit->done = done;
+	commit->data = data;
+	g_free (batch);
+
+	gimmix_batch_send_chunk (commit);
+
+	return;
+}
+
+void
+gimmix_batch_free (GimmixBatch *batch)
+{
+	g_ptr_array_free (batch->commands, TRUE);
+	g_free (batch);
+
+	return;
+}
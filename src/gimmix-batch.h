@@ -0,0 +1,37 @@
+#ifndef GIMMIX_BATCH_H
+#define GIMMIX_BATCH_H
+
+#include <glib.h>
+
+/* Groups playlist operations into command lists that are sent through
+ * the I/O thread, followed by a single status refresh. */
+typedef struct _gimmix_batch GimmixBatch;
+
+/* Called from the main loop once the whole batch went through, or
+ * with the error of the first command that failed. Nothing after that
+ * command has been run. */
+typedef void (*GimmixBatchDone) (gboolean ok, const char *error, gpointer data);
+
+GimmixBatch *gimmix_batch_new (void);
+
+/* queue operations, paths are relative to the music directory */
+void gimmix_batch_add (GimmixBatch *batch, const char *path);
+void gimmix_batch_delete_id (GimmixBatch *batch, int id);
+void gimmix_batch_delete_range (GimmixBatch *batch, int start, int end);
+void gimmix_batch_move_id (GimmixBatch *batch, int id, int pos);
+void gimmix_batch_play_id (GimmixBatch *batch, int id);
+void gimmix_batch_play_pos (GimmixBatch *batch, int pos);
+void gimmix_batch_play (GimmixBatch *batch);
+void gimmix_batch_clear (GimmixBatch *batch);
+void gimmix_batch_load (GimmixBatch *batch, const char *playlist);
+
+/* number of queued operations */
+guint gimmix_batch_length (GimmixBatch *batch);
+
+/* send the batch and free it, done may be NULL */
+void gimmix_batch_commit (GimmixBatch *batch, GimmixBatchDone done, gpointer data);
+
+/* drop the batch without sending anything */
+void gimmix_batch_free (GimmixBatch *batch);
+
+#endif
@@ -61,6 +61,7 @@ gimmix_config_init (void)
 	cfg_add_key (&conf, "pl_column_artist_show",	"false");
 	cfg_add_key (&conf, "pl_column_album_show",	"false");
 	cfg_add_key (&conf, "pl_column_length_show",	"true");
+	cfg_add_key (&conf, "playlist_paged_min",	"5000");
 	#ifdef HAVE_COVER_PLUGIN
 	cfg_add_key (&conf, "coverart_enable",		"true");
 	/* set United States as the default cover location */
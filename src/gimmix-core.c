@@ -24,8 +24,29 @@
 
 #include "gimmix-core.h"
 #include "gimmix.h"
+#include "gimmix-mpdio.h"
+#include "gimmix-status.h"
+
+/* Volume and seek changes come in bursts while a slider is dragged or
+ * the mouse wheel turned. They are sent at most once per COALESCE_MS,
+ * with the latest value of the burst. */
+#define COALESCE_MS	80
 
 extern ConfigFile 	conf;
+extern MpdObj		*gmo;
+
+static int		volume_value;
+static guint		volume_source = 0;
+static guint		volume_inflight = 0;
+
+static int		seek_song_id;
+static int		seek_time;
+static guint		seek_source = 0;
+static guint		seek_inflight = 0;
+
+/* images and stock icons by name and size, see gimmix_get_pixbuf () */
+static GHashTable	*pixbuf_cache = NULL;
+static GMutex		pixbuf_mutex;
 
 GimmixStatus
 gimmix_get_status (MpdObj *mo)
@@ -34,8 +55,9 @@ gimmix_get_status (MpdObj *mo)
 	if (!mo || !mpd_check_connected(mo))
 		return ERROR;
 	
-	mpd_status_queue_update (mo);
-	mpd_status_update (mo);
+	/* the timer keeps the status current, only a refresh requested
+	 * by a command that was just sent has to be fetched first */
+	gimmix_status_flush ();
 	status = mpd_player_get_state (mo);
 	
 	if (status == MPD_PLAYER_PAUSE)
@@ -47,6 +69,20 @@ gimmix_get_status (MpdObj *mo)
 	return UNKNOWN;
 }
 
+/* completion of commands sent through the I/O thread */
+static void
+gimmix_command_done (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	if (!reply->ok)
+		printf ("%s: %s\n", _("Error"), reply->error);
+
+	/* the next status poll picks up the change */
+	if (gmo != NULL)
+		mpd_status_queue_update (gmo);
+
+	return;
+}
+
 bool
 gimmix_play (MpdObj *mo)
 {
@@ -58,13 +94,13 @@ gimmix_play (MpdObj *mo)
 
 		if (state == MPD_PLAYER_PAUSE || state == MPD_PLAYER_STOP)
 		{	
-			mpd_player_play (mo);
+			gimmix_mpdio_command (gimmix_command_done, NULL, "play");
 			return true;
 		}
 
 		else if (state == MPD_PLAYER_PLAY)
 		{
-			mpd_player_pause (mo);
+			gimmix_mpdio_command (gimmix_command_done, NULL, "pause 1");
 			return false;
 		}
 	}
@@ -76,11 +112,11 @@ bool
 gimmix_stop (MpdObj *mo)
 {
 	int state;
-	state = gimmix_get_status (mo);
+	state = mpd_player_get_state (mo);
 
-	if (state == PLAY || state == PAUSE)
+	if (state == MPD_PLAYER_PLAY || state == MPD_PLAYER_PAUSE)
 	{
-		mpd_player_stop (mo);
+		gimmix_mpdio_command (gimmix_command_done, NULL, "stop");
 		return true;
 	}
 	
@@ -92,9 +128,9 @@ gimmix_prev (MpdObj *mo)
 {
 	int state;
 	
-	mpd_player_prev (mo);
-	state = gimmix_get_status (mo);
-	if (state == PLAY || state == PAUSE)
+	gimmix_mpdio_command (gimmix_command_done, NULL, "previous");
+	state = mpd_player_get_state (mo);
+	if (state == MPD_PLAYER_PLAY || state == MPD_PLAYER_PAUSE)
 	{
 		return true;
 	}
@@ -107,9 +143,9 @@ gimmix_next (MpdObj *mo)
 {
 	int state;
 	
-	mpd_player_next (mo);
-	state = gimmix_get_status (mo);
-	if (state == PLAY || state == PAUSE)
+	gimmix_mpdio_command (gimmix_command_done, NULL, "next");
+	state = mpd_player_get_state (mo);
+	if (state == MPD_PLAYER_PLAY || state == MPD_PLAYER_PAUSE)
 	{
 		return true;
 	}
@@ -117,6 +153,57 @@ gimmix_next (MpdObj *mo)
 	return false;
 }
 
+void
+gimmix_set_repeat (bool repeat)
+{
+	gimmix_mpdio_command (gimmix_command_done, NULL, "repeat %d", repeat ? 1 : 0);
+
+	return;
+}
+
+void
+gimmix_set_random (bool random)
+{
+	gimmix_mpdio_command (gimmix_command_done, NULL, "random %d", random ? 1 : 0);
+
+	return;
+}
+
+static void
+gimmix_volume_done (const GimmixMpdReply *reply, gpointer data)
+{
+	volume_inflight--;
+	gimmix_command_done (reply, data);
+
+	return;
+}
+
+static gboolean
+gimmix_volume_send (G_GNUC_UNUSED gpointer data)
+{
+	volume_source = 0;
+	volume_inflight++;
+	gimmix_mpdio_command (gimmix_volume_done, NULL, "setvol %d", volume_value);
+
+	return FALSE;
+}
+
+void
+gimmix_set_volume (int volume)
+{
+	volume_value = CLAMP (volume, 0, 100);
+	if (volume_source == 0)
+		volume_source = g_timeout_add (COALESCE_MS, gimmix_volume_send, NULL);
+
+	return;
+}
+
+bool
+gimmix_volume_pending (void)
+{
+	return (volume_source != 0 || volume_inflight > 0);
+}
+
 bool
 is_gimmix_repeat (MpdObj *mo)
 {
@@ -141,29 +228,47 @@ is_gimmix_shuffle (MpdObj *mo)
 	return FALSE;
 }
 
+static void
+gimmix_seek_done (const GimmixMpdReply *reply, gpointer data)
+{
+	seek_inflight--;
+	gimmix_command_done (reply, data);
+
+	return;
+}
+
+static gboolean
+gimmix_seek_send (G_GNUC_UNUSED gpointer data)
+{
+	seek_source = 0;
+	seek_inflight++;
+	gimmix_mpdio_command (gimmix_seek_done, NULL, "seekid %d %d", seek_song_id, seek_time);
+
+	return FALSE;
+}
+
 bool
 gimmix_seek (MpdObj *mo, int seektime)
 {
 	int state;
-	bool ret;
-	state = gimmix_get_status (mo);
+	state = mpd_player_get_state (mo);
 
-	if (state == PLAY || state == PAUSE)
+	if (state == MPD_PLAYER_PLAY || state == MPD_PLAYER_PAUSE)
 	{
-		int i;
-		i = mpd_player_seek (mo, seektime);
-		if (i == MPD_OK)
-			ret = true;
-		else
-		{
-			printf ("%s %d: %s\n", _("Error"), i, _("Status Failed."));
-			ret = false;
-		}
+		seek_song_id = mpd_player_get_current_song_id (mo);
+		seek_time = seektime;
+		if (seek_source == 0)
+			seek_source = g_timeout_add (COALESCE_MS, gimmix_seek_send, NULL);
+		return true;
 	}
-	else
-	ret = false;
 
-	return ret;
+	return false;
+}
+
+bool
+gimmix_seek_pending (void)
+{
+	return (seek_source != 0 || seek_inflight > 0);
 }
 
 void
@@ -178,8 +283,12 @@ gimmix_get_progress_status (MpdObj *mo, float *fraction, char *time)
 	{
 		case MPD_PLAYER_PLAY:
 		case MPD_PLAYER_PAUSE:
-			total = mpd_status_get_total_song_time (mo);
-			elapsed = mpd_status_get_elapsed_song_time (mo);
+			/* the poll has the newer play time */
+			if (!gimmix_status_get_time (&elapsed, &total))
+			{
+				total = mpd_status_get_total_song_time (mo);
+				elapsed = mpd_status_get_elapsed_song_time (mo);
+			}
 			snprintf (time, 20, "%02i:%02i / %02i:%02i", elapsed/60,
 					elapsed%60,
 					total/60,
@@ -234,6 +343,87 @@ gimmix_get_full_image_path (const char *image_name)
 	return full_path;
 }
 
+static GdkPixbuf *
+gimmix_pixbuf_cache_lookup (const char *key)
+{
+	GdkPixbuf *pixbuf = NULL;
+
+	if (pixbuf_cache != NULL && (pixbuf = g_hash_table_lookup (pixbuf_cache, key)) != NULL)
+		g_object_ref (pixbuf);
+
+	return pixbuf;
+}
+
+static void
+gimmix_pixbuf_cache_insert (char *key, GdkPixbuf *pixbuf)
+{
+	if (pixbuf_cache == NULL)
+		pixbuf_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+	g_hash_table_insert (pixbuf_cache, key, g_object_ref (pixbuf));
+
+	return;
+}
+
+GdkPixbuf *
+gimmix_get_pixbuf (const char *image_name, int width, int height)
+{
+	GdkPixbuf	*pixbuf;
+	char		*key;
+	char		*path;
+
+	key = g_strdup_printf ("%s@%dx%d", image_name, width, height);
+	g_mutex_lock (&pixbuf_mutex);
+	if ((pixbuf = gimmix_pixbuf_cache_lookup (key)) != NULL)
+	{
+		g_mutex_unlock (&pixbuf_mutex);
+		g_free (key);
+		return pixbuf;
+	}
+
+	path = gimmix_get_full_image_path (image_name);
+	pixbuf = gdk_pixbuf_new_from_file_at_size (path, width, height, NULL);
+	g_free (path);
+	if (pixbuf != NULL)
+		gimmix_pixbuf_cache_insert (key, pixbuf);
+	else
+		g_free (key);
+	g_mutex_unlock (&pixbuf_mutex);
+
+	return pixbuf;
+}
+
+GdkPixbuf *
+gimmix_get_stock_pixbuf (GtkWidget *widget, const char *stock_id, GtkIconSize size)
+{
+	GdkPixbuf	*pixbuf;
+	char		*key;
+
+	key = g_strdup_printf ("stock:%s@%d", stock_id, size);
+	g_mutex_lock (&pixbuf_mutex);
+	if ((pixbuf = gimmix_pixbuf_cache_lookup (key)) == NULL &&
+		(pixbuf = gtk_widget_render_icon (widget, stock_id, size, NULL)) != NULL)
+	{
+		gimmix_pixbuf_cache_insert (key, pixbuf);
+		key = NULL;
+	}
+	g_mutex_unlock (&pixbuf_mutex);
+	g_free (key);
+
+	return pixbuf;
+}
+
+void
+gimmix_pixbuf_cache_cleanup (void)
+{
+	g_mutex_lock (&pixbuf_mutex);
+	if (pixbuf_cache != NULL)
+		g_hash_table_destroy (pixbuf_cache);
+	pixbuf_cache = NULL;
+	g_mutex_unlock (&pixbuf_mutex);
+
+	return;
+}
+
 void
 gimmix_strip_file_ext (char *string)
 {
@@ -271,6 +461,135 @@ gimmix_strcrep (char *string, char c1, char c2)
 	return;
 }
 
+static gint
+gimmix_strcmp (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*(const char**)a, *(const char**)b);
+}
+
+char **
+gimmix_get_update_dirs (GList *paths)
+{
+	GPtrArray	*dirs;
+	GPtrArray	*ret;
+	GHashTable	*covered;
+	GList		*l;
+	guint		i;
+
+	dirs = g_ptr_array_new_with_free_func (g_free);
+	for (l = paths; l != NULL; l = l->next)
+	{
+		char *dir = g_path_get_dirname ((char*)l->data);
+
+		/* a file in the top level directory is updated by itself,
+		 * mpd accepts file paths as well */
+		if (!strcmp(dir, ".") || !strcmp(dir, "/") || !strlen(dir))
+		{
+			g_free (dir);
+			dir = g_strdup ((char*)l->data);
+		}
+		g_ptr_array_add (dirs, dir);
+	}
+
+	ret = g_ptr_array_new ();
+
+	/* parents sort before their children, so every directory only
+	 * has to be checked against the ones already taken */
+	g_ptr_array_sort (dirs, gimmix_strcmp);
+	covered = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < dirs->len; i++)
+	{
+		char		*dir = g_ptr_array_index (dirs, i);
+		char		*parent;
+		char		*p;
+		gboolean	skip = FALSE;
+
+		if (g_hash_table_contains (covered, dir))
+			continue;
+
+		parent = g_strdup (dir);
+		while ((p = strrchr (parent, '/')) != NULL)
+		{
+			*p = '\0';
+			if (g_hash_table_contains (covered, parent))
+			{
+				skip = TRUE;
+				break;
+			}
+		}
+		g_free (parent);
+		if (skip)
+			continue;
+
+		g_hash_table_add (covered, dir);
+		g_ptr_array_add (ret, g_strdup (dir));
+	}
+	g_hash_table_destroy (covered);
+	g_ptr_array_free (dirs, TRUE);
+	g_ptr_array_add (ret, NULL);
+
+	return (char**)g_ptr_array_free (ret, FALSE);
+}
+
+static void
+gimmix_database_update_done (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	if (!reply->ok)
+		fprintf (stderr, "update: %s\n", reply->error);
+	/* updating_db shows up in the status */
+	gimmix_status_refresh ();
+
+	return;
+}
+
+void
+gimmix_database_update_paths (G_GNUC_UNUSED MpdObj *mo, GList *paths)
+{
+	char	**dirs;
+	char	**cmds;
+	int	i;
+
+	if (paths == NULL)
+		return;
+
+	/* one command list through the I/O thread */
+	dirs = gimmix_get_update_dirs (paths);
+	cmds = g_new0 (char*, g_strv_length (dirs) + 1);
+	for (i = 0; dirs[i] != NULL; i++)
+	{
+		char *arg = gimmix_mpd_quote (dirs[i]);
+
+		cmds[i] = g_strconcat ("update ", arg, NULL);
+		g_free (arg);
+	}
+	gimmix_mpdio_command_list (gimmix_database_update_done, NULL, (const char * const *)cmds);
+	g_strfreev (cmds);
+	g_strfreev (dirs);
+
+	return;
+}
+
+const char *
+gimmix_path_strip_music_dir (const char *path)
+{
+	const char	*music_dir;
+	size_t		len;
+
+	music_dir = cfg_get_key_value (conf, "music_directory");
+	if (music_dir == NULL)
+		return path;
+
+	len = strlen (music_dir);
+	while (len && music_dir[len-1] == '/')
+		len--;
+	if (!strncmp (path, music_dir, len) && path[len] == '/')
+		path += len;
+	while (*path == '/')
+		path++;
+
+	return path;
+}
+
 double
 gimmix_get_libmpd_version (void)
 {
@@ -7,6 +7,7 @@
 #include <stdbool.h>
 #include "gimmix.h"
 #include "gimmix-config.h"
+#include "gimmix-song.h"
 
 typedef enum { 	PLAY = 1,
 		PAUSE,
@@ -19,16 +20,35 @@ typedef enum { 	PLAY = 1,
 MpdObj * gimmix_mpd_connect (void);
 void gimmix_disconnect (MpdObj *);
 
-/* playback control */
+/* playback control, the commands are sent asynchronously */
 bool gimmix_play (MpdObj *);
 bool gimmix_stop (MpdObj *);
 bool gimmix_prev (MpdObj *);
 bool gimmix_next (MpdObj *);
 bool gimmix_seek (MpdObj *, int);
+void gimmix_set_repeat (bool);
+void gimmix_set_random (bool);
+void gimmix_set_volume (int);
+
+/* volume and seek changes are coalesced, these are true while one
+ * has not been applied by mpd yet */
+bool gimmix_volume_pending (void);
+bool gimmix_seek_pending (void);
 
 /* get full image path (returned string should be freed) */
 char *gimmix_get_full_image_path (const char *);
 
+/* get one of the installed images scaled to width x height (-1 leaves a
+ * side unconstrained). Every image and size is only loaded once, release
+ * the returned reference with g_object_unref () */
+GdkPixbuf *gimmix_get_pixbuf (const char *, int, int);
+
+/* get a stock icon, rendered once per size like gimmix_get_pixbuf () */
+GdkPixbuf *gimmix_get_stock_pixbuf (GtkWidget *, const char *, GtkIconSize);
+
+/* drop the cached images */
+void gimmix_pixbuf_cache_cleanup (void);
+
 /* Get the "elapsed time / total time" as a string */
 void gimmix_get_progress_status (MpdObj *, float *, char *);
 
@@ -48,6 +68,18 @@ void gimmix_strip_file_ext (char *string);
 /* replace character c1 by c2 in string */
 void gimmix_strcrep (char *string, char c1, char c2);
 
+/* Get the smallest set of directories that covers all given paths.
+ * The paths are relative to the music directory, files at its top
+ * level are returned as they are. Free the returned array with
+ * g_strfreev () */
+char **gimmix_get_update_dirs (GList *);
+
+/* Rescan only the directories containing the given files */
+void gimmix_database_update_paths (MpdObj *, GList *);
+
+/* get a path relative to the music directory (points into the given string) */
+const char *gimmix_path_strip_music_dir (const char *);
+
 /* get libmpd version as double */
 double gimmix_get_libmpd_version (void);
 
@@ -37,6 +37,7 @@
 #include "gimmix-metadata.h"
 #include "gimmix-covers.h"
 #include "gimmix-tagedit.h"
+#include "gimmix-dispatch.h"
 
 #define DEFAULT_COVER	"gimmix-album.png"
 #define COVERS_DIR	".gimmix/covers"
@@ -49,20 +50,37 @@ static guint h3_size = 0;
 extern GtkBuilder	*xml;
 extern ConfigFile	conf;
 extern MpdObj		*gmo;
-extern mpd_Song		*glob_song_info;
 extern GimmixTooltip 	*tooltip;
 extern GtkWidget	*main_window;
 
 static ConfigFile	cover_db;
 static CURL		*curl;
 static char		*cover_image_path;
-static GtkWidget	*gimmix_metadata_image;
 static GtkWidget	*gimmix_plcbox_image;
 static GtkWidget	*gimmix_plcbox_eventbox;
 
 GtkWidget		*gimmix_plcbox_frame;
 static GMutex		c_mutex;
 
+/* bumped for every cover request, only the newest one is shown */
+static guint		cover_request_serial = 0;
+
+/* what a cover worker needs, snapshotted on the main thread */
+typedef struct _cover_request {
+	guint		serial;
+	GimmixSong	*song;		/* NULL for the default cover */
+	guint		height;
+	gboolean	tooltip;
+} CoverRequest;
+
+/* pixbufs handed back to the main loop */
+typedef struct _cover_result {
+	guint		serial;
+	GdkPixbuf	*plcbox;
+	GdkPixbuf	*tagedit;
+	GdkPixbuf	*tooltip;
+} CoverResult;
+
 /* Get metadata for the specified arguments */
 static CoverNode* gimmix_covers_plugin_get_metadata (char *artist, char *album);
 
@@ -74,7 +92,7 @@ static CoverNode* gimmix_cover_node_new (void);
 static gchar *gimmix_url_encode (const char *string);
 static void gimmix_covers_plugin_cover_db_init (void);
 static void gimmix_covers_plugin_cover_db_save (void);
-static void gimmix_covers_plugin_find_cover (mpd_Song *s);
+static void gimmix_covers_plugin_find_cover (GimmixSong *s);
 static void gimmix_cover_plugin_save_cover (char *artist, char *album);
 
 static void
@@ -118,9 +136,7 @@ cb_gimmix_covers_plugin_cover_file_preview (GtkFileChooser *file_chooser, gpoint
 static void
 cb_gimmix_covers_plugin_refetch_cover (void)
 {
-	g_thread_new ("covers_plugin_update_cover",
-			(GThreadFunc)gimmix_covers_plugin_update_cover,
-			FALSE);
+	gimmix_covers_plugin_update_cover (FALSE);
 
 	return;
 }
@@ -131,15 +147,16 @@ cb_gimmix_covers_plugin_set_cover_from_file (void)
 	GtkWidget	*dialog;
 	GtkFileFilter	*filter = NULL;
 	GtkImage	*preview;
-	mpd_Song	*song = NULL;
+	GimmixSong	*song = NULL;
 	gchar		*artist = NULL;
 	gchar		*album = NULL;
 	
-	if (!(song=mpd_playlist_get_current_song(gmo)))
+	if (!(song=gimmix_song_get_current()))
 		return;
 	
 	artist = (song->artist != NULL) ? g_strdup (song->artist) : NULL;
 	album = (song->album != NULL) ? g_strdup (song->album) : NULL;
+	gimmix_song_unref (song);
 	dialog = gtk_file_chooser_dialog_new ("Open File",
 					GTK_WINDOW(main_window),
 					GTK_FILE_CHOOSER_ACTION_OPEN,
@@ -170,9 +187,7 @@ cb_gimmix_covers_plugin_set_cover_from_file (void)
 				if (artist!=NULL && album!=NULL)
 				{
 					gimmix_cover_plugin_save_cover (artist, album);
-					g_thread_new ("covers_plugin_update_cover",
-							(GThreadFunc)gimmix_covers_plugin_update_cover,
-							FALSE);
+					gimmix_covers_plugin_update_cover (FALSE);
 					g_free (artist);
 					g_free (album);
 				}
@@ -272,7 +287,6 @@ gimmix_covers_plugin_init (void)
 	/* initialize metadata widgets */
 	gimmix_plcbox_eventbox = GTK_WIDGET (gtk_builder_get_object (xml, "cover_event_box"));
 	gimmix_plcbox_image = GTK_WIDGET (gtk_builder_get_object (xml, "gimmix_plcbox_image"));
-	gimmix_metadata_image = GTK_WIDGET (gtk_builder_get_object (xml, "gimmix_metadata_image"));
 	gimmix_plcbox_frame = GTK_WIDGET (gtk_builder_get_object (xml, "gimmix_plc_image_frame"));
 	
 	/* some signals */
@@ -644,7 +658,7 @@ gimmix_covers_plugin_save_albuminfo (char *artist, char *album, char *info)
 }
 
 gchar*
-gimmix_covers_plugin_get_albuminfo (mpd_Song *s)
+gimmix_covers_plugin_get_albuminfo (GimmixSong *s)
 {
 	FILE	*fp = NULL;
 	char	*artist_e = NULL;
@@ -732,47 +746,30 @@ gimmix_covers_plugin_set_cover_image_path (const char *path)
 static GdkPixbuf*
 gimmix_covers_plugin_get_default_cover (guint width, guint height)
 {
-	GdkPixbuf	*ret = NULL;
-	gchar		*path = NULL;
-	
-	path = gimmix_get_full_image_path (DEFAULT_COVER);
-	ret = gdk_pixbuf_new_from_file_at_size (path, width, height, NULL);
-	g_free (path);
-	
-	return ret;
+	return gimmix_get_pixbuf (DEFAULT_COVER, width, height);
 }
 
-GdkPixbuf*
+/* load the current cover (or the default one), called with c_mutex held */
+static GdkPixbuf*
 gimmix_covers_plugin_get_cover_image_of_size (guint width, guint height)
 {
 	GdkPixbuf	*pixbuf = NULL;
-	int		status;
-	//g_print ("gimmix_covers_plugin_get_cover_image_of_size() called\n");
-	status = gimmix_get_status (gmo);
-	if (status == STOP || status == ERROR)
+
+	if (!cover_image_path)
 	{
 		/* set default image */
 		pixbuf = gimmix_covers_plugin_get_default_cover (width, height);
 	}
 	else
 	{
-		if (!cover_image_path)
-		{
-			/* set default image */
-			//g_print ("cover_image_path is NULL\n");
-			pixbuf = gimmix_covers_plugin_get_default_cover (width, height);
-		}
-		else
-		{
-			pixbuf = gdk_pixbuf_new_from_file_at_size (cover_image_path, width, height, NULL);
-		}
+		pixbuf = gdk_pixbuf_new_from_file_at_size (cover_image_path, width, height, NULL);
 	}
 
 	return pixbuf;
 }
 
 static void
-gimmix_covers_plugin_find_cover (mpd_Song *s)
+gimmix_covers_plugin_find_cover (GimmixSong *s)
 {
 	CoverNode	*node = NULL;
 	char		*temp = NULL;
@@ -880,64 +877,113 @@ gimmix_covers_plugin_find_cover (mpd_Song *s)
 	return;
 }
 
-/* if default = TRUE, set the default cover */
-void
-gimmix_covers_plugin_update_cover (gboolean defaultc)
+static void
+gimmix_covers_plugin_cover_result_apply (CoverResult *res)
 {
-	guint		height;
-	GdkPixbuf	*pixbuf = NULL;
+	/* a later request has been made while this one was running */
+	if (res->serial != cover_request_serial)
+		return;
+
+	if (res->plcbox == NULL)
+		return;
 
+	/* main window cover art */
+	gtk_image_set_from_pixbuf (GTK_IMAGE(gimmix_plcbox_image), res->plcbox);
+
+	/* tag editor cover image */
+	if (res->tagedit)
+		gimmix_tag_editor_set_cover_image (res->tagedit);
+
+	/* also system tray tooltip image */
+	if (res->tooltip)
+		gimmix_tooltip_set_icon (tooltip, res->tooltip);
+
+	return;
+}
+
+static void
+gimmix_covers_plugin_cover_result_free (CoverResult *res)
+{
+	if (res->plcbox)
+		g_object_unref (res->plcbox);
+	if (res->tagedit)
+		g_object_unref (res->tagedit);
+	if (res->tooltip)
+		g_object_unref (res->tooltip);
+	g_free (res);
+
+	return;
+}
+
+static const GimmixResultType cover_result_type = {
+	"cover",
+	(void (*) (gpointer))gimmix_covers_plugin_cover_result_apply,
+	(GDestroyNotify)gimmix_covers_plugin_cover_result_free,
+	TRUE
+};
+
+static gpointer
+gimmix_covers_plugin_update_cover_thread (CoverRequest *req)
+{
+	CoverResult	*res;
+
+	res = g_new0 (CoverResult, 1);
+	res->serial = req->serial;
 	g_mutex_lock (&c_mutex);
-	height = h3_size;
-	if (!defaultc)
+	if (req->song != NULL)
 	{
-		mpd_Song *s = NULL;
-		mpd_Song *sng = mpd_newSong ();
-		while (!(s=mpd_playlist_get_current_song(gmo)))
-			sleep (1);
-		sng = mpd_songDup (s);
-		gimmix_covers_plugin_find_cover (sng);
-		pixbuf = gimmix_covers_plugin_get_cover_image_of_size (96, height);
-		mpd_freeSong (sng);
+		gimmix_covers_plugin_find_cover (req->song);
+		res->plcbox = gimmix_covers_plugin_get_cover_image_of_size (96, req->height);
+		if (res->plcbox != NULL)
+		{
+			res->tagedit = gimmix_covers_plugin_get_cover_image_of_size (96, 96);
+			if (req->tooltip)
+				res->tooltip = gimmix_covers_plugin_get_cover_image_of_size (48, 48);
+		}
 	}
 	else
 	{
-		pixbuf = gimmix_covers_plugin_get_default_cover (96, height);
-	}
-	
-	if (pixbuf != NULL)
-	{
-		/* main window cover art */
-		gdk_threads_enter ();
-		gtk_image_set_from_pixbuf (GTK_IMAGE(gimmix_plcbox_image), pixbuf);
-		gdk_flush ();
-		gdk_threads_leave ();
-		g_object_unref (pixbuf);
-		
-		/* metadata albuminfo */
-		// gimmix_metadata_set_song_details (s, areview);
-
-		/* tag editor cover image */
-		pixbuf = gimmix_covers_plugin_get_cover_image_of_size (96, 96);
-		gdk_threads_enter ();
-		gimmix_tag_editor_set_cover_image (pixbuf);
-		gdk_flush ();
-		gdk_threads_leave ();
-		g_object_unref (pixbuf);
-
-		/* also system tray tooltip image */
-		if (gimmix_config_get_bool("enable_systray"))
+		res->plcbox = gimmix_covers_plugin_get_default_cover (96, req->height);
+		if (res->plcbox != NULL)
 		{
-			if (gimmix_config_get_bool("enable_notification"))
-			{
-				pixbuf = gimmix_covers_plugin_get_cover_image_of_size (48, 48);
-				gimmix_tooltip_set_icon (tooltip, pixbuf);
-				g_object_unref (pixbuf);
-			}
+			res->tagedit = gimmix_covers_plugin_get_default_cover (96, 96);
+			if (req->tooltip)
+				res->tooltip = gimmix_covers_plugin_get_default_cover (48, 48);
 		}
 	}
 	g_mutex_unlock (&c_mutex);
 
+	gimmix_dispatch_post (&cover_result_type, res);
+
+	gimmix_song_unref (req->song);
+	g_free (req);
+
+	return NULL;
+}
+
+/* if default = TRUE, set the default cover */
+void
+gimmix_covers_plugin_update_cover (gboolean defaultc)
+{
+	CoverRequest	*req;
+
+	/* everything the worker needs is taken from the main thread */
+	req = g_new0 (CoverRequest, 1);
+	req->serial = ++cover_request_serial;
+	req->height = h3_size;
+	req->tooltip = gimmix_config_get_bool ("enable_systray") &&
+			gimmix_config_get_bool ("enable_notification");
+	if (!defaultc && gmo && mpd_check_connected (gmo) &&
+		mpd_player_get_state (gmo) != MPD_PLAYER_STOP)
+	{
+		/* shared with the rest of the interface, never changed */
+		req->song = gimmix_song_get_current ();
+	}
+
+	g_thread_unref (g_thread_new ("covers_plugin_update_cover",
+				(GThreadFunc)gimmix_covers_plugin_update_cover_thread,
+				req));
+
 	return;
 }
 
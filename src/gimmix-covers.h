@@ -22,12 +22,9 @@ void gimmix_covers_plugin_init (void);
 /* De-initialize the covers plugin */
 void gimmix_covers_plugin_cleanup (void);
 
-/* Update cover */
+/* Update cover in the background, must be called from the main loop */
 void gimmix_covers_plugin_update_cover (gboolean defaultc);
 
-/* get cover image of specified size */
-GdkPixbuf* gimmix_covers_plugin_get_cover_image_of_size (guint width, guint height);
-
 #endif
 
 #endif
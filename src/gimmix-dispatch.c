@@ -0,0 +1,136 @@
+/*
+ * gimmix-dispatch.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gimmix-dispatch.h"
+
+/* Worker threads never touch GTK or the mpd object. They post their
+ * results here and a single idle callback applies everything that is
+ * pending in one go from the main loop.
+ */
+
+typedef struct _gimmix_result {
+	const GimmixResultType	*type;
+	gpointer		data;
+	guint			serial;
+} GimmixResult;
+
+static GMutex		dispatch_mutex;
+static GQueue		dispatch_queue = G_QUEUE_INIT;
+static guint		dispatch_source = 0;
+static guint		dispatch_serial = 0;
+/* type -> serial of its newest pending result */
+static GHashTable	*dispatch_latest = NULL;
+
+static void
+gimmix_result_free (GimmixResult *result)
+{
+	if (result->type->free && result->data)
+		result->type->free (result->data);
+	g_free (result);
+
+	return;
+}
+
+static gboolean
+gimmix_dispatch_run (G_GNUC_UNUSED gpointer data)
+{
+	GQueue		pending = G_QUEUE_INIT;
+	GHashTable	*latest;
+	GimmixResult	*result;
+
+	/* take the whole batch so workers are not blocked while we
+	 * update the interface */
+	g_mutex_lock (&dispatch_mutex);
+	pending = dispatch_queue;
+	g_queue_init (&dispatch_queue);
+	latest = dispatch_latest;
+	dispatch_latest = NULL;
+	dispatch_source = 0;
+	g_mutex_unlock (&dispatch_mutex);
+
+	while ((result = g_queue_pop_head (&pending)) != NULL)
+	{
+		if (result->type->latest_only && latest &&
+			GPOINTER_TO_UINT(g_hash_table_lookup (latest, result->type)) != result->serial)
+		{
+			/* superseded by a newer result in the same batch */
+			gimmix_result_free (result);
+			continue;
+		}
+		result->type->apply (result->data);
+		gimmix_result_free (result);
+	}
+	if (latest)
+		g_hash_table_destroy (latest);
+
+	return FALSE;
+}
+
+void
+gimmix_dispatch_post (const GimmixResultType *type, gpointer data)
+{
+	GimmixResult *result;
+
+	g_return_if_fail (type != NULL && type->apply != NULL);
+
+	result = g_new0 (GimmixResult, 1);
+	result->type = type;
+	result->data = data;
+
+	g_mutex_lock (&dispatch_mutex);
+	result->serial = ++dispatch_serial;
+	if (type->latest_only)
+	{
+		if (dispatch_latest == NULL)
+			dispatch_latest = g_hash_table_new (NULL, NULL);
+		g_hash_table_insert (dispatch_latest, (gpointer)type, GUINT_TO_POINTER(result->serial));
+	}
+	g_queue_push_tail (&dispatch_queue, result);
+	if (dispatch_source == 0)
+		dispatch_source = g_idle_add (gimmix_dispatch_run, NULL);
+	g_mutex_unlock (&dispatch_mutex);
+
+	return;
+}
+
+void
+gimmix_dispatch_cleanup (void)
+{
+	GimmixResult *result;
+
+	g_mutex_lock (&dispatch_mutex);
+	if (dispatch_source)
+	{
+		g_source_remove (dispatch_source);
+		dispatch_source = 0;
+	}
+	while ((result = g_queue_pop_head (&dispatch_queue)) != NULL)
+		gimmix_result_free (result);
+	if (dispatch_latest)
+	{
+		g_hash_table_destroy (dispatch_latest);
+		dispatch_latest = NULL;
+	}
+	g_mutex_unlock (&dispatch_mutex);
+
+	return;
+}
@@ -0,0 +1,26 @@
+#ifndef GIMMIX_DISPATCH_H
+#define GIMMIX_DISPATCH_H
+
+#include <glib.h>
+
+/* A kind of result that worker threads hand over to the main loop.
+ * apply () is always called from the main loop, free () releases the
+ * result after it has been applied or dropped. */
+typedef struct _gimmix_result_type {
+	const char	*name;
+	void		(*apply) (gpointer result);
+	GDestroyNotify	free;
+	/* only the newest pending result of this type is applied. This
+	 * only collapses results waiting in the same batch, workers that
+	 * may finish out of order stamp their results with a serial. */
+	gboolean	latest_only;
+} GimmixResultType;
+
+/* Post a result from any thread. The result must not be touched by
+ * the caller afterwards. */
+void gimmix_dispatch_post (const GimmixResultType *type, gpointer result);
+
+/* Drop all pending results */
+void gimmix_dispatch_cleanup (void);
+
+#endif
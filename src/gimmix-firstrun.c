@@ -93,16 +93,8 @@ on_fr_close_clicked (G_GNUC_UNUSED GtkWidget *widget,
 	gimmix_config_init (); /* initialize configuration */
 	gimmix_interface_widgets_init ();
 	gimmix_interface_disable_controls ();
-	if (gimmix_connect())
-	{
-		gimmix_init ();
-		gimmix_interface_enable_controls ();
-		gtk_widget_hide (connection_box);
-	}
-	else
-	{
-		gtk_widget_show (connection_box);
-	}
+	gtk_widget_show (connection_box);
+	gimmix_connect ();
 
 	return;
 }
@@ -28,10 +28,14 @@
 #include "gimmix-interface.h"
 #include "gimmix-tooltip.h"
 #include "gimmix-playlist.h"
+#include "gimmix-tagbrowser.h"
 #include "gimmix-tagedit.h"
 #include "gimmix-metadata.h"
 #include "gimmix-prefs.h"
 #include "gimmix.h"
+#include "gimmix-trace.h"
+#include "gimmix-stats.h"
+#include "gimmix-status.h"
 
 #ifdef HAVE_CONFIG_H
 #	include "config.h"
@@ -77,12 +81,16 @@ extern ConfigFile	conf;
 extern GimmixTooltip 	*tooltip;
 extern GtkWidget	*current_playlist_treeview;
 
-mpd_Song		*glob_song_info;
-
 static void		gimmix_update_volume (void);
 static void		gimmix_update_repeat (void);
 static void		gimmix_update_shuffle (void);
 static gboolean		inited = FALSE;
+static guint		timer_source = 0;
+
+/* server state seen last, used to resync after a reconnect */
+static long long	last_playlist_id = -1;
+static long		last_db_update = -1;
+static int		last_song_id = -1;
 
 static gboolean		is_user_searching (void);
 static gboolean 	gimmix_timer (void);
@@ -110,16 +118,12 @@ static gboolean cb_gimmix_key_press(GtkWidget *widget, GdkEventKey *event, gpoin
 /* mpd callbacks */
 static void 	gimmix_status_changed (MpdObj *mo, ChangedStatusType id);
 
+/* snapshot the playing song, everyone showing it shares the snapshot */
 static void
 gimmix_update_global_song_info (void)
 {
-	mpd_Song *tsi = NULL;
-
-	tsi = mpd_playlist_get_current_song (gmo);
-	if (tsi!=NULL)
-	{
-		glob_song_info = tsi;
-	}
+	GIMMIX_MPD_CALL ("currentsong",
+		gimmix_song_set_current (mpd_playlist_get_current_song (gmo)));
 	
 	return;
 }
@@ -131,19 +135,16 @@ gimmix_status_changed (MpdObj *mo, ChangedStatusType id)
 	
 	if (!(id&MPD_CST_STATE) && (id&MPD_CST_SONGID || id&MPD_CST_DATABASE))
 	{
-		gimmix_update_current_playlist (mo, mpd_playlist_get_changes(mo,0));
+		gimmix_update_current_playlist (mo);
 		#ifdef HAVE_COVER_PLUGIN
 		
-		g_thread_new ("covers_plugin_update_cover",
-				(GThreadFunc)gimmix_covers_plugin_update_cover,
-				FALSE);
+		gimmix_covers_plugin_update_cover (FALSE);
 		
 		#endif
 		gimmix_set_song_info ();
+		gimmix_metadata_update_song ();
 		#ifdef HAVE_LYRICS
-		g_thread_new ("lyrics_plugin_update_lyrics",
-				(GThreadFunc)gimmix_lyrics_plugin_update_lyrics,
-				NULL);
+		gimmix_lyrics_plugin_update_lyrics ();
 		#endif
 		return;
 	}
@@ -160,16 +161,13 @@ gimmix_status_changed (MpdObj *mo, ChangedStatusType id)
 			#ifdef HAVE_COVER_PLUGIN
 			if (gimmix_config_get_bool("coverart_enable"))
 			{
-				g_thread_new ("covers_plugin_update_cover",
-						(GThreadFunc)gimmix_covers_plugin_update_cover,
-						FALSE);
+				gimmix_covers_plugin_update_cover (FALSE);
 			}
 			#endif
 			gimmix_set_song_info ();
+			gimmix_metadata_update_song ();
 			#ifdef HAVE_LYRICS
-			g_thread_new ("lyrics_plugin_update_lyrics",
-					(GThreadFunc)gimmix_lyrics_plugin_update_lyrics ,
-					NULL);
+			gimmix_lyrics_plugin_update_lyrics ();
 			#endif
 		}
 		else
@@ -194,21 +192,22 @@ gimmix_status_changed (MpdObj *mo, ChangedStatusType id)
 			#ifdef HAVE_COVER_PLUGIN
 			if (gimmix_config_get_bool("coverart_enable"))
 			{
-				g_thread_new ("covers_plugin_update_cover",
-						(GThreadFunc)gimmix_covers_plugin_update_cover,
-						(gpointer)TRUE);
+				gimmix_covers_plugin_update_cover (TRUE);
 			}
 			#endif
 			gtk_image_set_from_stock (GTK_IMAGE(image_play), "gtk-media-play", GTK_ICON_SIZE_MENU);
 			gtk_widget_set_tooltip_text (play_button, _("Play <x or c>"));
-			gimmix_update_current_playlist (mo, mpd_playlist_get_changes(mo,0));
+			gimmix_update_current_playlist (mo);
 			return;
 		}
-		gimmix_update_current_playlist (mo, mpd_playlist_get_changes(mo,0));
+		gimmix_update_current_playlist (mo);
 	}
 	
 	if (id&MPD_CST_PLAYLIST)
-		gimmix_update_current_playlist (mo, mpd_playlist_get_changes(mo,0));
+		gimmix_update_current_playlist (mo);
+
+	if (id&MPD_CST_STORED_PLAYLIST)
+		gimmix_stored_playlists_refresh ();
 
 	if (id&MPD_CST_VOLUME)
 		gimmix_update_volume ();
@@ -275,7 +274,6 @@ gimmix_interface_widgets_init (void)
 	GtkWidget		*progressbox;
 	GtkAdjustment		*vol_adj;
 	GdkPixbuf		*app_icon;
-	gchar			*path;
 	
 	if (inited)
 	{
@@ -287,11 +285,9 @@ gimmix_interface_widgets_init (void)
 	gtk_window_set_default_size (GTK_WINDOW(main_window), -1, 80);
 	gtk_window_resize (GTK_WINDOW(main_window), atoi(cfg_get_key_value(conf, "window_width")), atoi(cfg_get_key_value(conf, "window_height")));
 	gtk_window_move (GTK_WINDOW(main_window), atoi(cfg_get_key_value(conf, "window_xpos")), atoi(cfg_get_key_value(conf, "window_ypos")));
-	path = gimmix_get_full_image_path (GIMMIX_APP_ICON);
-	app_icon = gdk_pixbuf_new_from_file_at_size (path, 48, 48, NULL);
+	app_icon = gimmix_get_pixbuf (GIMMIX_APP_ICON, 48, 48);
 	gtk_window_set_icon (GTK_WINDOW(main_window), app_icon);
 	g_object_unref (app_icon);
-	g_free (path);
 	
 	/* connect the key press signal */
 	g_signal_connect (G_OBJECT(main_window), "key-press-event", G_CALLBACK(cb_gimmix_key_press), NULL);
@@ -384,26 +380,23 @@ gimmix_interface_widgets_init (void)
 	}
 	
 	/* initialize metadata */
-	gimmix_metadata_init ();
+	GIMMIX_TRACE ("startup", "gimmix_metadata_init", gimmix_metadata_init ());
 	
-	/* tag editor widgets */
-	gimmix_tag_editor_widgets_init ();
+	/* tag editor */
+	gimmix_tag_editor_init ();
 	
 	#ifdef HAVE_COVER_PLUGIN
-	gimmix_covers_plugin_init ();
+	GIMMIX_TRACE ("startup", "gimmix_covers_plugin_init", gimmix_covers_plugin_init ());
 	#else
 	widget = GTK_WIDGET (gtk_builder_get_object (xml, "gimmix_plc_image_frame"));
 	gtk_widget_hide (widget);
 	#endif
 	
 	#ifdef HAVE_LYRICS
-	gimmix_lyrics_plugin_init ();
-	#else
-	widget = GTK_WIDGET (gtk_builder_get_object (xml, "lyrics_container"));
-	gtk_widget_hide (widget);
+	GIMMIX_TRACE ("startup", "gimmix_lyrics_plugin_init", gimmix_lyrics_plugin_init ());
 	#endif
 	
-	widget = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_container"));
+	widget = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_page"));
 	#ifdef HAVE_COVER_PLUGIN
 	gtk_widget_show (widget);
 	#elif defined(HAVE_LYRICS)
@@ -412,11 +405,8 @@ gimmix_interface_widgets_init (void)
 	gtk_widget_hide (widget);
 	#endif
 	
-	/* initialize preferences dialog */
-	gimmix_prefs_init ();
-	
 	/* playlist widgets */
-	gimmix_playlist_widgets_init ();
+	GIMMIX_TRACE ("startup", "gimmix_playlist_widgets_init", gimmix_playlist_widgets_init ());
 	
 	/* show version info */
 	gimmix_show_ver_info ();
@@ -427,9 +417,7 @@ gimmix_interface_widgets_init (void)
 	#ifdef HAVE_COVER_PLUGIN
 	if (gimmix_config_get_bool("coverart_enable"))
 	{
-		g_thread_new ("covers_plugin_update_cover",
-				(GThreadFunc)gimmix_covers_plugin_update_cover,
-				(gpointer)TRUE);
+		gimmix_covers_plugin_update_cover (TRUE);
 	}
 	#endif
 }
@@ -476,7 +464,7 @@ gimmix_init (void)
 	if (!inited)
 	{
 		inited = TRUE;
-		mpd_status_update (gmo);
+		gimmix_status_update ();
 		status = mpd_player_get_state (gmo);
 		gimmix_update_global_song_info ();
 		
@@ -499,7 +487,7 @@ gimmix_init (void)
 			gimmix_show_ver_info ();
 		}
 		gtk_adjustment_set_value (GTK_ADJUSTMENT(gtk_range_get_adjustment(GTK_RANGE(volume_scale))), mpd_status_get_volume (gmo));
-		gimmix_playlist_init ();
+		GIMMIX_TRACE ("startup", "gimmix_playlist_init", gimmix_playlist_init ());
 		/* check if library needs to be updated on startup */
 		if (gimmix_config_get_bool("update_on_startup"))
 			gimmix_library_update ();
@@ -507,33 +495,32 @@ gimmix_init (void)
 		g_object_unref (xml);
 	}
 	
-	g_timeout_add (300, (GSourceFunc)gimmix_timer, NULL);
+	if (timer_source == 0)
+		timer_source = g_timeout_add (300, (GSourceFunc)gimmix_timer, NULL);
 	
 	/* update current playlist */
-	gimmix_update_current_playlist (gmo, mpd_playlist_get_changes(gmo,0));
+	GIMMIX_TRACE ("startup", "gimmix_update_current_playlist",
+		gimmix_update_current_playlist (gmo));
 
 	/* set song info */
 	status = mpd_player_get_state (gmo);
 	if (status == MPD_PLAYER_PLAY || status == MPD_PLAYER_PAUSE)
 	{
 		gimmix_set_song_info ();
+		gimmix_metadata_update_song ();
 	}
 	/*
 	#ifdef HAVE_COVER_PLUGIN
 	if (gimmix_config_get_bool("coverart_enable"))
 	{
-		g_thread_new ("covers_plugin_update_cover",
-				(GThreadFunc)gimmix_covers_plugin_update_cover,
-				FALSE);
+		gimmix_covers_plugin_update_cover (FALSE);
 	}
 	
 	#endif*/
 	#ifdef HAVE_LYRICS
 	if (status == MPD_PLAYER_PLAY || status == MPD_PLAYER_PAUSE)
 	{
-		g_thread_new ("lyrics_plugin_update_lyrics",
-				(GThreadFunc)gimmix_lyrics_plugin_update_lyrics,
-				NULL);
+		gimmix_lyrics_plugin_update_lyrics ();
 	}
 	#endif
 
@@ -544,6 +531,65 @@ gimmix_init (void)
 	return;
 }
 
+void
+gimmix_resync (void)
+{
+	int	song_id;
+
+	if (!inited)
+	{
+		gimmix_init ();
+		return;
+	}
+
+	gimmix_status_update ();
+	status = mpd_player_get_state (gmo);
+	gimmix_update_global_song_info ();
+
+	/* the playlist version and the database update time tell us
+	 * whether the lists have to be fetched again */
+	if (mpd_playlist_get_playlist_id (gmo) != last_playlist_id)
+		gimmix_update_current_playlist (gmo);
+	if ((long)mpd_server_get_database_update_time (gmo) != last_db_update)
+		gimmix_library_refresh ();
+	/* stored playlists may have changed while we were away, the
+	 * list is only redrawn if they did */
+	gimmix_stored_playlists_refresh ();
+
+	gimmix_update_volume ();
+	gimmix_update_repeat ();
+	gimmix_update_shuffle ();
+
+	song_id = mpd_player_get_current_song_id (gmo);
+	if (status == MPD_PLAYER_PLAY || status == MPD_PLAYER_PAUSE)
+	{
+		gimmix_set_song_info ();
+		if (song_id != last_song_id)
+		{
+			#ifdef HAVE_COVER_PLUGIN
+			if (gimmix_config_get_bool("coverart_enable"))
+				gimmix_covers_plugin_update_cover (FALSE);
+			#endif
+			gimmix_metadata_update_song ();
+			#ifdef HAVE_LYRICS
+			gimmix_lyrics_plugin_update_lyrics ();
+			#endif
+		}
+	}
+	else
+	{
+		gimmix_show_ver_info ();
+	}
+	/* make the timer pick up the current state */
+	status = -1;
+
+	if (timer_source == 0)
+		timer_source = g_timeout_add (300, (GSourceFunc)gimmix_timer, NULL);
+	mpd_signal_connect_status_changed (gmo, (StatusChangedCallback)gimmix_status_changed, NULL);
+
+	return;
+}
+
 static gboolean
 cb_gimmix_key_press (G_GNUC_UNUSED GtkWidget   *widget,
 		     GdkEventKey	       *event,
@@ -600,6 +646,13 @@ cb_gimmix_key_press (G_GNUC_UNUSED GtkWidget   *widget,
 			case GDK_KEY_l: /* TOGGLE DISPLAY PLAYLIST */
 				cb_playlist_button_press (NULL, NULL, NULL);
 				break;
+			case GDK_KEY_d: /* MPD COMMAND STATISTICS */
+				if (event->state & GDK_CONTROL_MASK)
+				{
+					gimmix_stats_dialog_show (GTK_WINDOW(main_window));
+					result = TRUE;
+				}
+				break;
 		}
 	}
 	return result;
@@ -613,32 +666,36 @@ gimmix_timer (void)
 	float 	fraction;
 	if (mpd_check_connected(gmo)==FALSE)
 	{
+		timer_source = 0;
 		gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR(progress), 0.0);
 		gtk_progress_bar_set_text (GTK_PROGRESS_BAR(progress), "");
 		gimmix_show_ver_info ();
 		#ifdef HAVE_COVER_PLUGIN
 		if (gimmix_config_get_bool("coverart_enable"))
 		{
-			g_thread_new ("covers_plugin_update_cover",
-					(GThreadFunc)gimmix_covers_plugin_update_cover,
-					(gpointer)TRUE); /* set default cover */
+			gimmix_covers_plugin_update_cover (TRUE); /* set default cover */
 		}
 		#endif
 		return FALSE;
 	}
 	if (mpd_check_connected(gmo))
 	{
-		mpd_status_update (gmo);
+		/* the reply comes in later, this tick shows the last one */
+		gimmix_status_poll ();
 		new_status = mpd_player_get_state (gmo);
+		last_playlist_id = mpd_playlist_get_playlist_id (gmo);
+		last_db_update = mpd_server_get_database_update_time (gmo);
+		last_song_id = mpd_player_get_current_song_id (gmo);
 	}
 	else
 	{
+		timer_source = 0;
 		return FALSE;
 	}
 	
 	if (status == new_status)
 	{
-		if (status == MPD_PLAYER_PLAY || status == MPD_PLAYER_PAUSE)
+		if ((status == MPD_PLAYER_PLAY || status == MPD_PLAYER_PAUSE) && !gimmix_seek_pending ())
 		{
 			gimmix_get_progress_status (gmo, &fraction, time);
 			if (fraction >= 0.0 && fraction <= 1.0)
@@ -734,11 +791,11 @@ cb_repeat_button_toggled (GtkToggleButton *button, G_GNUC_UNUSED gpointer data)
 	state = gtk_toggle_button_get_active (button);
 	if (state == TRUE)
 	{
-		mpd_player_set_repeat (gmo, true);
+		gimmix_set_repeat (true);
 	}
 	else if (state == FALSE)
 	{
-		mpd_player_set_repeat (gmo, false);
+		gimmix_set_repeat (false);
 	}
 	
 	return;
@@ -752,11 +809,11 @@ cb_shuffle_button_toggled (GtkToggleButton *button, G_GNUC_UNUSED gpointer data)
 	state = gtk_toggle_button_get_active (button);
 	if (state == TRUE)
 	{
-		mpd_player_set_random (gmo, true);
+		gimmix_set_random (true);
 	}
 	else if (state == FALSE)
 	{
-		mpd_player_set_random (gmo, false);
+		gimmix_set_random (false);
 	}
 	
 	return;
@@ -794,7 +851,7 @@ cb_volume_scale_changed (GtkWidget *widget, G_GNUC_UNUSED gpointer data)
 	volume_adj = gtk_range_get_adjustment (GTK_RANGE(widget));
 
 	value = gtk_adjustment_get_value (GTK_ADJUSTMENT(volume_adj));
-	mpd_status_set_volume (gmo, value);
+	gimmix_set_volume (value);
 	
 	return;
 }
@@ -853,6 +910,10 @@ gimmix_update_volume ()
 	gint 		volume;
 	GtkAdjustment	*volume_adj;
 	
+	/* don't move the slider back while the user is still moving it */
+	if (gimmix_volume_pending ())
+		return;
+
 	volume_adj = gtk_range_get_adjustment (GTK_RANGE(volume_scale));
 	volume = mpd_status_get_volume (gmo);
 	gtk_adjustment_set_value (GTK_ADJUSTMENT(volume_adj), volume);
@@ -873,7 +934,10 @@ cb_gimmix_progress_seek (GtkWidget *progressbox, GdkEvent *event)
 	seektime = (gdouble)x/allocation.width;
 	newtime = seektime * totaltime;
 
-	gimmix_seek (gmo, newtime);
+	/* show the new position right away, the seek itself is sent
+	 * once the user stops clicking around */
+	if (gimmix_seek (gmo, newtime))
+		gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR(progress), seektime);
 
 	return;
 }
@@ -916,9 +980,9 @@ gimmix_set_song_info (void)
 {
 	gchar 		*markup;
 	gchar 		*title;
-	mpd_Song	*song = NULL;
+	GimmixSong	*song = NULL;
 	
-	song = mpd_playlist_get_current_song (gmo);
+	song = gimmix_song_get_current ();
 	
 	if (song == NULL)
 	{
@@ -956,6 +1020,7 @@ gimmix_set_song_info (void)
 
 	if (gimmix_config_get_bool("enable_systray"))
 		gimmix_update_systray_tooltip (song);
+	gimmix_song_unref (song);
 	
 	return;
 }
@@ -1050,6 +1115,9 @@ gimmix_interface_cleanup (void)
 {	
 	/* destroy system tray icon */
 	gimmix_destroy_systray_icon ();
+
+	gimmix_tagbrowser_cleanup ();
+	gimmix_pixbuf_cache_cleanup ();
 	
 	#if HAVE_COVERS_PLUGIN
 	gimmix_covers_plugin_cleanup ();
@@ -14,6 +14,9 @@ void gimmix_interface_widgets_init (void);
 /* Initializes default interface signals */
 void gimmix_init (void);
 
+/* Bring the interface up to date after a reconnect */
+void gimmix_resync (void);
+
 /* Sets the song info labels to reflect the song status */
 void gimmix_set_song_info (void);
 
@@ -0,0 +1,148 @@
+/*
+ * gimmix-intern.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "gimmix-intern.h"
+
+/* the reference count lives right in front of the characters */
+typedef struct _intern_string {
+	guint	refs;
+	gsize	size;		/* including the terminating nul */
+	gchar	str[1];
+} InternString;
+
+#define INTERN_HEADER(s)	((InternString*)((gchar*)(s) - G_STRUCT_OFFSET (InternString, str)))
+
+/* the pooled strings themselves, key and value are the same */
+static GHashTable	*intern_pool = NULL;
+static GMutex		intern_mutex;
+
+static gsize		intern_bytes = 0;	/* held by the pool */
+static gsize		intern_ref_bytes = 0;	/* as if every reference had its own copy */
+
+const gchar *
+gimmix_intern (const gchar *str)
+{
+	InternString	*entry;
+	gchar		*istr;
+	gsize		size;
+
+	if (str == NULL)
+		return NULL;
+
+	g_mutex_lock (&intern_mutex);
+	if (intern_pool == NULL)
+		intern_pool = g_hash_table_new (g_str_hash, g_str_equal);
+
+	if ((istr = g_hash_table_lookup (intern_pool, str)) != NULL)
+	{
+		entry = INTERN_HEADER (istr);
+		entry->refs++;
+	}
+	else
+	{
+		size = strlen (str) + 1;
+		entry = g_malloc (G_STRUCT_OFFSET (InternString, str) + size);
+		entry->refs = 1;
+		entry->size = size;
+		memcpy (entry->str, str, size);
+		istr = entry->str;
+		g_hash_table_insert (intern_pool, istr, istr);
+		intern_bytes += size;
+	}
+	intern_ref_bytes += entry->size;
+	g_mutex_unlock (&intern_mutex);
+
+	return istr;
+}
+
+const gchar *
+gimmix_intern_ref (const gchar *istr)
+{
+	InternString *entry;
+
+	if (istr == NULL)
+		return NULL;
+
+	g_mutex_lock (&intern_mutex);
+	entry = INTERN_HEADER (istr);
+	entry->refs++;
+	intern_ref_bytes += entry->size;
+	g_mutex_unlock (&intern_mutex);
+
+	return istr;
+}
+
+void
+gimmix_intern_unref (const gchar *istr)
+{
+	InternString *entry;
+
+	if (istr == NULL)
+		return;
+
+	g_mutex_lock (&intern_mutex);
+	entry = INTERN_HEADER (istr);
+	intern_ref_bytes -= entry->size;
+	if (--entry->refs == 0)
+	{
+		g_hash_table_remove (intern_pool, istr);
+		intern_bytes -= entry->size;
+		g_free (entry);
+	}
+	g_mutex_unlock (&intern_mutex);
+
+	return;
+}
+
+GType
+gimmix_intern_get_type (void)
+{
+	static volatile gsize type = 0;
+
+	if (g_once_init_enter (&type))
+	{
+		GType t = g_boxed_type_register_static (g_intern_static_string ("GimmixIntern"),
+							(GBoxedCopyFunc)gimmix_intern_ref,
+							(GBoxedFreeFunc)gimmix_intern_unref);
+
+		g_once_init_leave (&type, t);
+	}
+
+	return type;
+}
+
+void
+gimmix_intern_get_stats (guint *strings, gsize *bytes, gsize *saved)
+{
+	g_mutex_lock (&intern_mutex);
+	if (strings != NULL)
+		*strings = intern_pool ? g_hash_table_size (intern_pool) : 0;
+	if (bytes != NULL)
+		*bytes = intern_bytes;
+	if (saved != NULL)
+		*saved = intern_ref_bytes - intern_bytes;
+	g_mutex_unlock (&intern_mutex);
+
+	return;
+}
@@ -0,0 +1,27 @@
+#ifndef GIMMIX_INTERN_H
+#define GIMMIX_INTERN_H
+
+#include <glib-object.h>
+
+/* A pool of shared, reference counted tag strings. Every distinct
+ * artist, album or genre is stored once no matter how many songs carry
+ * it, and two pooled strings are equal exactly when their pointers are.
+ * Unlike quarks, a string is freed with its last reference. */
+
+/* get the pooled copy of str with a new reference, NULL for NULL */
+const gchar *gimmix_intern (const gchar *str);
+
+/* take another reference to / release a pooled string, NULL is ignored */
+const gchar *gimmix_intern_ref (const gchar *istr);
+void gimmix_intern_unref (const gchar *istr);
+
+/* A boxed type for pooled strings, tree model columns of this type
+ * hold references instead of copies */
+#define GIMMIX_TYPE_INTERN	(gimmix_intern_get_type ())
+GType gimmix_intern_get_type (void);
+
+/* distinct strings in the pool, the bytes they take and the bytes
+ * that the lookups would have allocated without it */
+void gimmix_intern_get_stats (guint *strings, gsize *bytes, gsize *saved);
+
+#endif
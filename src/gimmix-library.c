@@ -0,0 +1,99 @@
+/*
+ * gimmix-library.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "gimmix-library.h"
+
+static void
+gimmix_library_entry_free (GimmixLibraryEntry *entry)
+{
+	g_free (entry->name);
+	g_free (entry->path);
+	g_free (entry);
+
+	return;
+}
+
+GPtrArray *
+gimmix_library_parse_listing (const GimmixMpdReply *reply)
+{
+	GPtrArray		*entries;
+	GimmixLibraryEntry	*song = NULL;
+	gchar			*title = NULL;
+	gchar			*artist = NULL;
+	guint			i;
+
+	entries = g_ptr_array_new_with_free_func ((GDestroyNotify)gimmix_library_entry_free);
+	for (i = 0; ; i++)
+	{
+		const char *line = reply->lines[i];
+
+		/* a song is complete when the next entry starts */
+		if (song != NULL && (line == NULL || !strncmp (line, "directory: ", 11) ||
+			!strncmp (line, "file: ", 6) || !strncmp (line, "playlist: ", 10)))
+		{
+			if (title != NULL && artist != NULL)
+				song->name = g_strdup_printf ("%s - %s", artist, title);
+			else if (title != NULL)
+				song->name = g_strdup (title);
+			else
+			{
+				gchar *ext;
+
+				/* the file name without its extension */
+				song->name = g_path_get_basename (song->path);
+				if ((ext = strrchr (song->name, '.')) != NULL && ext != song->name)
+					*ext = '\0';
+			}
+			g_free (title);
+			g_free (artist);
+			title = artist = NULL;
+			song = NULL;
+		}
+		if (line == NULL)
+			break;
+
+		if (!strncmp (line, "directory: ", 11))
+		{
+			GimmixLibraryEntry *dir = g_new0 (GimmixLibraryEntry, 1);
+
+			dir->type = GIMMIX_FILE_DIR;
+			dir->path = g_strdup (line + 11);
+			dir->name = g_path_get_basename (dir->path);
+			g_ptr_array_add (entries, dir);
+		}
+		else if (!strncmp (line, "file: ", 6))
+		{
+			song = g_new0 (GimmixLibraryEntry, 1);
+			song->type = GIMMIX_FILE_SONG;
+			song->path = g_strdup (line + 6);
+			g_ptr_array_add (entries, song);
+		}
+		else if (song != NULL && title == NULL && !strncmp (line, "Title: ", 7))
+			title = g_strdup (line + 7);
+		else if (song != NULL && artist == NULL && !strncmp (line, "Artist: ", 8))
+			artist = g_strdup (line + 8);
+	}
+
+	return entries;
+}
@@ -0,0 +1,27 @@
+#ifndef GIMMIX_LIBRARY_H
+#define GIMMIX_LIBRARY_H
+
+#include <glib.h>
+
+#include "gimmix-mpdio.h"
+
+/* What a row of the library browser stands for */
+typedef enum {
+	GIMMIX_FILE_NONE = 0,	/* placeholder child of a directory not listed yet */
+	GIMMIX_FILE_SONG,
+	GIMMIX_FILE_DIR,
+	GIMMIX_FILE_PLAYLIST
+} GimmixFileType;
+
+/* a directory or song of an lsinfo listing */
+typedef struct _gimmix_library_entry {
+	GimmixFileType	type;
+	gchar		*name;	/* "artist - title", or the file name */
+	gchar		*path;
+} GimmixLibraryEntry;
+
+/* the directories and songs (GimmixLibraryEntry *) of an lsinfo reply,
+ * the array frees them with itself */
+GPtrArray *gimmix_library_parse_listing (const GimmixMpdReply *reply);
+
+#endif
@@ -34,6 +34,8 @@
 #include <curl/easy.h>
 #include <libxml/xmlreader.h>
 #include "gimmix-lyrics.h"
+#include "gimmix-metadata.h"
+#include "gimmix-dispatch.h"
 
 #define LYRICS_DIR	".gimmix/lyrics/"
 #define SEARCH_URL	"http://api.leoslyrics.com/api_search.php?auth=Gimmix"
@@ -41,17 +43,29 @@
 #define SEARCH		1
 #define FETCHL		0
 
-extern GtkBuilder	*xml;
 extern MpdObj		*gmo;
 extern ConfigFile	conf;
 
 static GtkWidget	*lyrics_textview = NULL;
 
-static gchar*		search_artist = NULL;
-static gchar*		search_title = NULL;
 static gchar*		lyrics_dir = NULL;
 static GMutex		l_mutex;
 
+/* bumped for every lyrics request, only the newest one is shown */
+static guint		lyrics_request_serial = 0;
+
+/* what a lyrics worker needs, snapshotted on the main thread */
+typedef struct _lyrics_request {
+	guint		serial;
+	GimmixSong	*song;
+} LyricsRequest;
+
+/* handed back to the main loop */
+typedef struct _lyrics_result {
+	guint		serial;
+	LYRICS_NODE	*node;
+} LyricsResult;
+
 static gchar *lyrics_url_encode (const char *string);
 static gboolean lyrics_process_lyrics_node (LYRICS_NODE *ptr);
 
@@ -62,13 +76,6 @@ gimmix_lyrics_plugin_init (void)
 {
 	char		*cpath = NULL;
 	
-	lyrics_textview = GTK_WIDGET (gtk_builder_get_object (xml, "lyrics_textview"));
-	
-	g_signal_connect (gtk_builder_get_object (xml,"lyrics_get_btn"),
-				"clicked",
-				G_CALLBACK(cb_gimmix_lyrics_get_btn_clicked),
-				NULL);
-
 	/* check if .gimmix/lyrics exists */
 	cpath = cfg_get_path_to_config_file (LYRICS_DIR);
 	g_mkdir_with_parents (cpath, 00755);
@@ -79,6 +86,19 @@ gimmix_lyrics_plugin_init (void)
 	return;
 }
 
+void
+gimmix_lyrics_plugin_panel_init (GtkBuilder *builder)
+{
+	lyrics_textview = GTK_WIDGET (gtk_builder_get_object (builder, "lyrics_textview"));
+	
+	g_signal_connect (gtk_builder_get_object (builder,"lyrics_get_btn"),
+				"clicked",
+				G_CALLBACK(cb_gimmix_lyrics_get_btn_clicked),
+				NULL);
+
+	return;
+}
+
 void
 gimmix_lyrics_plugin_cleanup (void)
 {
@@ -116,26 +136,6 @@ lyrics_url_encode (const char *string)
 	return ret;
 }
 
-static void
-gimmix_covers_plugin_set_artist (const char *artist)
-{
-	if (search_artist != NULL)
-		g_free (search_artist);
-	search_artist = g_strdup (artist);
-	
-	return;
-}
-
-static void
-gimmix_covers_plugin_set_songtitle (const char *title)
-{
-	if (search_title != NULL)
-		g_free (search_title);
-	search_title = g_strdup (title);
-	
-	return;
-}
-
 static gboolean
 lyrics_process_lyrics_node (LYRICS_NODE *ptr)
 {
@@ -174,7 +174,7 @@ lyrics_process_lyrics_node (LYRICS_NODE *ptr)
 }
 
 static LYRICS_NODE*
-lyrics_perform_search (const char *url)
+lyrics_perform_search (const char *url, const char *artist, const char *title)
 {
 	char		*str = NULL;
 	nxml_t		*nxml = NULL;
@@ -228,16 +228,16 @@ lyrics_perform_search (const char *url)
 			if (!lnode->match)
 			{
 				/* compare artist */
-				if (!g_ascii_strcasecmp(lnode->artist, search_artist) &&
-					!g_ascii_strcasecmp(lnode->title, search_title))
+				if (!g_ascii_strcasecmp(lnode->artist, artist) &&
+					!g_ascii_strcasecmp(lnode->title, title))
 				{
 					lnode->match = TRUE;
 				}
 				else
-				if (!g_ascii_strcasecmp(lnode->artist, search_artist))
+				if (!g_ascii_strcasecmp(lnode->artist, artist))
 				{
 					/* try to match a part of song */
-					if (!g_ascii_strncasecmp(lnode->title, search_title, 5))
+					if (!g_ascii_strncasecmp(lnode->title, title, 5))
 					{
 						lnode->match = TRUE;
 					}
@@ -261,83 +261,66 @@ lyrics_perform_search (const char *url)
 }
 
 LYRICS_NODE*
-lyrics_search (void)
+lyrics_search (const char *artist, const char *title)
 {
 	gchar		*url = NULL;
 	char		*path = NULL;
 	LYRICS_NODE	*ret = NULL;
-	gchar		*artist = NULL;
-	gchar		*title = NULL;
+
+	if (artist == NULL || title == NULL)
+		return NULL;
 
 	g_mutex_lock (&l_mutex);
-	if (search_artist != NULL && search_title != NULL)
+	/* first check if the lyrics exist in ~/.lyrics/ */
+	path = g_strdup_printf ("%s/%s-%s.txt", lyrics_dir, artist, title);
+	if (g_file_test(path,G_FILE_TEST_EXISTS))
 	{
-		/* first check if the lyrics exist in ~/.lyrics/ */
-		//char *temp_path = cfg_get_path_to_config_file (LYRICS_DIR);
-		//g_print ("%s\n", lyrics_dir);
-		path = g_strdup_printf ("%s/%s-%s.txt", lyrics_dir, search_artist, search_title);
-		//g_print ("path = %s\n", path);
-		artist = g_strdup (search_artist);
-		title = g_strdup (search_title);
-		//g_free (temp_path);
-		if (g_file_test(path,G_FILE_TEST_EXISTS))
+		GString	*str = g_string_new ("");
+		FILE *fp = NULL;
+		char line[PATH_MAX+1] = "";
+		ret = (LYRICS_NODE*) malloc(sizeof(LYRICS_NODE));
+		memset (ret, 0, sizeof(LYRICS_NODE));
+		g_strlcpy (ret->artist, artist, sizeof(ret->artist));
+		g_strlcpy (ret->title, title, sizeof(ret->title));
+		fp = fopen (path, "r");
+		if (fp != NULL)
 		{
-			GString	*str = g_string_new ("");
-			FILE *fp = NULL;
-			char line[PATH_MAX+1] = "";
-			ret = (LYRICS_NODE*) malloc(sizeof(LYRICS_NODE));
-			memset (ret, 0, sizeof(LYRICS_NODE));
-			strncpy (ret->artist, search_artist, strlen(search_artist));
-			strncpy (ret->title, search_title, strlen(search_title));
-			fp = fopen (path, "r");
-			if (fp != NULL)
+			while (fgets(line, PATH_MAX, fp))
 			{
-				while (fgets(line, PATH_MAX, fp))
-				{
-					str = g_string_append (str, line);
-				}
-				ret->lyrics = g_strdup (str->str);
-				g_string_free (str, TRUE);
-				fclose (fp);
+				str = g_string_append (str, line);
 			}
-			g_free (path);
-			g_free (artist);
-			g_free (title);
-			g_mutex_unlock (&l_mutex);
-			return ret;
+			ret->lyrics = g_strdup (str->str);
+			fclose (fp);
 		}
+		g_string_free (str, TRUE);
 		g_free (path);
-		char *artist_e = lyrics_url_encode (search_artist);
-		char *title_e = lyrics_url_encode (search_title);
-		url = g_strdup_printf ("%s&artist=%s&songtitle=%s", SEARCH_URL, artist_e, title_e);
-		g_free (artist_e);
-		g_free (title_e);
-		//g_print ("%s\n", url);
-		ret = lyrics_perform_search (url);
-		g_free (url);
-		if (ret)
+		g_mutex_unlock (&l_mutex);
+		return ret;
+	}
+	g_free (path);
+	char *artist_e = lyrics_url_encode (artist);
+	char *title_e = lyrics_url_encode (title);
+	url = g_strdup_printf ("%s&artist=%s&songtitle=%s", SEARCH_URL, artist_e, title_e);
+	g_free (artist_e);
+	g_free (title_e);
+	ret = lyrics_perform_search (url, artist, title);
+	g_free (url);
+	if (ret && ret->lyrics != NULL)
+	{
+		path = g_strdup_printf ("%s/%s-%s.txt", lyrics_dir, artist, title);
+		FILE *fp = fopen (path, "w");
+		if (fp)
 		{
-			//g_print ("everything ok\n");
-			if (ret->lyrics != NULL)
-			{
-				path = g_strdup_printf ("%s/%s-%s.txt", lyrics_dir, artist, title);
-				FILE *fp = fopen (path, "w");
-				if (fp)
-				{
-					fprintf (fp, "%s", ret->lyrics);
-					printf ("saving lyrics to %s\n", path);
-					g_free (path);
-					fclose (fp);
-				}
-				else
-				{
-					g_print ("error fetching lyrics. please try again.\n");
-				}
-			}
+			fprintf (fp, "%s", ret->lyrics);
+			printf ("saving lyrics to %s\n", path);
+			fclose (fp);
+		}
+		else
+		{
+			g_print ("error fetching lyrics. please try again.\n");
 		}
+		g_free (path);
 	}
-	g_free (artist);
-	g_free (title);
 	g_mutex_unlock (&l_mutex);
 	return ret;
 }
@@ -348,10 +331,9 @@ gimmix_lyrics_populate_textview (LYRICS_NODE *node)
 	GtkTextBuffer	*buffer = NULL;
 	GtkTextIter	iter;
 	
-	gdk_threads_enter ();
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW(lyrics_textview));
 	if (buffer == NULL)
-		goto ret;
+		return;
 	gtk_text_buffer_set_text (buffer, "", 0);
 	gtk_text_buffer_get_iter_at_offset (buffer, &iter, 0);
 		
@@ -366,54 +348,87 @@ gimmix_lyrics_populate_textview (LYRICS_NODE *node)
 		gtk_text_buffer_insert (buffer, &iter, _("Lyrics not found"), -1);
 	}
 
-	ret:
-	gdk_flush ();
-	gdk_threads_leave ();
-	g_print ("done setting lyrics\n");
+	return;
+}
+
+static void
+gimmix_lyrics_node_free (LYRICS_NODE *node)
+{
+	if (node->lyrics)
+		g_free (node->lyrics);
+	g_free (node);
+
+	return;
+}
+
+static void
+gimmix_lyrics_result_apply (LyricsResult *res)
+{
+	/* a later request has been made while this one was running */
+	if (res->serial != lyrics_request_serial)
+		return;
+
+	gimmix_lyrics_populate_textview (res->node);
+
+	return;
+}
+
+static void
+gimmix_lyrics_result_free (LyricsResult *res)
+{
+	if (res->node)
+		gimmix_lyrics_node_free (res->node);
+	g_free (res);
 
 	return;
 }
 
+static const GimmixResultType lyrics_result_type = {
+	"lyrics",
+	(void (*) (gpointer))gimmix_lyrics_result_apply,
+	(GDestroyNotify)gimmix_lyrics_result_free,
+	TRUE
+};
+
+static gpointer
+gimmix_lyrics_plugin_update_lyrics_thread (LyricsRequest *req)
+{
+	LyricsResult	*res;
+
+	res = g_new0 (LyricsResult, 1);
+	res->serial = req->serial;
+	if (req->song)
+		res->node = lyrics_search (req->song->artist, req->song->title);
+
+	gimmix_dispatch_post (&lyrics_result_type, res);
+
+	gimmix_song_unref (req->song);
+	g_free (req);
+
+	return NULL;
+}
+
 void
 gimmix_lyrics_plugin_update_lyrics (void)
 {
-	LYRICS_NODE	*node = NULL;
-	mpd_Song	*s = NULL;
-	mpd_Song	*sng = (mpd_Song*)malloc (sizeof(mpd_Song));
+	LyricsRequest	*req;
 	
-	memset (sng, 0, sizeof(mpd_Song));
-	sleep (2);
+	/* nothing to show the lyrics in yet */
+	if (!gimmix_metadata_panel_loaded ())
+		return;
+	
+	req = g_new0 (LyricsRequest, 1);
+	req->serial = ++lyrics_request_serial;
 	if (mpd_player_get_state(gmo)!=MPD_PLAYER_STOP)
 	{
 		if (mpd_playlist_get_playlist_length(gmo))
-			s = mpd_playlist_get_current_song (gmo);
-		else
-			s = NULL;
+			req->song = gimmix_song_get_current ();
 	}
 	
-	if (s)
-	{
-		memcpy (sng, s, sizeof(mpd_Song));
-		if (sng->artist)
-			gimmix_covers_plugin_set_artist (sng->artist);
-		if (sng->title)
-			gimmix_covers_plugin_set_songtitle (sng->title);
-		/* set metadata info */
-		gimmix_metadata_set_song_details (sng, NULL);
-	}
-
-	node = lyrics_search ();
-	gimmix_lyrics_populate_textview (node);
-	if (node)
-	{
-		if (node->lyrics)
-		g_free (node->lyrics);
-		g_free (node);
-	}
-	if (sng)
-	{
-		free (sng);
-	}
+	/* the worker takes over our reference to the snapshot */
+	g_thread_unref (g_thread_new ("lyrics_plugin_update_lyrics",
+				(GThreadFunc)gimmix_lyrics_plugin_update_lyrics_thread,
+				req));
 	
 	return;
 }
@@ -422,9 +437,7 @@ static void
 cb_gimmix_lyrics_get_btn_clicked (G_GNUC_UNUSED GtkWidget *widget,
 				  G_GNUC_UNUSED gpointer   data)
 {
-	g_thread_new ("lyrics_plugin_update_lyrics",
-			(GThreadFunc)gimmix_lyrics_plugin_update_lyrics ,
-			NULL);
+	gimmix_lyrics_plugin_update_lyrics ();
 
 	return;
 }
@@ -21,15 +21,18 @@ typedef struct lnode
 /* Initialize the gimmix lyrics plugin */
 void gimmix_lyrics_plugin_init (void);
 
+/* Set up the lyrics widgets of a freshly built metadata panel */
+void gimmix_lyrics_plugin_panel_init (GtkBuilder *builder);
+
 /* Free memory used by lyrics plugin */
 void gimmix_lyrics_plugin_cleanup (void);
 
 /* update lyrics for current song */
 void gimmix_lyrics_plugin_update_lyrics (void);
 
-void lyrics_set_artist (const char *artist);
-void lyrics_set_songtitle (const char *title);
-LYRICS_NODE* lyrics_search (void);
+/* look up the lyrics of a song, from the local cache or the web.
+ * Blocks, call it from a worker thread. */
+LYRICS_NODE* lyrics_search (const char *artist, const char *title);
 void gimmix_lyrics_populate_textview (LYRICS_NODE *node);
 
 #endif
@@ -27,6 +27,7 @@
 #include <string.h>
 #include <glib.h>
 #include "gimmix-metadata.h"
+#include "gimmix-lyrics.h"
 
 extern GtkBuilder	*xml;
 extern MpdObj		*gmo;
@@ -41,29 +42,84 @@ static GtkWidget *metadata_song_genrebox;
 static GtkWidget *metadata_song_genre;
 static GtkWidget *metadata_song_albumreview;
 static GtkWidget *metadata_song_cover;
-static GtkWidget *metadata_container;
+static GtkWidget *metadata_page;
+static GtkWidget *metadata_container = NULL;
+
+static void cb_gimmix_metadata_switch_page (GtkNotebook *notebook, gpointer page, guint page_num, gpointer data);
 
 void
 gimmix_metadata_init (void)
 {
-	metadata_song_title = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_song_label"));
-	metadata_song_artist = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_artist_label"));
-	metadata_song_album = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_album_label"));
-	metadata_song_genre = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_genre_label"));
-	metadata_song_albumreview = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_albuminfo"));
-	metadata_song_albumbox = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_album_box"));
-	metadata_song_artistbox = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_artist_box"));
-	metadata_song_genrebox = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_genre_box"));
-	metadata_song_cover = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_albumart"));
-	metadata_container = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_container"));
+	GtkWidget *notebook;
+
+	/* the panel itself is built when its page is first shown */
+	metadata_page = GTK_WIDGET (gtk_builder_get_object (xml, "metadata_page"));
+	notebook = GTK_WIDGET (gtk_builder_get_object (xml, "notebook1"));
+	g_signal_connect (G_OBJECT(notebook), "switch-page", G_CALLBACK(cb_gimmix_metadata_switch_page), NULL);
 
 	return;
 }
 
+static void
+gimmix_metadata_panel_load (void)
+{
+	GtkBuilder *builder;
+
+	builder = gimmix_ui_load ("gimmix-plugins.ui");
+	metadata_container = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_container"));
+	gtk_box_pack_start (GTK_BOX(metadata_page), metadata_container, TRUE, TRUE, 0);
+
+	metadata_song_title = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_song_label"));
+	metadata_song_artist = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_artist_label"));
+	metadata_song_album = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_album_label"));
+	metadata_song_genre = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_genre_label"));
+	metadata_song_albumreview = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_albuminfo"));
+	metadata_song_albumbox = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_album_box"));
+	metadata_song_artistbox = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_artist_box"));
+	metadata_song_genrebox = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_genre_box"));
+	metadata_song_cover = GTK_WIDGET (gtk_builder_get_object (builder, "metadata_albumart"));
+
+	#ifdef HAVE_LYRICS
+	gimmix_lyrics_plugin_panel_init (builder);
+	#else
+	gtk_widget_hide (GTK_WIDGET (gtk_builder_get_object (builder, "lyrics_container")));
+	#endif
+	g_object_unref (builder);
+
+	/* catch up with the song that is playing */
+	gimmix_metadata_update_song ();
+	#ifdef HAVE_LYRICS
+	gimmix_lyrics_plugin_update_lyrics ();
+	#endif
+
+	return;
+}
+
+static void
+cb_gimmix_metadata_switch_page (GtkNotebook		*notebook,
+				G_GNUC_UNUSED gpointer	page,
+				guint			page_num,
+				G_GNUC_UNUSED gpointer	data)
+{
+	if (metadata_container == NULL &&
+		(gint)page_num == gtk_notebook_page_num (notebook, metadata_page))
+	{
+		gimmix_metadata_panel_load ();
+	}
+
+	return;
+}
+
+gboolean
+gimmix_metadata_panel_loaded (void)
+{
+	return (metadata_container != NULL);
+}
+
 void
 gimmix_metadata_disable_controls (void)
 {
-	gtk_widget_set_sensitive (metadata_container, FALSE);
+	gtk_widget_set_sensitive (metadata_page, FALSE);
 
 	return;
 }
@@ -71,18 +127,18 @@ gimmix_metadata_disable_controls (void)
 void
 gimmix_metadata_enable_controls (void)
 {
-	gtk_widget_set_sensitive (metadata_container, TRUE);
+	gtk_widget_set_sensitive (metadata_page, TRUE);
 
 	return;
 }
 
 void
-gimmix_metadata_set_song_details (mpd_Song	     *song,
+gimmix_metadata_set_song_details (GimmixSong	     *song,
 				  G_GNUC_UNUSED char *albumreview)
 {
 	gchar *markup = NULL;
 	
-	if (song == NULL)
+	if (song == NULL || metadata_container == NULL)
 		return;
 
 	if (song->title)
@@ -135,4 +191,24 @@ gimmix_metadata_set_song_details (mpd_Song	     *song,
 	return;
 }
 
+void
+gimmix_metadata_update_song (void)
+{
+	GimmixSong	*sng;
+
+	if (metadata_container == NULL)
+		return;
+	if (mpd_player_get_state (gmo) == MPD_PLAYER_STOP || !mpd_playlist_get_playlist_length (gmo))
+		return;
+
+	sng = gimmix_song_get_current ();
+	if (sng)
+	{
+		gimmix_metadata_set_song_details (sng, NULL);
+		gimmix_song_unref (sng);
+	}
+
+	return;
+}
+
 
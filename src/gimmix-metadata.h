@@ -6,9 +6,12 @@
 #include "wejpconfig.h"
 #include <gtk/gtk.h>
 
-/* initialize gimmix-metadata */
+/* initialize gimmix-metadata, the panel is built when first shown */
 void gimmix_metadata_init (void);
 
+/* has the metadata panel been built yet */
+gboolean gimmix_metadata_panel_loaded (void);
+
 /* Disable widgets */
 void gimmix_metadata_disable_controls (void);
 
@@ -16,7 +19,10 @@ void gimmix_metadata_disable_controls (void);
 void gimmix_metadata_enable_controls (void);
 
 /* populate gimmix metadata with the specified song details */
-void gimmix_metadata_set_song_details (mpd_Song *song, char* albumreview);
+void gimmix_metadata_set_song_details (GimmixSong *song, char* albumreview);
+
+/* show the details of the current song, if the panel is loaded */
+void gimmix_metadata_update_song (void);
 
 /* show/hide metadata song cover */
 void gimmix_metadata_show_song_cover (gboolean show);
@@ -0,0 +1,681 @@
+/*
+ * gimmix-mpdio.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <poll.h>
+
+#include "gimmix-mpdio.h"
+#include "gimmix-dispatch.h"
+#include "gimmix-net.h"
+#include "gimmix-trace.h"
+#include "gimmix-stats.h"
+
+/* The I/O thread owns a second connection to mpd and speaks the text
+ * protocol directly. Requests are queued from the main loop; whatever
+ * is queued when the thread wakes up is written in one go and the
+ * replies are read back in order, so independent commands are
+ * pipelined. Callbacks are run from the main loop via gimmix-dispatch.
+ */
+
+#define MPDIO_TIMEOUT		10	/* seconds */
+#define MPDIO_BUFSIZE		4096
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL		0
+#endif
+
+typedef struct _mpdio_request {
+	gchar			*text;		/* NULL stops the thread */
+	const char		*name;		/* the command, for the timeline */
+	gint64			queued;
+	GimmixMpdCallback	cb;
+	gpointer		data;
+	GimmixMpdReply		reply;
+} MpdioRequest;
+
+typedef struct _mpdio_conn {
+	int			fd;
+	gchar			buf[MPDIO_BUFSIZE];
+	gsize			start;
+	gsize			end;
+} MpdioConn;
+
+/* Everything one I/O thread needs. A stopped thread is not waited
+ * for, it reaps itself through the dispatcher, so each thread keeps
+ * its own queue and connection details. */
+typedef struct _mpdio_context {
+	GThread			*thread;
+	GAsyncQueue		*queue;
+	gchar			*host;
+	gchar			*password;
+	int			port;
+	int			handover;	/* connected socket to start with, or -1 */
+	GMutex			lock;		/* guards fd */
+	int			fd;
+	gint			stopping;
+} MpdioContext;
+
+static MpdioContext	*mpdio = NULL;
+
+static void
+gimmix_mpdio_request_apply (MpdioRequest *req)
+{
+	if (req->cb)
+		req->cb (&req->reply, req->data);
+
+	return;
+}
+
+static void
+gimmix_mpdio_request_free (MpdioRequest *req)
+{
+	g_free (req->text);
+	g_free (req->reply.error);
+	g_strfreev (req->reply.lines);
+	g_free (req);
+
+	return;
+}
+
+static const GimmixResultType mpdio_result_type = {
+	"mpdio",
+	(void (*) (gpointer))gimmix_mpdio_request_apply,
+	(GDestroyNotify)gimmix_mpdio_request_free,
+	FALSE
+};
+
+/* every request ends here, answered or not. The statistics and the
+ * timeline (gimmix_stats_record () feeds both) see the same requests */
+static void
+gimmix_mpdio_request_finish (MpdioRequest *req)
+{
+	gimmix_stats_record (req->name, req->queued);
+	gimmix_dispatch_post (&mpdio_result_type, req);
+
+	return;
+}
+
+static void
+gimmix_mpdio_request_fail (MpdioRequest *req, const char *error)
+{
+	req->reply.ok = FALSE;
+	if (req->reply.error == NULL)
+		req->reply.error = g_strdup (error);
+	gimmix_mpdio_request_finish (req);
+
+	return;
+}
+
+static void
+gimmix_mpdio_context_free (MpdioContext *ctx)
+{
+	g_thread_join (ctx->thread);
+	g_async_queue_unref (ctx->queue);
+	g_mutex_clear (&ctx->lock);
+	g_free (ctx->host);
+	g_free (ctx->password);
+	g_free (ctx);
+
+	return;
+}
+
+static void
+gimmix_mpdio_context_reap (G_GNUC_UNUSED MpdioContext *ctx)
+{
+	/* nothing to apply, free () joins the thread */
+	return;
+}
+
+/* posted by a thread that has finished, joining it returns at once */
+static const GimmixResultType mpdio_reap_type = {
+	"mpdio-reap",
+	(void (*) (gpointer))gimmix_mpdio_context_reap,
+	(GDestroyNotify)gimmix_mpdio_context_free,
+	FALSE
+};
+
+static void
+gimmix_mpdio_conn_close (MpdioContext *ctx, MpdioConn *conn)
+{
+	g_mutex_lock (&ctx->lock);
+	ctx->fd = -1;
+	g_mutex_unlock (&ctx->lock);
+
+	if (conn->fd >= 0)
+		close (conn->fd);
+	conn->fd = -1;
+	conn->start = conn->end = 0;
+
+	return;
+}
+
+/* write everything, sent receives the number of bytes that made it
+ * to the socket even if the write failed half way */
+static gboolean
+gimmix_mpdio_write_all (MpdioConn *conn, const char *data, gsize len, gsize *sent)
+{
+	*sent = 0;
+	while (len)
+	{
+		ssize_t n = send (conn->fd, data, len, MSG_NOSIGNAL);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		data += n;
+		len -= n;
+		*sent += n;
+	}
+
+	return TRUE;
+}
+
+/* An idle connection has nothing to read. If it has, mpd closed it
+ * (or sent something we can't match to a request) and it must not
+ * be used for the next batch. */
+static gboolean
+gimmix_mpdio_conn_alive (MpdioConn *conn)
+{
+	struct pollfd	pfd;
+	gchar		c;
+
+	if (conn->start < conn->end)
+		return FALSE;
+
+	pfd.fd = conn->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (poll (&pfd, 1, 0) <= 0)
+		return TRUE;
+	if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+		return FALSE;
+
+	return (recv (conn->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0 &&
+		(errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+/* read one line without the trailing newline, NULL on error */
+static gchar *
+gimmix_mpdio_read_line (MpdioConn *conn)
+{
+	GString	*line = NULL;
+
+	while (TRUE)
+	{
+		gchar	*nl;
+		ssize_t	n;
+
+		if (conn->start < conn->end)
+		{
+			nl = memchr (conn->buf + conn->start, '\n', conn->end - conn->start);
+			if (nl != NULL)
+			{
+				gsize len = nl - (conn->buf + conn->start);
+				gchar *ret;
+
+				if (line)
+				{
+					g_string_append_len (line, conn->buf + conn->start, len);
+					ret = g_string_free (line, FALSE);
+				}
+				else
+				{
+					ret = g_strndup (conn->buf + conn->start, len);
+				}
+				conn->start += len + 1;
+				return ret;
+			}
+			/* keep the partial line and refill the buffer */
+			if (line == NULL)
+				line = g_string_new (NULL);
+			g_string_append_len (line, conn->buf + conn->start, conn->end - conn->start);
+		}
+		conn->start = conn->end = 0;
+
+		n = read (conn->fd, conn->buf, MPDIO_BUFSIZE);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+		{
+			if (line)
+				g_string_free (line, TRUE);
+			return NULL;
+		}
+		conn->end = n;
+	}
+}
+
+/* read a complete response, FALSE if the connection broke */
+static gboolean
+gimmix_mpdio_read_reply (MpdioConn *conn, GimmixMpdReply *reply)
+{
+	GPtrArray	*lines;
+	gchar		*line;
+
+	lines = g_ptr_array_new ();
+	while ((line = gimmix_mpdio_read_line (conn)) != NULL)
+	{
+		if (!strcmp (line, "OK"))
+		{
+			g_free (line);
+			reply->ok = TRUE;
+			break;
+		}
+		if (!strncmp (line, "ACK ", 4))
+		{
+			reply->ok = FALSE;
+			reply->error = line;
+			break;
+		}
+		g_ptr_array_add (lines, line);
+	}
+	g_ptr_array_add (lines, NULL);
+	reply->lines = (gchar**)g_ptr_array_free (lines, FALSE);
+
+	return (line != NULL);
+}
+
+/* connect and say hello, or only say hello if fd is already connected */
+static gboolean
+gimmix_mpdio_connect (MpdioContext *ctx, MpdioConn *conn, int fd)
+{
+	struct timeval	tv;
+	gchar		*greeting;
+	gsize		sent;
+
+	if (g_atomic_int_get (&ctx->stopping))
+	{
+		if (fd >= 0)
+			close (fd);
+		return FALSE;
+	}
+	if (fd < 0)
+		fd = gimmix_net_connect (ctx->host, ctx->port, MPDIO_TIMEOUT * 1000, NULL);
+	conn->fd = fd;
+	if (conn->fd < 0)
+		return FALSE;
+
+	/* publish the socket so that stopping can shut it down */
+	g_mutex_lock (&ctx->lock);
+	ctx->fd = conn->fd;
+	g_mutex_unlock (&ctx->lock);
+	if (g_atomic_int_get (&ctx->stopping))
+	{
+		gimmix_mpdio_conn_close (ctx, conn);
+		return FALSE;
+	}
+
+	tv.tv_sec = MPDIO_TIMEOUT;
+	tv.tv_usec = 0;
+	setsockopt (conn->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt (conn->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	/* "OK MPD <version>" */
+	greeting = gimmix_mpdio_read_line (conn);
+	if (greeting == NULL || strncmp (greeting, "OK MPD ", 7))
+	{
+		g_free (greeting);
+		gimmix_mpdio_conn_close (ctx, conn);
+		return FALSE;
+	}
+	g_free (greeting);
+
+	if (ctx->password && strlen (ctx->password))
+	{
+		GimmixMpdReply	reply = { FALSE, NULL, NULL };
+		gchar		*pass = gimmix_mpd_quote (ctx->password);
+		gchar		*cmd = g_strdup_printf ("password %s\n", pass);
+		gboolean	ret;
+
+		ret = gimmix_mpdio_write_all (conn, cmd, strlen (cmd), &sent) &&
+			gimmix_mpdio_read_reply (conn, &reply) && reply.ok;
+		g_free (pass);
+		g_free (cmd);
+		g_free (reply.error);
+		g_strfreev (reply.lines);
+		if (!ret)
+		{
+			gimmix_mpdio_conn_close (ctx, conn);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* the command a request starts with, for the statistics */
+static const char *
+gimmix_mpdio_command_name (const char *text)
+{
+	const char	*name;
+	gchar		*word;
+
+	if (!strncmp (text, "command_list", 12))
+		return "command_list";
+	word = g_strndup (text, strcspn (text, " \n"));
+	name = g_intern_string (word);
+	g_free (word);
+
+	return name;
+}
+
+/* write a batch of requests in one go and read back the replies.
+ * Returns the number of requests that got a reply, sent_any tells
+ * whether any part of the batch reached the socket. */
+static guint
+gimmix_mpdio_process (MpdioConn *conn, GPtrArray *batch, gboolean *sent_any)
+{
+	GString	*out;
+	gsize	sent;
+	guint	i;
+
+	out = g_string_new (NULL);
+	for (i = 0; i < batch->len; i++)
+		g_string_append (out, ((MpdioRequest*)g_ptr_array_index (batch, i))->text);
+
+	if (!gimmix_mpdio_write_all (conn, out->str, out->len, &sent))
+	{
+		*sent_any = (sent > 0);
+		g_string_free (out, TRUE);
+		return 0;
+	}
+	*sent_any = TRUE;
+	g_string_free (out, TRUE);
+
+	for (i = 0; i < batch->len; i++)
+	{
+		MpdioRequest *req = g_ptr_array_index (batch, i);
+
+		if (!gimmix_mpdio_read_reply (conn, &req->reply))
+		{
+			g_free (req->reply.error);
+			req->reply.error = NULL;
+			g_strfreev (req->reply.lines);
+			req->reply.lines = NULL;
+			break;
+		}
+		gimmix_mpdio_request_finish (req);
+	}
+
+	return i;
+}
+
+static gpointer
+gimmix_mpdio_thread (MpdioContext *ctx)
+{
+	MpdioConn	conn;
+	GPtrArray	*batch;
+	MpdioRequest	*req;
+	gboolean	running = TRUE;
+	gboolean	sent_any;
+
+	conn.fd = -1;
+	conn.start = conn.end = 0;
+	batch = g_ptr_array_new ();
+	gimmix_trace_thread_name ("mpdio");
+
+	/* the socket the connect probe opened saves a handshake */
+	if (ctx->handover >= 0)
+		gimmix_mpdio_connect (ctx, &conn, ctx->handover);
+
+	while (running)
+	{
+		guint		done;
+		guint		i;
+
+		/* wait for a request, then grab everything else queued */
+		req = g_async_queue_pop (ctx->queue);
+		do
+		{
+			if (req->text == NULL)
+			{
+				running = FALSE;
+				gimmix_mpdio_request_free (req);
+				continue;
+			}
+			g_ptr_array_add (batch, req);
+		} while ((req = g_async_queue_try_pop (ctx->queue)) != NULL);
+
+		if (batch->len == 0)
+			continue;
+
+		if (g_atomic_int_get (&ctx->stopping))
+		{
+			for (i = 0; i < batch->len; i++)
+				gimmix_mpdio_request_fail (g_ptr_array_index (batch, i), "disconnected");
+			g_ptr_array_set_size (batch, 0);
+			continue;
+		}
+
+		/* mpd drops idle clients, find out before sending anything */
+		if (conn.fd >= 0 && !gimmix_mpdio_conn_alive (&conn))
+			gimmix_mpdio_conn_close (ctx, &conn);
+
+		if (conn.fd < 0 && !gimmix_mpdio_connect (ctx, &conn, -1))
+		{
+			for (i = 0; i < batch->len; i++)
+				gimmix_mpdio_request_fail (g_ptr_array_index (batch, i), "not connected");
+			g_ptr_array_set_size (batch, 0);
+			continue;
+		}
+
+		done = gimmix_mpdio_process (&conn, batch, &sent_any);
+		if (done == 0 && !sent_any)
+		{
+			/* nothing reached mpd, so nothing can run twice */
+			gimmix_mpdio_conn_close (ctx, &conn);
+			if (gimmix_mpdio_connect (ctx, &conn, -1))
+				done = gimmix_mpdio_process (&conn, batch, &sent_any);
+		}
+		if (done < batch->len)
+		{
+			/* mpd may have run some of these, don't send them again */
+			gimmix_mpdio_conn_close (ctx, &conn);
+			for (i = done; i < batch->len; i++)
+				gimmix_mpdio_request_fail (g_ptr_array_index (batch, i), "connection lost");
+		}
+		g_ptr_array_set_size (batch, 0);
+	}
+
+	g_ptr_array_free (batch, TRUE);
+	gimmix_mpdio_conn_close (ctx, &conn);
+
+	/* whatever was queued after the stop request */
+	while ((req = g_async_queue_try_pop (ctx->queue)) != NULL)
+	{
+		if (req->text == NULL)
+			gimmix_mpdio_request_free (req);
+		else
+			gimmix_mpdio_request_fail (req, "disconnected");
+	}
+	gimmix_dispatch_post (&mpdio_reap_type, ctx);
+
+	return NULL;
+}
+
+static void
+gimmix_mpdio_push (gchar *text, GimmixMpdCallback cb, gpointer data)
+{
+	MpdioRequest *req;
+
+	req = g_new0 (MpdioRequest, 1);
+	req->text = text;
+	req->name = gimmix_mpdio_command_name (text);
+	req->queued = g_get_monotonic_time ();
+	req->cb = cb;
+	req->data = data;
+
+	if (mpdio == NULL)
+	{
+		gimmix_mpdio_request_fail (req, "not connected");
+		return;
+	}
+	g_async_queue_push (mpdio->queue, req);
+
+	return;
+}
+
+gboolean
+gimmix_mpdio_start (const char *host, int port, const char *password, int fd)
+{
+	MpdioContext	*ctx;
+
+	if (mpdio != NULL)
+		gimmix_mpdio_stop ();
+
+	ctx = g_new0 (MpdioContext, 1);
+	ctx->queue = g_async_queue_new ();
+	ctx->host = g_strdup (host);
+	ctx->password = g_strdup (password);
+	ctx->port = port;
+	ctx->handover = fd;
+	ctx->fd = -1;
+	g_mutex_init (&ctx->lock);
+	ctx->thread = g_thread_new ("mpdio", (GThreadFunc)gimmix_mpdio_thread, ctx);
+	mpdio = ctx;
+
+	return TRUE;
+}
+
+void
+gimmix_mpdio_stop (void)
+{
+	MpdioContext	*ctx = mpdio;
+
+	if (ctx == NULL)
+		return;
+	mpdio = NULL;
+
+	/* Don't wait for the thread, it may sit in a read for up to
+	 * MPDIO_TIMEOUT. Shutting the socket down wakes it up, it fails
+	 * whatever is left and reaps itself via the dispatcher. */
+	g_atomic_int_set (&ctx->stopping, 1);
+	g_async_queue_push (ctx->queue, g_new0 (MpdioRequest, 1));
+	g_mutex_lock (&ctx->lock);
+	if (ctx->fd >= 0)
+		shutdown (ctx->fd, SHUT_RDWR);
+	g_mutex_unlock (&ctx->lock);
+
+	return;
+}
+
+gboolean
+gimmix_mpdio_is_running (void)
+{
+	return (mpdio != NULL);
+}
+
+void
+gimmix_mpdio_command (GimmixMpdCallback cb, gpointer data, const char *format, ...)
+{
+	va_list	args;
+	gchar	*cmd;
+
+	va_start (args, format);
+	cmd = g_strdup_vprintf (format, args);
+	va_end (args);
+
+	gimmix_mpdio_push (g_strconcat (cmd, "\n", NULL), cb, data);
+	g_free (cmd);
+
+	return;
+}
+
+void
+gimmix_mpdio_command_list (GimmixMpdCallback cb, gpointer data, const char * const *commands)
+{
+	GString	*text;
+	int	i;
+
+	text = g_string_new ("command_list_ok_begin\n");
+	for (i = 0; commands[i] != NULL; i++)
+	{
+		g_string_append (text, commands[i]);
+		g_string_append_c (text, '\n');
+	}
+	g_string_append (text, "command_list_end\n");
+
+	gimmix_mpdio_push (g_string_free (text, FALSE), cb, data);
+
+	return;
+}
+
+const char *
+gimmix_mpd_reply_get (const GimmixMpdReply *reply, const char *key)
+{
+	size_t	len;
+	int	i;
+
+	if (reply == NULL || reply->lines == NULL)
+		return NULL;
+
+	len = strlen (key);
+	for (i = 0; reply->lines[i] != NULL; i++)
+	{
+		if (!strncmp (reply->lines[i], key, len) &&
+			reply->lines[i][len] == ':' && reply->lines[i][len+1] == ' ')
+			return reply->lines[i] + len + 2;
+	}
+
+	return NULL;
+}
+
+gchar **
+gimmix_mpd_reply_steal_lines (const GimmixMpdReply *reply)
+{
+	/* the reply belongs to a request that is freed after the
+	 * callback, which copes with lines being NULL */
+	GimmixMpdReply	*r = (GimmixMpdReply*)reply;
+	gchar		**lines = r->lines;
+
+	r->lines = NULL;
+
+	return lines;
+}
+
+char *
+gimmix_mpd_quote (const char *arg)
+{
+	GString		*str;
+	const char	*p;
+
+	str = g_string_new ("\"");
+	for (p = arg; *p; p++)
+	{
+		if (*p == '"' || *p == '\\')
+			g_string_append_c (str, '\\');
+		g_string_append_c (str, *p);
+	}
+	g_string_append_c (str, '"');
+
+	return g_string_free (str, FALSE);
+}
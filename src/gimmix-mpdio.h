@@ -0,0 +1,45 @@
+#ifndef GIMMIX_MPDIO_H
+#define GIMMIX_MPDIO_H
+
+#include <glib.h>
+
+/* Reply to a single command or a command list */
+typedef struct _gimmix_mpd_reply {
+	gboolean	ok;
+	gchar		*error;		/* the ACK line if !ok */
+	gchar		**lines;	/* response lines, without the final OK */
+} GimmixMpdReply;
+
+/* Called from the main loop once the reply has arrived */
+typedef void (*GimmixMpdCallback) (const GimmixMpdReply *reply, gpointer data);
+
+/* start the I/O thread with its own connection to mpd. fd is a socket
+ * already connected to host that the thread takes over, or -1 */
+gboolean gimmix_mpdio_start (const char *host, int port, const char *password, int fd);
+
+/* stop the I/O thread without waiting for it, pending callbacks are
+ * called with an error */
+void gimmix_mpdio_stop (void);
+
+/* is the I/O thread running */
+gboolean gimmix_mpdio_is_running (void);
+
+/* queue a single command, cb may be NULL */
+void gimmix_mpdio_command (GimmixMpdCallback cb, gpointer data, const char *format, ...) G_GNUC_PRINTF (3, 4);
+
+/* queue a NULL terminated array of commands as one command_list_ok_begin block.
+ * Each command's response ends with a "list_OK" line in reply->lines */
+void gimmix_mpdio_command_list (GimmixMpdCallback cb, gpointer data, const char * const *commands);
+
+/* get the value of the first "key: value" line in a reply */
+const char *gimmix_mpd_reply_get (const GimmixMpdReply *reply, const char *key);
+
+/* take the lines of a reply over from inside its callback, e.g. to
+ * hand them to a worker. The reply has no lines afterwards, free the
+ * result with g_strfreev () */
+gchar **gimmix_mpd_reply_steal_lines (const GimmixMpdReply *reply);
+
+/* quote a command argument (returned string should be freed) */
+char *gimmix_mpd_quote (const char *arg);
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ * gimmix-net.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "gimmix-net.h"
+
+/* delay before the next address is tried in parallel (RFC 6555) */
+#define ATTEMPT_DELAY	250	/* ms */
+#define MAX_ATTEMPTS	16
+
+typedef struct _net_attempt {
+	int		fd;
+	struct addrinfo	*ai;
+} NetAttempt;
+
+static void
+gimmix_net_set_blocking (int fd, gboolean blocking)
+{
+	int flags = fcntl (fd, F_GETFL, 0);
+
+	if (blocking)
+		fcntl (fd, F_SETFL, flags & ~O_NONBLOCK);
+	else
+		fcntl (fd, F_SETFL, flags | O_NONBLOCK);
+
+	return;
+}
+
+/* alternate address families, starting with the first one returned */
+static GPtrArray *
+gimmix_net_sort_addresses (struct addrinfo *res)
+{
+	GPtrArray	*first;
+	GPtrArray	*other;
+	GPtrArray	*ret;
+	struct addrinfo	*ai;
+	guint		i;
+
+	first = g_ptr_array_new ();
+	other = g_ptr_array_new ();
+	for (ai = res; ai != NULL; ai = ai->ai_next)
+	{
+		if (ai->ai_family == res->ai_family)
+			g_ptr_array_add (first, ai);
+		else
+			g_ptr_array_add (other, ai);
+	}
+
+	ret = g_ptr_array_new ();
+	for (i = 0; i < MAX (first->len, other->len); i++)
+	{
+		if (i < first->len)
+			g_ptr_array_add (ret, g_ptr_array_index (first, i));
+		if (i < other->len)
+			g_ptr_array_add (ret, g_ptr_array_index (other, i));
+	}
+	g_ptr_array_free (first, TRUE);
+	g_ptr_array_free (other, TRUE);
+
+	return ret;
+}
+
+/* start a non-blocking connect, -1 if it failed right away */
+static int
+gimmix_net_start_attempt (struct addrinfo *ai)
+{
+	int fd;
+
+	fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (fd < 0)
+		return -1;
+
+	gimmix_net_set_blocking (fd, FALSE);
+	if (connect (fd, ai->ai_addr, ai->ai_addrlen) < 0 && errno != EINPROGRESS)
+	{
+		close (fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+gboolean
+gimmix_net_is_local (const char *host)
+{
+	return (host != NULL && host[0] == '/');
+}
+
+gboolean
+gimmix_net_is_supported (const char *host)
+{
+	return (host == NULL || host[0] != '@');
+}
+
+/* connect to a unix domain socket */
+static int
+gimmix_net_connect_local (const char *path)
+{
+	struct sockaddr_un	sun;
+	size_t			plen;
+	int			fd;
+
+	plen = strlen (path);
+	if (plen >= sizeof(sun.sun_path))
+		return -1;
+
+	memset (&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	memcpy (sun.sun_path, path, plen);
+
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (connect (fd, (struct sockaddr*)&sun, sizeof(sun)) < 0)
+	{
+		close (fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int
+gimmix_net_connect (const char *host, int port, int timeout_ms, char **addr)
+{
+	struct addrinfo	hints;
+	struct addrinfo	*res = NULL;
+	struct addrinfo	*winner = NULL;
+	GPtrArray	*addrs;
+	NetAttempt	attempts[MAX_ATTEMPTS];
+	struct pollfd	pfds[MAX_ATTEMPTS];
+	gchar		service[16];
+	gint64		deadline;
+	gint64		next_start;
+	guint		started = 0;
+	guint		active = 0;
+	int		fd = -1;
+	guint		i;
+
+	if (!gimmix_net_is_supported (host))
+		return -1;
+
+	if (gimmix_net_is_local (host))
+	{
+		fd = gimmix_net_connect_local (host);
+		if (fd >= 0 && addr != NULL)
+			*addr = g_strdup (host);
+		return fd;
+	}
+
+	memset (&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	g_snprintf (service, sizeof(service), "%d", port);
+	if (getaddrinfo (host, service, &hints, &res) != 0)
+		return -1;
+
+	addrs = gimmix_net_sort_addresses (res);
+	deadline = g_get_monotonic_time () + (gint64)timeout_ms * 1000;
+	next_start = 0;
+
+	while (fd < 0)
+	{
+		gint64	now = g_get_monotonic_time ();
+		gint64	wait;
+		int	n;
+
+		if (now >= deadline)
+			break;
+
+		/* start the next attempt if its turn has come or everything
+		 * else has failed already */
+		if (started < addrs->len && started < MAX_ATTEMPTS && (now >= next_start || active == 0))
+		{
+			struct addrinfo *ai = g_ptr_array_index (addrs, started++);
+			int afd = gimmix_net_start_attempt (ai);
+
+			if (afd >= 0)
+			{
+				attempts[active].fd = afd;
+				attempts[active].ai = ai;
+				active++;
+			}
+			next_start = now + ATTEMPT_DELAY * 1000;
+			continue;
+		}
+		if (active == 0)
+			break;
+
+		wait = deadline - now;
+		if (started < addrs->len && started < MAX_ATTEMPTS)
+			wait = MIN (wait, next_start - now);
+		for (i = 0; i < active; i++)
+		{
+			pfds[i].fd = attempts[i].fd;
+			pfds[i].events = POLLOUT;
+			pfds[i].revents = 0;
+		}
+		n = poll (pfds, active, (int)((wait + 999) / 1000));
+		if (n < 0 && errno != EINTR)
+			break;
+		if (n <= 0)
+			continue;
+
+		for (i = 0; i < active; )
+		{
+			int		err = 0;
+			socklen_t	len = sizeof(err);
+
+			if (!pfds[i].revents)
+			{
+				i++;
+				continue;
+			}
+			getsockopt (attempts[i].fd, SOL_SOCKET, SO_ERROR, &err, &len);
+			if (err == 0 && fd < 0)
+			{
+				fd = attempts[i].fd;
+				winner = attempts[i].ai;
+			}
+			else
+			{
+				close (attempts[i].fd);
+			}
+			/* drop it from the active set */
+			active--;
+			attempts[i] = attempts[active];
+			pfds[i] = pfds[active];
+		}
+	}
+
+	/* close the attempts that lost */
+	for (i = 0; i < active; i++)
+		close (attempts[i].fd);
+
+	if (fd >= 0)
+	{
+		int one = 1;
+
+		gimmix_net_set_blocking (fd, TRUE);
+		/* mpd commands are small, don't let Nagle hold them back */
+		setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		if (addr != NULL)
+		{
+			gchar buf[NI_MAXHOST];
+
+			if (getnameinfo (winner->ai_addr, winner->ai_addrlen, buf, sizeof(buf),
+					NULL, 0, NI_NUMERICHOST) == 0)
+				*addr = g_strdup (buf);
+			else
+				*addr = g_strdup (host);
+		}
+	}
+	g_ptr_array_free (addrs, TRUE);
+	freeaddrinfo (res);
+
+	return fd;
+}
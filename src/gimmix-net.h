@@ -0,0 +1,22 @@
+#ifndef GIMMIX_NET_H
+#define GIMMIX_NET_H
+
+#include <glib.h>
+
+/* Is host the path of a unix domain socket */
+gboolean gimmix_net_is_local (const char *host);
+
+/* Can host be connected to at all. Abstract unix sockets ("@name")
+ * can't, libmpd would take them for host names */
+gboolean gimmix_net_is_supported (const char *host);
+
+/* Open a connection to host:port, or to the unix domain socket host
+ * (the port is ignored then).
+ * All resolved addresses are tried in parallel, each new attempt
+ * started a short delay after the previous one (happy eyeballs).
+ * Returns the connected blocking socket or -1, also for a host that
+ * is not supported. If addr is not NULL
+ * it receives the numeric address that answered (free with g_free). */
+int gimmix_net_connect (const char *host, int port, int timeout_ms, char **addr);
+
+#endif
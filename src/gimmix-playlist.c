@@ -26,6 +26,17 @@
 #include <gdk/gdkkeysyms.h>
 #include "gimmix-playlist.h"
 #include "gimmix-tagedit.h"
+#include "gimmix-batch.h"
+#include "gimmix-queue.h"
+#include "gimmix-library.h"
+#include "gimmix-mpdio.h"
+#include "gimmix-status.h"
+#include "gimmix-stats.h"
+#include "gimmix-tagbrowser.h"
+#include "gimmix-intern.h"
+#include "gimmix-arena.h"
+#include "gimmix-sort.h"
+#include "gimmix-reorder.h"
 
 #define GIMMIX_MEDIA_ICON 	"gimmix_logo_small.png"
 #define GIMMIX_PLAYLIST_ICON 	"gimmix_playlist.png"
@@ -38,12 +49,6 @@ typedef enum {
 	COLUMN_LENGTH
 } GimmixColumnType;
 
-typedef enum {
-	GIMMIX_FILE_SONG = 1,
-	GIMMIX_FILE_DIR,
-	GIMMIX_FILE_PLAYLIST
-} GimmixFileType;
-
 enum { TARGET_STRING, TARGET_ROOTWIN };
   	GtkTargetEntry targetentries[] =
     	{
@@ -92,6 +97,82 @@ extern GtkWidget	*tag_editor_window;
 
 gchar			*loaded_playlist;
 
+/* directory currently shown in the library browser */
+static gchar		*library_current_dir = NULL;
+
+typedef struct _library_request {
+	gchar			*path;
+	GtkTreeRowReference	*row;		/* NULL for the top level */
+	guint			serial;
+	guint			generation;	/* of library_cache when sent */
+} LibraryRequest;
+
+/* children of the directories expanded in the library browser, by path */
+static GHashTable	*library_cache = NULL;	/* path -> GPtrArray of GimmixLibraryEntry */
+
+/* bumped when the cache is emptied, listings asked for before that
+ * are not stored */
+static guint		library_cache_generation = 0;
+
+/* bumped whenever the browser shows another directory or search, the
+ * replies for what it showed before are dropped */
+static guint		library_view_serial = 0;
+
+static GimmixArena	*row_arena = NULL;
+
+/* queues from this length on are fetched page by page, unless
+ * playlist_paged_min in gimmixrc says otherwise */
+#define PLAYLIST_PAGED_MIN	5000
+
+static gboolean		playlist_paged = FALSE;
+static long long	paged_version = -1;
+static gint		paged_current_pos = -1;
+
+/* a paged queue follows a new version with plchangesposid, replies to
+ * older requests are dropped */
+static guint		paged_sync_serial = 0;
+
+typedef struct _paged_sync {
+	guint		serial;
+	long long	version;
+	guint		length;
+} PagedSync;
+
+/* more changed rows than this fraction of the queue are cheaper to
+ * rebuild from scratch */
+#define PAGED_REBUILD_DIVISOR	2
+
+/* a short queue is fetched whole, replies to older fetches are dropped */
+static guint		playlist_fetch_serial = 0;
+static guint		playlist_visible_source = 0;
+
+/* the queue view can be sorted by a column without touching the server
+ * queue, the collation keys of its songs are kept between refreshes */
+static GimmixSortCache	*playlist_sort = NULL;
+static GimmixSortColumn	playlist_sort_column = GIMMIX_SORT_NONE;
+static gboolean		playlist_sort_descending = FALSE;
+
+/* a reorder of the server queue on its way */
+typedef struct _playlist_reorder {
+	gint		*queue;		/* song ids in server order before the moves */
+	guint		len;
+	long long	version;	/* queue version before the moves */
+	guint		serial;
+} PlaylistReorder;
+
+/* total duration of the queue in seconds, if it was fetched whole */
+static gint		playlist_total_time = 0;
+
+/* stored playlists as last listed by mpd */
+typedef struct _stored_playlist {
+	gchar		*name;
+	gchar		*modified;	/* Last-Modified stamp */
+} StoredPlaylist;
+
+static GPtrArray	*stored_playlists = NULL;
+static gboolean		stored_playlists_pending = FALSE;
+static gboolean		stored_playlists_again = FALSE;
+
 static void
 on_drag_data_received (G_GNUC_UNUSED GtkWidget *widget,
 		       GdkDragContext	       *context,
@@ -112,9 +193,11 @@ on_drag_data_received (G_GNUC_UNUSED GtkWidget *widget,
 		{
 			case TARGET_STRING:
 			{
+				GimmixBatch *batch = gimmix_batch_new ();
+
 				path = (gchar*) selection_data->data;
-				mpd_playlist_queue_add (gmo, path);
-				mpd_playlist_queue_commit (gmo);
+				gimmix_batch_add (batch, path);
+				gimmix_batch_commit (batch, NULL, NULL);
 				dnd_success = TRUE;
 				break;
 			}
@@ -223,6 +306,12 @@ static void		gimmix_playlists_popup_menu (void);
 static gchar*		gimmix_path_get_parent_dir (gchar *);
 static void		gimmix_load_playlist (gchar *);
 static void		gimmix_display_total_playlist_time (MpdObj *);
+static void		gimmix_current_playlist_fill (guint first, GPtrArray *songs, gpointer data);
+static void		gimmix_current_playlist_evict (guint first, guint n, gpointer data);
+static void		cb_current_playlist_scrolled (GtkAdjustment *adj, gpointer data);
+static void		cb_current_playlist_column_clicked (GtkTreeViewColumn *column, gpointer data);
+static void		gimmix_current_playlist_sort_view (void);
+static void		gimmix_current_playlist_set_sort (GtkTreeViewColumn *column, GimmixSortColumn sort, gboolean descending);
 
 /* Callbacks */
 /* Current playlist callbacks */
@@ -236,11 +325,25 @@ static void		gimmix_current_playlist_remove_song (void);
 static void		gimmix_current_playlist_crop_song (void);
 static void		gimmix_current_playlist_song_info (void);
 static void		gimmix_current_playlist_clear (void);
-static gboolean		gimmix_update_player_status (gpointer data);
+static void		gimmix_current_playlist_apply_order (void);
+static void		gimmix_current_playlist_clear_view (GimmixBatch *batch);
+static void		gimmix_library_play_on_add (GimmixBatch *batch);
+#ifdef HAVE_TAGEDITOR
+static void		gimmix_current_playlist_edit_tags (void);
+#endif
+static void		cb_library_update_status (const GimmixMpdReply *reply, gpointer data);
 
 /* Library browser callbacks */
 static void		cb_library_dir_activated (gpointer data);
+static gboolean		cb_library_row_expand (GtkTreeView *treeview, GtkTreeIter *iter, GtkTreePath *path, gpointer data);
+static void		gimmix_library_add_placeholder (GtkTreeStore *store, GtkTreeIter *parent);
+static void		gimmix_library_fill_node (GtkTreeIter *parent, GPtrArray *entries);
+static void		gimmix_library_cache_init (void);
+static void		cb_library_listed (const GimmixMpdReply *reply, gpointer data);
 static void		gimmix_library_song_info (void);
+#ifdef HAVE_TAGEDITOR
+static void		gimmix_library_edit_tags (void);
+#endif
 static void		cb_playlist_activated (GtkTreeView *);
 static void		cb_library_right_click (GtkTreeView *treeview, GdkEventButton *event);
 static void		cb_library_popup_add_clicked (GtkWidget *widget, gpointer data);
@@ -271,6 +374,23 @@ gimmix_playlist_search_widgets_init (void)
 	return;
 }
 
+/* artist and album are pooled strings, shared by all rows that have them */
+static void
+gimmix_current_playlist_render_tag (G_GNUC_UNUSED GtkTreeViewColumn *column,
+					GtkCellRenderer *renderer,
+					GtkTreeModel *model,
+					GtkTreeIter *iter,
+					gpointer data)
+{
+	const gchar *value;
+
+	gtk_tree_model_get (model, iter, GPOINTER_TO_INT(data), &value, -1);
+	g_object_set (G_OBJECT(renderer), "text", value, NULL);
+	gimmix_intern_unref (value);
+
+	return;
+}
+
 void
 gimmix_playlist_setup_current_playlist_tvw (void)
 {
@@ -296,52 +416,70 @@ gimmix_playlist_setup_current_playlist_tvw (void)
 	g_object_set (G_OBJECT(current_playlist_column), "expand", TRUE, "spacing", 4, NULL);
 	gtk_tree_view_append_column (GTK_TREE_VIEW(current_playlist_treeview), current_playlist_column);
 	cpl_tvw_title_column = (GtkWidget*)current_playlist_column;
+	g_signal_connect (current_playlist_column, "clicked", G_CALLBACK(cb_current_playlist_column_clicked), GINT_TO_POINTER(GIMMIX_SORT_TITLE));
 	
 	current_playlist_renderer = gtk_cell_renderer_text_new ();
 	g_object_set (G_OBJECT(current_playlist_renderer), "ellipsize", PANGO_ELLIPSIZE_END, NULL);
 	current_playlist_column = gtk_tree_view_column_new_with_attributes (_("Artist"),
 										current_playlist_renderer,
-										"markup", 3,
+										"weight", 6,
 										NULL);
+	gtk_tree_view_column_set_cell_data_func (current_playlist_column, current_playlist_renderer,
+						gimmix_current_playlist_render_tag, GINT_TO_POINTER(3), NULL);
 	gtk_tree_view_column_set_resizable (current_playlist_column, TRUE);
 	gtk_tree_view_column_set_clickable (current_playlist_column, TRUE);
 	//gtk_tree_view_column_set_min_width (current_playlist_column, 100);
 	g_object_set (G_OBJECT(current_playlist_column), "expand", TRUE, "spacing", 4, NULL);
 	gtk_tree_view_append_column (GTK_TREE_VIEW(current_playlist_treeview), current_playlist_column);
 	cpl_tvw_artist_column = (GtkWidget*)current_playlist_column;
+	g_signal_connect (current_playlist_column, "clicked", G_CALLBACK(cb_current_playlist_column_clicked), GINT_TO_POINTER(GIMMIX_SORT_ARTIST));
 	
 	current_playlist_renderer = gtk_cell_renderer_text_new ();
 	g_object_set (G_OBJECT(current_playlist_renderer), "ellipsize", PANGO_ELLIPSIZE_END, NULL);
 	current_playlist_column = gtk_tree_view_column_new_with_attributes (_("Album"),
 										current_playlist_renderer,
-										"markup", 4,
+										"weight", 6,
 										NULL);
+	gtk_tree_view_column_set_cell_data_func (current_playlist_column, current_playlist_renderer,
+						gimmix_current_playlist_render_tag, GINT_TO_POINTER(4), NULL);
 	gtk_tree_view_column_set_resizable (current_playlist_column, TRUE);
 	gtk_tree_view_column_set_clickable (current_playlist_column, TRUE);
 	//gtk_tree_view_column_set_min_width (current_playlist_column, 100);
 	g_object_set (G_OBJECT(current_playlist_column), "expand", TRUE, "spacing", 4, NULL);
 	gtk_tree_view_append_column (GTK_TREE_VIEW(current_playlist_treeview), current_playlist_column);
 	cpl_tvw_album_column = (GtkWidget*)current_playlist_column;
+	g_signal_connect (current_playlist_column, "clicked", G_CALLBACK(cb_current_playlist_column_clicked), GINT_TO_POINTER(GIMMIX_SORT_ALBUM));
 							
 	current_playlist_renderer = gtk_cell_renderer_text_new ();
 	current_playlist_column = gtk_tree_view_column_new_with_attributes (_("Length"),
 										current_playlist_renderer,
 										"markup", 5,
 										NULL);
+	gtk_tree_view_column_set_clickable (current_playlist_column, TRUE);
 	gtk_tree_view_append_column (GTK_TREE_VIEW(current_playlist_treeview), current_playlist_column);
 	cpl_tvw_length_column = (GtkWidget*)current_playlist_column;
+	g_signal_connect (current_playlist_column, "clicked", G_CALLBACK(cb_current_playlist_column_clicked), GINT_TO_POINTER(GIMMIX_SORT_LENGTH));
 	
-	current_playlist_store = gtk_list_store_new (6,
+	current_playlist_store = gtk_list_store_new (7,
 						G_TYPE_STRING, 	/* name (0) */
 						G_TYPE_STRING, 	/* path (1) */
 						G_TYPE_INT,	/* id	(2) */
-						G_TYPE_STRING,  /* artist (3) */
-						G_TYPE_STRING,  /* album (4) */
-						G_TYPE_STRING); /* length (5) */
+						GIMMIX_TYPE_INTERN,	/* artist (3) */
+						GIMMIX_TYPE_INTERN,	/* album (4) */
+						G_TYPE_STRING,	/* length (5) */
+						G_TYPE_INT);	/* weight of artist and album (6) */
 	current_playlist_model	= GTK_TREE_MODEL (current_playlist_store);
 	current_playlist_selection = gtk_tree_view_get_selection (GTK_TREE_VIEW(current_playlist_treeview));
 	gtk_tree_selection_set_mode (current_playlist_selection, GTK_SELECTION_MULTIPLE);
 	gtk_tree_view_set_model (GTK_TREE_VIEW (current_playlist_treeview), current_playlist_model);
+	playlist_sort = gimmix_sort_cache_new ();
+
+	/* long queues are loaded while they are scrolled */
+	gimmix_queue_init (gimmix_current_playlist_fill, gimmix_current_playlist_evict, NULL);
+	g_signal_connect (gtk_tree_view_get_vadjustment (GTK_TREE_VIEW(current_playlist_treeview)),
+			"value-changed", G_CALLBACK(cb_current_playlist_scrolled), NULL);
+	g_signal_connect (gtk_tree_view_get_vadjustment (GTK_TREE_VIEW(current_playlist_treeview)),
+			"changed", G_CALLBACK(cb_current_playlist_scrolled), NULL);
 	
 	/* Drag and Drop */
 	gtk_drag_dest_set(GTK_WIDGET(current_playlist_treeview),
@@ -472,454 +610,926 @@ gimmix_playlist_init (void)
 	/* Initialize playlist search */
 	gimmix_search_init ();
 
+	/* the tag page of the library window */
+	gimmix_tagbrowser_init ();
+
 	return;
 }
 
-void
-gimmix_update_current_playlist (MpdObj *mo, MpdData *pdata)
+/* scratch space for the strings made while rows are formatted, it is
+ * reset once a refresh has put its rows in the store */
+static GimmixArena *
+gimmix_playlist_row_arena (void)
 {
-	GtkListStore	*current_playlist_store;
-	GtkTreeIter	current_playlist_iter;
-	gint		current_song_id = -1;
-	MpdData		*data = pdata;
+	if (row_arena == NULL)
+		row_arena = gimmix_arena_new ();
 
-	if (data!=NULL && mpd_check_connected(mo))
-	{
-		current_song_id = mpd_player_get_current_song_id (mo);
-	}
+	return row_arena;
+}
+
+/* fill one row of the current playlist, the playing song is shown in bold */
+static void
+gimmix_current_playlist_set_row (MpdObj *mo, GtkListStore *store, GtkTreeIter *iter, mpd_Song *song, gint current_song_id)
+{
+	GimmixArena	*arena = gimmix_playlist_row_arena ();
+	gchar 		*title = NULL;
+	const gchar	*artist;
+	const gchar	*album;
+	gchar 		*ti;
+	gchar		time[15];
+
+	if (song->title != NULL)
+		title = gimmix_arena_markup_escape (arena, song->title);
 	else
+		title = gimmix_arena_markup_escape (arena, gimmix_arena_song_name (arena, song->file));
+	gimmix_get_total_time_for_song (mo, song, time);
+
+	if (song->id == current_song_id)
 	{
-		return;
+		title = gimmix_arena_printf (arena, "<span size=\"medium\"weight=\"bold\">%s</span>", title);
+		ti = gimmix_arena_printf (arena, "<span size=\"medium\" weight=\"bold\">%s</span>", time);
 	}
-	current_playlist_store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview)));
-	gtk_list_store_clear (current_playlist_store);
-	
-	while (data != NULL)
-	{
-		gchar 	*title = NULL;
-		gchar	*artist = NULL;
-		gchar	*album = NULL;
-		gchar 	*ti;
-		gchar	time[15];
-		
-		if (data->song->id == current_song_id)
-		{
-			if (data->song->title != NULL)
-			{
-				/*
-				if (data->song->artist)
-				title = g_markup_printf_escaped ("<span size=\"medium\"weight=\"bold\">%s - %s</span>", data->song->artist, data->song->title);
-				else
-				*/
-				title = g_markup_printf_escaped ("<span size=\"medium\"weight=\"bold\">%s</span>", data->song->title);
-			}
-			else
-			{
-				gchar *file = g_path_get_basename (data->song->file);
-				gimmix_strip_file_ext (file);
-				title = g_markup_printf_escaped ("<span size=\"medium\"weight=\"bold\">%s</span>", file);
-				g_free (file);
-			}
-			if (data->song->artist != NULL)
-			{
-				artist = g_markup_printf_escaped ("<span size=\"medium\"weight=\"bold\">%s</span>", data->song->artist);
-			}
-			if (data->song->album != NULL)
-			{
-				album = g_markup_printf_escaped ("<span size=\"medium\"weight=\"bold\">%s</span>", data->song->album);
-			}
-			gimmix_get_total_time_for_song (mo, data->song, time);
-			ti = g_markup_printf_escaped ("<span size=\"medium\" weight=\"bold\">%s</span>", time);
-		}
-		else
-		{	
-			if (data->song->title != NULL)
-			{
-				/*if (data->song->artist)
-				title = g_markup_printf_escaped ("%s - %s", data->song->artist, data->song->title);
-				else*/
-				title = g_markup_printf_escaped ("%s", data->song->title);
-			}
-			else
-			{
-				title = g_markup_printf_escaped ("%s", g_path_get_basename(data->song->file));
-				gimmix_strip_file_ext (title);
-			}
-			if (data->song->artist)
-			{
-				artist = g_markup_printf_escaped ("%s", data->song->artist);
-			}
-			if (data->song->album)
-			{
-				album = g_markup_printf_escaped ("%s", data->song->album);
-			}
-			gimmix_get_total_time_for_song (mo, data->song, time);
-			ti = NULL;
-		}
-		
-		gtk_list_store_append (current_playlist_store, &current_playlist_iter);
-		gtk_list_store_set (current_playlist_store, 
-							&current_playlist_iter,
-							0, title,
-							5, (ti!=NULL) ? ti : time,
-							1, data->song->file,
-							2, data->song->id,
-							3, artist,
-							4, album,
-							-1);
-		data = mpd_data_get_next (data);
-		if (ti)
-		g_free (ti);
-		g_free (title);
-		g_free (album);
-		g_free (artist);
-	}
-	gtk_tree_view_set_model (GTK_TREE_VIEW (current_playlist_treeview), GTK_TREE_MODEL(current_playlist_store));
-	gimmix_display_total_playlist_time (mo);
-	/*
-	if (pdata)
-	{
-		mpd_data_free (pdata);
+	else
+	{	
+		ti = NULL;
 	}
-	*/
+
+	/* the same artists and albums come up on many rows, the store only
+	 * keeps references to one copy of each */
+	artist = gimmix_intern (song->artist);
+	album = gimmix_intern (song->album);
+	gtk_list_store_set (store, 
+						iter,
+						0, title,
+						5, (ti!=NULL) ? ti : time,
+						1, song->file,
+						2, song->id,
+						3, artist,
+						4, album,
+						6, (song->id == current_song_id) ? PANGO_WEIGHT_BOLD : PANGO_WEIGHT_NORMAL,
+						-1);
+	gimmix_intern_unref (album);
+	gimmix_intern_unref (artist);
+
 	return;
 }
 
+/* a page of a paged queue has arrived */
 static void
-gimmix_display_total_playlist_time (MpdObj *mo)
+gimmix_current_playlist_fill (guint first, GPtrArray *songs, G_GNUC_UNUSED gpointer data)
 {
-	gchar		*time_string;
-	gint		time = 0;
-	guint		len = 0;
-	MpdData		*data;
-	
-	len = mpd_playlist_get_playlist_length (mo);
-	data = mpd_playlist_get_changes (mo, 0);
-	if (!len)
-	{
-		gtk_widget_hide (gimmix_statusbox);
+	GtkTreeModel	*model;
+	GtkTreeIter	iter;
+	gint		current_song_id;
+	guint		i;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
+	if (!gtk_tree_model_iter_nth_child (model, &iter, NULL, first))
 		return;
-	}
-	
-	while (data != NULL)
-	{
-		if (data->song)
-			time += data->song->time;
-		data = mpd_data_get_next (data);
-	}
-	
-	if (time > 0)
-	{
-		time_string = g_strdup_printf ("%d %s, %s%d %s", len, _("Items"), _("Total Duration: "), time/60, _("minutes"));
-		//g_print ("%s\n",time_string);
-		gtk_label_set_text (GTK_LABEL(gimmix_statusbar), time_string);
-		gtk_widget_show (gimmix_statusbox);
-		g_free (time_string);
-	}
-	/*
-	else
+
+	current_song_id = mpd_player_get_current_song_id (gmo);
+	for (i = 0; i < songs->len; i++)
 	{
-		g_print ("called totla\n");
-		gtk_widget_hide (gimmix_statusbox);
+		gimmix_current_playlist_set_row (gmo, GTK_LIST_STORE(model), &iter, g_ptr_array_index (songs, i), current_song_id);
+		if (!gtk_tree_model_iter_next (model, &iter))
+			break;
 	}
-	*/
+	gimmix_arena_reset (gimmix_playlist_row_arena ());
+
 	return;
 }
 
+/* a page of a paged queue was dropped from the cache, free its rows */
 static void
-gimmix_library_and_playlists_populate (void)
+gimmix_current_playlist_evict (guint first, guint n, G_GNUC_UNUSED gpointer data)
 {
-	GtkTreeModel 		*dir_model;
-	GtkTreeModel		*pls_model;
-	GtkTreeIter  		dir_iter;
-	GtkTreeIter			pls_iter;
-	GtkCellRenderer 	*dir_renderer;
-	GtkCellRenderer		*pls_renderer;
-	GtkListStore 		*dir_store;
-	GtkListStore		*pls_store;
-	MpdData 			*data = NULL;
-	GdkPixbuf 			*dir_pixbuf;
-	GdkPixbuf			*song_pixbuf;
-	GdkPixbuf			*pls_pixbuf;
-	gchar				*path;
+	GtkTreeModel	*model;
+	GtkTreeIter	iter;
+	guint		i;
 
-	library_selection = gtk_tree_view_get_selection (GTK_TREE_VIEW(library_treeview));
-	gtk_tree_selection_set_mode (library_selection, GTK_SELECTION_MULTIPLE);
-	dir_renderer = gtk_cell_renderer_pixbuf_new();
-	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (library_treeview),
-							-1,
-							"Icon",
-							dir_renderer,
-							"pixbuf", 0,
-							NULL);
-	
-	dir_renderer 		= gtk_cell_renderer_text_new ();
-	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (library_treeview),
-							-1,
-							"Albums",
-							dir_renderer,
-							"text", 1,
-							NULL);
-	
-	pls_renderer 		= gtk_cell_renderer_pixbuf_new ();
-	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (playlists_treeview), 
-							-1,
-							"PlsIcon",
-							pls_renderer,
-							"pixbuf", 0,
-							NULL);
-							
-	pls_renderer 		= gtk_cell_renderer_text_new ();
-	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (playlists_treeview), 
-							-1,
-							"Playlists",
-							pls_renderer,
-							"text", 1,
-							NULL);
-	
-	dir_store 	= gtk_list_store_new (5, 
-						GDK_TYPE_PIXBUF, 	/* icon (0) */
-						G_TYPE_STRING, 		/* name (1) */
-						G_TYPE_STRING,		/* path (2) */
-						G_TYPE_INT,			/* type GIMMIX_FILE_DIR/GIMMIX_FILE_SONG (3) */
-						G_TYPE_INT);		/* id (4) */
-	
-	pls_store 	= gtk_list_store_new (2, 
-						GDK_TYPE_PIXBUF, 	/* icon (0) */
-						G_TYPE_STRING);		/* name (1) */
-	
-	path = gimmix_get_full_image_path (GIMMIX_MEDIA_ICON);
-	song_pixbuf = gdk_pixbuf_new_from_file_at_size (path, 16, 16, NULL);
-	g_free (path);
-	dir_pixbuf	= gtk_widget_render_icon (GTK_WIDGET(library_treeview), GTK_STOCK_DIRECTORY, GTK_ICON_SIZE_BUTTON, NULL);
-	path = gimmix_get_full_image_path (GIMMIX_PLAYLIST_ICON);
-	pls_pixbuf	= gdk_pixbuf_new_from_file_at_size (path, 16, 16, NULL);
-	g_free (path);
-	
-	for (data = mpd_database_get_directory(gmo, NULL); data != NULL; data = mpd_data_get_next(data))
-	{	
-		if (data->type == MPD_DATA_TYPE_DIRECTORY)
-		{
-			gtk_list_store_append (dir_store, &dir_iter);
-			path = g_path_get_basename (data->directory);
-			gtk_list_store_set (dir_store, &dir_iter,
-						0, dir_pixbuf,
-						1, path,
-						2, data->directory,
-						3, GIMMIX_FILE_DIR,
-						-1);
-			g_free (path);
-		}
-		else if (data->type == MPD_DATA_TYPE_SONG)
-		{
-			gchar *title;
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
+	if (!gtk_tree_model_iter_nth_child (model, &iter, NULL, first))
+		return;
 
-			gtk_list_store_append (dir_store, &dir_iter);
-			if (data->song->title)
-			{
-				if (data->song->artist)
-					title = g_strdup_printf ("%s - %s", data->song->artist, data->song->title);
-				else
-					title = g_strdup (data->song->title);
-			}
-			else
-			{
-				title = g_path_get_basename (data->song->file);
-				gimmix_strip_file_ext (title);
-			}
-			gtk_list_store_set (dir_store,
-						&dir_iter,
-						0, song_pixbuf,
-						1, title,
-						2, data->song->file,
-						3, GIMMIX_FILE_SONG,
-						-1);
-			g_free (title);
-		}
-		else if (data->type == MPD_DATA_TYPE_PLAYLIST)
-		{
-			gchar *name = NULL;
-			name = ((mpd_PlaylistFile*)data->playlist)->path;
-			//g_print ("ADDING %s\n", name);
-			gtk_list_store_append (pls_store, &pls_iter);
-			gtk_list_store_set (pls_store,
-						&pls_iter,
-						0, pls_pixbuf,
-						1, name,
-						-1);
-		}
+	for (i = 0; i < n; i++)
+	{
+		gtk_list_store_set (GTK_LIST_STORE(model), &iter, 0, NULL, 1, NULL, 2, -1, 3, NULL, 4, NULL, 5, NULL, 6, PANGO_WEIGHT_NORMAL, -1);
+		if (!gtk_tree_model_iter_next (model, &iter))
+			break;
 	}
 
-	mpd_data_free (data);
-
-	dir_model	= GTK_TREE_MODEL (dir_store);
-	gtk_tree_view_set_model (GTK_TREE_VIEW (library_treeview), dir_model);
-	
-	pls_model 	= GTK_TREE_MODEL (pls_store);
-	gtk_tree_view_set_model (GTK_TREE_VIEW (playlists_treeview), pls_model);
-	
-	g_signal_connect (library_treeview, "row-activated", G_CALLBACK(cb_library_dir_activated), NULL);
-	g_signal_connect (playlists_treeview, "row-activated", G_CALLBACK(cb_playlist_activated), NULL);
-	g_signal_connect (library_treeview, "button-press-event", G_CALLBACK(cb_all_playlist_button_press), GINT_TO_POINTER (FALSE));
-	g_signal_connect (library_treeview, "button-release-event", G_CALLBACK(cb_library_right_click), NULL);
-	g_signal_connect (library_window, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
-
-	g_object_unref (dir_model);
-	g_object_unref (pls_model);
-	
-	g_object_unref (dir_pixbuf);
-	g_object_unref (song_pixbuf);
-	g_object_unref (pls_pixbuf);
-	
 	return;
 }
 
-static void
-gimmix_library_search (gint type, gchar *text)
+/* request the rows that are on screen in paged mode */
+static gboolean
+gimmix_current_playlist_load_visible (G_GNUC_UNUSED gpointer data)
 {
-	if (!text)
-		return;
+	GtkTreePath	*start;
+	GtkTreePath	*end;
 
-	MpdData 		*data;
-	GtkTreeModel	*directory_model;
-	GtkListStore	*dir_store;
-	GdkPixbuf 		*song_pixbuf;
-	GtkTreeIter 	dir_iter;
-	gchar 			*path;
+	playlist_visible_source = 0;
+	if (!playlist_paged)
+		return FALSE;
 
-	switch (type)
+	if (gtk_tree_view_get_visible_range (GTK_TREE_VIEW(current_playlist_treeview), &start, &end))
 	{
-		/* Search by Artist */
-		case 0: data = mpd_database_find (gmo, MPD_TABLE_ARTIST, text, FALSE);
-				break;
-		
-		/* Search by Album */
-		case 1: data = mpd_database_find (gmo, MPD_TABLE_ALBUM, text, FALSE);
-				break;
-		
-		/* Search by Title */
-		case 2: data = mpd_database_find (gmo, MPD_TABLE_TITLE, text, FALSE);
-				break;
-		
-		/* Search by File name */
-		case 3: data = mpd_database_find (gmo, MPD_TABLE_FILENAME, text, FALSE);
-				break;
-				
-		default: return;
+		gimmix_queue_request (gtk_tree_path_get_indices (start)[0], gtk_tree_path_get_indices (end)[0]);
+		gtk_tree_path_free (start);
+		gtk_tree_path_free (end);
 	}
-	
-	directory_model = gtk_tree_view_get_model (GTK_TREE_VIEW (library_treeview));
-	dir_store 	= GTK_LIST_STORE (directory_model);
-
-	/* Clear the stores */
-	gtk_list_store_clear (dir_store);
-	
-	if (!data)
-	{
-		GdkPixbuf *icon	= gtk_widget_render_icon (GTK_WIDGET(library_treeview), "gtk-dialog-error",
-						GTK_ICON_SIZE_MENU,
-						NULL);
-		gtk_list_store_append (dir_store, &dir_iter);
-		gtk_list_store_set (dir_store, &dir_iter,
-								0, icon,
-								1, _("No Result"),
-								2, NULL,
-								3, 0,
-								-1);
-		directory_model = GTK_TREE_MODEL (dir_store);
-		gtk_tree_view_set_model (GTK_TREE_VIEW(library_treeview), directory_model);
-		g_object_unref (icon);
-		return;
+	else
+	{
+		/* not drawn yet, start at the top */
+		gimmix_queue_request (0, 0);
 	}
 
-	path = gimmix_get_full_image_path (GIMMIX_MEDIA_ICON);
-	song_pixbuf = gdk_pixbuf_new_from_file_at_size (path, 12, 12, NULL);
-	g_free (path);
+	return FALSE;
+}
 
-	for (; data!=NULL; data = mpd_data_get_next (data))
-	{
-		if (data->type == MPD_DATA_TYPE_SONG)
-		{
-			gchar *title;
-			
-			title = (data->song->title!=NULL) ? g_strdup (data->song->title) : g_path_get_basename(data->song->file);
-			gtk_list_store_append (dir_store, &dir_iter);
-			gtk_list_store_set (dir_store, &dir_iter,
-								0, song_pixbuf,
-								1, title,
-								2, data->song->file,
-								3, GIMMIX_FILE_SONG,
-								-1);
-			g_free (title);
-		}
-	}
-	
-	mpd_data_free (data);
+static void
+cb_current_playlist_scrolled (G_GNUC_UNUSED GtkAdjustment *adj, G_GNUC_UNUSED gpointer data)
+{
+	/* one lookup per main loop iteration, however fast the user scrolls */
+	if (playlist_paged && playlist_visible_source == 0)
+		playlist_visible_source = g_idle_add (gimmix_current_playlist_load_visible, NULL);
 
-	directory_model = GTK_TREE_MODEL (dir_store);
-	gtk_tree_view_set_model (GTK_TREE_VIEW(library_treeview), directory_model);
-	g_object_unref (song_pixbuf);
-	
 	return;
 }
 
+/* put the rows of the queue view in the order of the sort column */
 static void
-cb_search_keypress (G_GNUC_UNUSED GtkWidget   *widget,
-		    G_GNUC_UNUSED GdkEventKey *event,
-		    G_GNUC_UNUSED gpointer     data)
+gimmix_current_playlist_sort_view (void)
 {
-	gint		index;
-	gchar		text[20];
-	
-	strcpy (text, gtk_entry_get_text (GTK_ENTRY(search_entry)));
-	if ( (strlen (text)) <= 1 )
+	GtkTreeModel	*model;
+	GtkTreeIter	iter;
+	GArray		*ids;
+	gint		*order;
+	gboolean	valid;
+	gint		id;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
+	ids = g_array_sized_new (FALSE, FALSE, sizeof (gint), gtk_tree_model_iter_n_children (model, NULL));
+	for (valid = gtk_tree_model_get_iter_first (model, &iter); valid; valid = gtk_tree_model_iter_next (model, &iter))
 	{
-		gimmix_update_library_with_dir ("/");
-		return;
+		gtk_tree_model_get (model, &iter, 2, &id, -1);
+		g_array_append_val (ids, id);
 	}
-	index = gtk_combo_box_get_active (GTK_COMBO_BOX(search_combo));
-	gimmix_library_search (index, text);
-	
+	if (ids->len > 1)
+	{
+		order = gimmix_sort_cache_order (playlist_sort, (gint*)ids->data, ids->len,
+						playlist_sort_column, playlist_sort_descending);
+		gtk_list_store_reorder (GTK_LIST_STORE(model), order);
+		g_free (order);
+	}
+	g_array_free (ids, TRUE);
+
 	return;
 }
 
+/* remember the sort column and show it in the header, column is NULL
+ * when the view goes back to server order */
 static void
-cb_current_playlist_delete_press (G_GNUC_UNUSED GtkWidget *widget,
-				  GdkEventKey		  *event,
-				  G_GNUC_UNUSED gpointer   data)
+gimmix_current_playlist_set_sort (GtkTreeViewColumn *column, GimmixSortColumn sort, gboolean descending)
 {
-	if (event->keyval != GDK_KEY_Delete)
-		return;
-	
-	gimmix_current_playlist_remove_song ();
-	
+	GList	*columns;
+	GList	*node;
+
+	columns = gtk_tree_view_get_columns (GTK_TREE_VIEW(current_playlist_treeview));
+	for (node = columns; node != NULL; node = node->next)
+		gtk_tree_view_column_set_sort_indicator (node->data, node->data == column);
+	g_list_free (columns);
+	if (column != NULL)
+		gtk_tree_view_column_set_sort_order (column, descending ? GTK_SORT_DESCENDING : GTK_SORT_ASCENDING);
+	playlist_sort_column = sort;
+	playlist_sort_descending = descending;
+
 	return;
 }
 
+/* A paged queue is never loaded whole, so it can't be sorted in the
+ * view. The headers stop being buttons while the queue is paged. */
 static void
-cb_current_playlist_double_click (GtkTreeView *treeview)
+gimmix_current_playlist_set_paged (gboolean paged)
 {
-	GtkTreeModel 			*model;
-	GList				*list;
-	GtkTreeIter			iter;
-	gint 				id;
+	GList	*columns;
+	GList	*node;
+
+	playlist_paged = paged;
+	if (paged)
+		gimmix_current_playlist_set_sort (NULL, GIMMIX_SORT_NONE, FALSE);
+	columns = gtk_tree_view_get_columns (GTK_TREE_VIEW(current_playlist_treeview));
+	for (node = columns; node != NULL; node = node->next)
+		gtk_tree_view_column_set_clickable (node->data, !paged);
+	g_list_free (columns);
 
-	model = gtk_tree_view_get_model (GTK_TREE_VIEW (treeview));
-	list = gtk_tree_selection_get_selected_rows (current_playlist_selection, &model);
-	gtk_tree_model_get_iter (model, &iter, list->data);
-	gtk_tree_model_get (model, &iter, 2, &id, -1);
-	mpd_player_play_id (gmo, id);
-	mpd_status_update (gmo);
-	
-	/* free the list */
-	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
-	g_list_free (list);
-	
 	return;
 }
 
-/* This keeps multiple items selected in case of a right click */
-static bool
+/* the queue length from which on the queue is paged, 0 never pages */
+static gint
+gimmix_current_playlist_paged_min (void)
+{
+	const char	*value;
+
+	value = cfg_get_key_value (conf, "playlist_paged_min");
+	if (value == NULL || *value == '\0')
+		return PLAYLIST_PAGED_MIN;
+
+	return atoi (value);
+}
+
+/* a header click sorts ascending, then descending, then back to the
+ * order of the server queue */
+static void
+cb_current_playlist_column_clicked (GtkTreeViewColumn *column, gpointer data)
+{
+	GimmixSortColumn	sort = GPOINTER_TO_INT (data);
+
+	if (playlist_paged)
+		return;
+
+	if (sort != playlist_sort_column)
+		gimmix_current_playlist_set_sort (column, sort, FALSE);
+	else if (!playlist_sort_descending)
+		gimmix_current_playlist_set_sort (column, sort, TRUE);
+	else
+		gimmix_current_playlist_set_sort (NULL, GIMMIX_SORT_NONE, FALSE);
+	gimmix_current_playlist_sort_view ();
+
+	return;
+}
+
+static void
+gimmix_playlist_reorder_free (PlaylistReorder *reorder)
+{
+	g_free (reorder->queue);
+	g_free (reorder);
+
+	return;
+}
+
+/* put the rows back into the order the server has after a failed
+ * reorder, from the old order and the positions that changed */
+static void
+cb_current_playlist_resynced (const GimmixMpdReply *reply, gpointer data)
+{
+	PlaylistReorder	*reorder = data;
+	GtkTreeModel	*model;
+	GtkTreeIter	iter;
+	GHashTable	*rows;
+	gboolean	*used;
+	gint		*order;
+	gboolean	complete;
+	gboolean	valid;
+	gint		pos = -1;
+	gint		id;
+	guint		i;
+
+	/* a full fetch is on its way, it knows better */
+	if (reorder->serial != playlist_fetch_serial || playlist_paged)
+	{
+		gimmix_playlist_reorder_free (reorder);
+		return;
+	}
+	if (!reply->ok)
+	{
+		fprintf (stderr, "plchangesposid: %s\n", reply->error);
+		gimmix_playlist_reorder_free (reorder);
+		gimmix_update_current_playlist (gmo);
+		return;
+	}
+
+	/* "cpos: <pos>" followed by "Id: <id>" for every moved song */
+	for (i = 0; reply->lines[i] != NULL; i++)
+	{
+		if (!strncmp (reply->lines[i], "cpos: ", 6))
+			pos = atoi (reply->lines[i] + 6);
+		else if (!strncmp (reply->lines[i], "Id: ", 4) && pos >= 0)
+		{
+			if ((guint)pos >= reorder->len)
+				break;
+			reorder->queue[pos] = atoi (reply->lines[i] + 4);
+			pos = -1;
+		}
+	}
+	complete = (reply->lines[i] == NULL);
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
+	rows = g_hash_table_new (g_direct_hash, g_direct_equal);
+	i = 0;
+	for (valid = gtk_tree_model_get_iter_first (model, &iter); valid; valid = gtk_tree_model_iter_next (model, &iter))
+	{
+		gtk_tree_model_get (model, &iter, 2, &id, -1);
+		g_hash_table_insert (rows, GINT_TO_POINTER(id), GUINT_TO_POINTER(i++));
+	}
+
+	/* anything that doesn't add up means someone else changed the
+	 * queue as well, fetch it whole then */
+	order = g_new (gint, reorder->len);
+	used = g_new0 (gboolean, reorder->len);
+	valid = (complete && i == reorder->len);
+	for (i = 0; valid && i < reorder->len; i++)
+	{
+		gpointer row;
+
+		valid = g_hash_table_lookup_extended (rows, GINT_TO_POINTER(reorder->queue[i]), NULL, &row) &&
+			!used[GPOINTER_TO_UINT (row)];
+		if (valid)
+		{
+			order[i] = GPOINTER_TO_UINT (row);
+			used[order[i]] = TRUE;
+		}
+	}
+	if (valid)
+		gtk_list_store_reorder (GTK_LIST_STORE(model), order);
+	else
+		gimmix_update_current_playlist (gmo);
+
+	g_free (order);
+	g_free (used);
+	g_hash_table_destroy (rows);
+	gimmix_playlist_reorder_free (reorder);
+
+	return;
+}
+
+static void
+cb_current_playlist_reordered (gboolean ok, const char *error, gpointer data)
+{
+	PlaylistReorder *reorder = data;
+
+	if (ok)
+	{
+		gimmix_playlist_reorder_free (reorder);
+		return;
+	}
+
+	/* the batch stopped at the failed move, the view shows an order
+	 * the server doesn't have. Ask which songs did move */
+	fprintf (stderr, "reorder: %s\n", error);
+	reorder->serial = playlist_fetch_serial;
+	gimmix_mpdio_command (cb_current_playlist_resynced, reorder, "plchangesposid %lld", reorder->version);
+
+	return;
+}
+
+/* move the songs of the server queue into the order of the view, only
+ * the songs that are out of place are moved and the playing one stays
+ * where it is if possible */
+static void
+gimmix_current_playlist_apply_order (void)
+{
+	GtkTreeModel	*model;
+	GtkTreeIter	iter;
+	GimmixBatch	*batch;
+	GArray		*view;
+	gint		*order;
+	gint		*queue;
+	gboolean	valid;
+	gint		id;
+	guint		i;
+
+	if (playlist_paged || playlist_sort_column == GIMMIX_SORT_NONE)
+		return;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
+	view = g_array_sized_new (FALSE, FALSE, sizeof (gint), gtk_tree_model_iter_n_children (model, NULL));
+	for (valid = gtk_tree_model_get_iter_first (model, &iter); valid; valid = gtk_tree_model_iter_next (model, &iter))
+	{
+		gtk_tree_model_get (model, &iter, 2, &id, -1);
+		g_array_append_val (view, id);
+	}
+
+	/* the server order is the view sorted by queue position */
+	order = gimmix_sort_cache_order (playlist_sort, (gint*)view->data, view->len, GIMMIX_SORT_NONE, FALSE);
+	queue = g_new (gint, view->len);
+	for (i = 0; i < view->len; i++)
+		queue[i] = g_array_index (view, gint, order[i]);
+
+	batch = gimmix_batch_new ();
+	if (gimmix_reorder_batch (batch, queue, (gint*)view->data, view->len, mpd_player_get_current_song_id (gmo)) >= 0)
+	{
+		PlaylistReorder *reorder;
+
+		/* the view already shows the new queue order */
+		gimmix_current_playlist_set_sort (NULL, GIMMIX_SORT_NONE, FALSE);
+		reorder = g_new0 (PlaylistReorder, 1);
+		reorder->queue = queue;
+		reorder->len = view->len;
+		reorder->version = mpd_playlist_get_playlist_id (gmo);
+		gimmix_batch_commit (batch, cb_current_playlist_reordered, reorder);
+	}
+	else
+	{
+		gimmix_batch_free (batch);
+		g_free (queue);
+	}
+
+	g_free (order);
+	g_array_free (view, TRUE);
+
+	return;
+}
+
+/* show a paged queue of length placeholder rows, nothing loaded yet */
+static void
+gimmix_current_playlist_paged_build (guint length)
+{
+	GtkTreeModel	*model;
+	GtkListStore	*store;
+	guint		i;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
+	store = GTK_LIST_STORE (model);
+
+	/* the rows of a paged queue are its positions, it is always
+	 * shown in server order */
+	gimmix_current_playlist_set_sort (NULL, GIMMIX_SORT_NONE, FALSE);
+
+	/* detached from the view the rows go in a lot faster */
+	g_object_ref (model);
+	gtk_tree_view_set_model (GTK_TREE_VIEW(current_playlist_treeview), NULL);
+	gtk_list_store_clear (store);
+	for (i = 0; i < length; i++)
+		gtk_list_store_insert_with_values (store, NULL, i, 2, -1, 6, PANGO_WEIGHT_NORMAL, -1);
+	gtk_tree_view_set_model (GTK_TREE_VIEW(current_playlist_treeview), model);
+	g_object_unref (model);
+	gimmix_queue_reset (length);
+
+	return;
+}
+
+/* the bold row follows the playing song */
+static void
+gimmix_current_playlist_paged_current (gint current_pos)
+{
+	if (current_pos != paged_current_pos)
+	{
+		if (paged_current_pos >= 0)
+			gimmix_queue_invalidate (paged_current_pos);
+		if (current_pos >= 0)
+			gimmix_queue_invalidate (current_pos);
+	}
+	paged_current_pos = current_pos;
+
+	return;
+}
+
+/* the positions that hold other songs since the version shown */
+static void
+cb_current_playlist_paged_changes (const GimmixMpdReply *reply, gpointer data)
+{
+	PagedSync	*sync = data;
+	GtkTreeModel	*model;
+	GtkTreeIter	iter;
+	GArray		*changed;
+	gboolean	valid;
+	guint		rows;
+	guint		i;
+
+	if (sync->serial != paged_sync_serial || !playlist_paged)
+	{
+		g_free (sync);
+		return;
+	}
+
+	/* "cpos: <pos>" and "Id: <id>" for every changed position */
+	changed = g_array_new (FALSE, FALSE, sizeof (guint));
+	for (i = 0; reply->ok && reply->lines[i] != NULL; i++)
+	{
+		if (!strncmp (reply->lines[i], "cpos: ", 6))
+		{
+			guint pos = atoi (reply->lines[i] + 6);
+			g_array_append_val (changed, pos);
+			if (pos >= sync->length)
+				break;
+		}
+	}
+
+	/* the queue has moved on since the length was taken, or most of it
+	 * changed anyway */
+	if (!reply->ok || reply->lines[i] != NULL ||
+		changed->len > sync->length / PAGED_REBUILD_DIVISOR)
+	{
+		if (!reply->ok)
+			fprintf (stderr, "plchangesposid: %s\n", reply->error);
+		gimmix_current_playlist_paged_build (sync->length);
+		paged_current_pos = -1;
+	}
+	else
+	{
+		model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
+		rows = gtk_tree_model_iter_n_children (model, NULL);
+		for (i = rows; i < sync->length; i++)
+			gtk_list_store_insert_with_values (GTK_LIST_STORE(model), NULL, i, 2, -1, 6, PANGO_WEIGHT_NORMAL, -1);
+		valid = (rows > sync->length) && gtk_tree_model_iter_nth_child (model, &iter, NULL, sync->length);
+		while (valid)
+			valid = gtk_list_store_remove (GTK_LIST_STORE(model), &iter);
+		gimmix_queue_update (sync->length, changed);
+	}
+	g_array_free (changed, TRUE);
+	paged_version = sync->version;
+	g_free (sync);
+
+	gimmix_current_playlist_paged_current (mpd_player_get_current_song_pos (gmo));
+	gimmix_current_playlist_load_visible (NULL);
+
+	return;
+}
+
+/* Queues with more than playlist_paged_min songs are shown as empty
+ * rows that are filled in page by page while they are scrolled into view.
+ * A new version of the queue only touches the rows that changed. */
+static void
+gimmix_update_current_playlist_paged (MpdObj *mo, guint length)
+{
+	long long	version;
+
+	version = mpd_playlist_get_playlist_id (mo);
+
+	if (!playlist_paged)
+	{
+		paged_sync_serial++;
+		gimmix_current_playlist_paged_build (length);
+		gimmix_current_playlist_set_paged (TRUE);
+		paged_version = version;
+		paged_current_pos = -1;
+	}
+	else if (version != paged_version)
+	{
+		PagedSync *sync;
+
+		/* the rows are adjusted when the changes have arrived */
+		sync = g_new (PagedSync, 1);
+		sync->serial = ++paged_sync_serial;
+		sync->version = version;
+		sync->length = length;
+		gimmix_mpdio_command (cb_current_playlist_paged_changes, sync, "plchangesposid %lld", paged_version);
+		gimmix_display_total_playlist_time (mo);
+		return;
+	}
+	gimmix_current_playlist_paged_current (mpd_player_get_current_song_pos (mo));
+
+	gimmix_current_playlist_load_visible (NULL);
+	gimmix_display_total_playlist_time (mo);
+
+	return;
+}
+
+/* the whole queue has arrived */
+static void
+cb_current_playlist_listed (const GimmixMpdReply *reply, gpointer data)
+{
+	GtkListStore	*current_playlist_store;
+	GtkTreeIter	current_playlist_iter;
+	gint		current_song_id;
+	GPtrArray	*songs;
+	guint		i;
+
+	/* the queue changed again or became paged in the meantime */
+	if (GPOINTER_TO_UINT (data) != playlist_fetch_serial)
+		return;
+	if (!reply->ok)
+	{
+		fprintf (stderr, "playlistinfo: %s\n", reply->error);
+		return;
+	}
+
+	songs = gimmix_queue_parse (reply);
+	current_song_id = mpd_player_get_current_song_id (gmo);
+	current_playlist_store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview)));
+	gtk_list_store_clear (current_playlist_store);
+	playlist_total_time = 0;
+	gimmix_sort_cache_begin (playlist_sort);
+	
+	for (i = 0; i < songs->len; i++)
+	{
+		mpd_Song *song = g_ptr_array_index (songs, i);
+
+		gtk_list_store_append (current_playlist_store, &current_playlist_iter);
+		gimmix_current_playlist_set_row (gmo, current_playlist_store, &current_playlist_iter, song, current_song_id);
+		gimmix_sort_cache_set (playlist_sort, song->id, song->pos, song->file,
+					song->title, song->artist, song->album, song->time);
+		if (song->time > 0)
+			playlist_total_time += song->time;
+	}
+	gimmix_arena_reset (gimmix_playlist_row_arena ());
+	gimmix_sort_cache_end (playlist_sort);
+	g_ptr_array_free (songs, TRUE);
+	if (playlist_sort_column != GIMMIX_SORT_NONE)
+		gimmix_current_playlist_sort_view ();
+	gimmix_display_total_playlist_time (gmo);
+
+	return;
+}
+
+void
+gimmix_update_current_playlist (MpdObj *mo)
+{
+	gint		length;
+	gint		paged_min;
+
+	if (!mpd_check_connected(mo))
+		return;
+
+	/* whatever is still on its way is out of date now */
+	playlist_fetch_serial++;
+
+	length = mpd_playlist_get_playlist_length (mo);
+	paged_min = gimmix_current_playlist_paged_min ();
+	if (paged_min > 0 && length >= paged_min)
+	{
+		gimmix_update_current_playlist_paged (mo, length);
+		return;
+	}
+	if (playlist_paged)
+	{
+		gimmix_current_playlist_set_paged (FALSE);
+		gimmix_queue_reset (0);
+	}
+
+	gimmix_mpdio_command (cb_current_playlist_listed, GUINT_TO_POINTER (playlist_fetch_serial), "playlistinfo");
+
+	return;
+}
+
+static void
+gimmix_display_total_playlist_time (MpdObj *mo)
+{
+	gchar		*time_string;
+	gint		len = 0;
+	
+	len = mpd_playlist_get_playlist_length (mo ? mo : gmo);
+	if (len <= 0)
+	{
+		gtk_widget_hide (gimmix_statusbox);
+		return;
+	}
+	
+	/* the duration of a paged queue is unknown, it was never fetched whole */
+	if (playlist_paged)
+	{
+		time_string = g_strdup_printf ("%d %s, %s", len, _("Items"), _("too long to sort"));
+		gtk_label_set_text (GTK_LABEL(gimmix_statusbar), time_string);
+		gtk_widget_show (gimmix_statusbox);
+		g_free (time_string);
+	}
+	else if (playlist_total_time > 0)
+	{
+		time_string = g_strdup_printf ("%d %s, %s%d %s", len, _("Items"), _("Total Duration: "), playlist_total_time/60, _("minutes"));
+		//g_print ("%s\n",time_string);
+		gtk_label_set_text (GTK_LABEL(gimmix_statusbar), time_string);
+		gtk_widget_show (gimmix_statusbox);
+		g_free (time_string);
+	}
+	/*
+	else
+	{
+		g_print ("called totla\n");
+		gtk_widget_hide (gimmix_statusbox);
+	}
+	*/
+	return;
+}
+
+static void
+gimmix_library_and_playlists_populate (void)
+{
+	GtkTreeModel 		*dir_model;
+	GtkTreeModel		*pls_model;
+	GtkCellRenderer 	*dir_renderer;
+	GtkCellRenderer		*pls_renderer;
+	GtkTreeStore 		*dir_store;
+	GtkListStore		*pls_store;
+
+	library_selection = gtk_tree_view_get_selection (GTK_TREE_VIEW(library_treeview));
+	gtk_tree_selection_set_mode (library_selection, GTK_SELECTION_MULTIPLE);
+	dir_renderer = gtk_cell_renderer_pixbuf_new();
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (library_treeview),
+							-1,
+							"Icon",
+							dir_renderer,
+							"pixbuf", 0,
+							NULL);
+	
+	dir_renderer 		= gtk_cell_renderer_text_new ();
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (library_treeview),
+							-1,
+							"Albums",
+							dir_renderer,
+							"text", 1,
+							NULL);
+	
+	pls_renderer 		= gtk_cell_renderer_pixbuf_new ();
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (playlists_treeview), 
+							-1,
+							"PlsIcon",
+							pls_renderer,
+							"pixbuf", 0,
+							NULL);
+							
+	pls_renderer 		= gtk_cell_renderer_text_new ();
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (playlists_treeview), 
+							-1,
+							"Playlists",
+							pls_renderer,
+							"text", 1,
+							NULL);
+	
+	dir_store 	= gtk_tree_store_new (5, 
+						GDK_TYPE_PIXBUF, 	/* icon (0) */
+						G_TYPE_STRING, 		/* name (1) */
+						G_TYPE_STRING,		/* path (2) */
+						G_TYPE_INT,			/* type GIMMIX_FILE_DIR/GIMMIX_FILE_SONG (3) */
+						G_TYPE_INT);		/* id (4) */
+	
+	pls_store 	= gtk_list_store_new (2, 
+						GDK_TYPE_PIXBUF, 	/* icon (0) */
+						G_TYPE_STRING);		/* name (1) */
+	
+	dir_model	= GTK_TREE_MODEL (dir_store);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (library_treeview), dir_model);
+	
+	pls_model 	= GTK_TREE_MODEL (pls_store);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (playlists_treeview), pls_model);
+	
+	g_signal_connect (library_treeview, "row-activated", G_CALLBACK(cb_library_dir_activated), NULL);
+	g_signal_connect (playlists_treeview, "row-activated", G_CALLBACK(cb_playlist_activated), NULL);
+	g_signal_connect (library_treeview, "button-press-event", G_CALLBACK(cb_all_playlist_button_press), GINT_TO_POINTER (FALSE));
+	g_signal_connect (library_treeview, "button-release-event", G_CALLBACK(cb_library_right_click), NULL);
+	g_signal_connect (library_treeview, "test-expand-row", G_CALLBACK(cb_library_row_expand), NULL);
+	g_signal_connect (library_window, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+
+	g_object_unref (dir_model);
+	g_object_unref (pls_model);
+
+	gimmix_update_library_with_dir ("/");
+
+	/* stored playlists come separately */
+	gimmix_stored_playlists_refresh ();
+	
+	return;
+}
+
+/* show a message row instead of results */
+static void
+gimmix_library_show_message (const gchar *stock, const gchar *text)
+{
+	GtkTreeStore	*dir_store;
+	GtkTreeIter 	dir_iter;
+	GdkPixbuf	*icon;
+
+	dir_store = GTK_TREE_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (library_treeview)));
+	gtk_tree_store_clear (dir_store);
+	icon = gimmix_get_stock_pixbuf (library_treeview, stock, GTK_ICON_SIZE_MENU);
+	gtk_tree_store_append (dir_store, &dir_iter, NULL);
+	gtk_tree_store_set (dir_store, &dir_iter,
+							0, icon,
+							1, text,
+							2, NULL,
+							3, GIMMIX_FILE_NONE,
+							-1);
+	g_object_unref (icon);
+
+	return;
+}
+
+static void
+cb_library_searched (const GimmixMpdReply *reply, gpointer data)
+{
+	GtkTreeStore	*dir_store;
+	GdkPixbuf 	*song_pixbuf;
+	GtkTreeIter 	dir_iter;
+	GimmixArena	*arena;
+	GPtrArray	*songs;
+	guint		i;
+
+	/* typed on since, a newer search is on its way */
+	if (GPOINTER_TO_UINT (data) != library_view_serial)
+		return;
+
+	if (!reply->ok)
+	{
+		fprintf (stderr, "search: %s\n", reply->error);
+		gimmix_library_show_message (GTK_STOCK_DIALOG_ERROR, _("No Result"));
+		return;
+	}
+	songs = gimmix_queue_parse (reply);
+	if (songs->len == 0)
+	{
+		g_ptr_array_free (songs, TRUE);
+		gimmix_library_show_message (GTK_STOCK_DIALOG_ERROR, _("No Result"));
+		return;
+	}
+
+	dir_store = GTK_TREE_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (library_treeview)));
+	gtk_tree_store_clear (dir_store);
+	song_pixbuf = gimmix_get_pixbuf (GIMMIX_MEDIA_ICON, 12, 12);
+	arena = gimmix_playlist_row_arena ();
+	for (i = 0; i < songs->len; i++)
+	{
+		mpd_Song	*song = g_ptr_array_index (songs, i);
+		const gchar	*title;
+
+		title = (song->title!=NULL) ? song->title : gimmix_arena_song_name (arena, song->file);
+		gtk_tree_store_append (dir_store, &dir_iter, NULL);
+		gtk_tree_store_set (dir_store, &dir_iter,
+							0, song_pixbuf,
+							1, title,
+							2, song->file,
+							3, GIMMIX_FILE_SONG,
+							-1);
+	}
+	gimmix_arena_reset (arena);
+	g_ptr_array_free (songs, TRUE);
+	if (song_pixbuf != NULL)
+		g_object_unref (song_pixbuf);
+
+	return;
+}
+
+static void
+gimmix_library_search (gint type, gchar *text)
+{
+	/* artist, album, title and file name, as in the search combo */
+	static const gchar *tags[] = { "artist", "album", "title", "file" };
+	gchar *arg;
+
+	if (!text || type < 0 || type >= (gint)G_N_ELEMENTS (tags))
+		return;
+
+	arg = gimmix_mpd_quote (text);
+	gimmix_mpdio_command (cb_library_searched, GUINT_TO_POINTER (++library_view_serial),
+				"search %s %s", tags[type], arg);
+	g_free (arg);
+
+	return;
+}
+
+static void
+cb_search_keypress (G_GNUC_UNUSED GtkWidget   *widget,
+		    G_GNUC_UNUSED GdkEventKey *event,
+		    G_GNUC_UNUSED gpointer     data)
+{
+	gint		index;
+	gchar		text[20];
+	
+	strcpy (text, gtk_entry_get_text (GTK_ENTRY(search_entry)));
+	if ( (strlen (text)) <= 1 )
+	{
+		gimmix_update_library_with_dir ("/");
+		return;
+	}
+	index = gtk_combo_box_get_active (GTK_COMBO_BOX(search_combo));
+	gimmix_library_search (index, text);
+	
+	return;
+}
+
+static void
+cb_current_playlist_delete_press (G_GNUC_UNUSED GtkWidget *widget,
+				  GdkEventKey		  *event,
+				  G_GNUC_UNUSED gpointer   data)
+{
+	if (event->keyval != GDK_KEY_Delete)
+		return;
+	
+	gimmix_current_playlist_remove_song ();
+	
+	return;
+}
+
+static void
+cb_current_playlist_double_click (GtkTreeView *treeview)
+{
+	GtkTreeModel 			*model;
+	GList				*list;
+	GtkTreeIter			iter;
+	gint 				id;
+	GimmixBatch			*batch;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW (treeview));
+	list = gtk_tree_selection_get_selected_rows (current_playlist_selection, &model);
+	gtk_tree_model_get_iter (model, &iter, list->data);
+	gtk_tree_model_get (model, &iter, 2, &id, -1);
+	batch = gimmix_batch_new ();
+	/* rows of a paged queue that are not loaded yet have no id */
+	if (id >= 0)
+		gimmix_batch_play_id (batch, id);
+	else
+		gimmix_batch_play_pos (batch, gtk_tree_path_get_indices (list->data)[0]);
+	gimmix_batch_commit (batch, NULL, NULL);
+	
+	/* free the list */
+	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
+	g_list_free (list);
+	
+	return;
+}
+
+/* This keeps multiple items selected in case of a right click */
+static bool
 cb_all_playlist_button_press (GtkTreeView *treeview, GdkEventButton *event, gpointer data)
 {
 	GtkTreeSelection	*selection;
@@ -958,6 +1568,7 @@ cb_library_dir_activated (G_GNUC_UNUSED gpointer data)
 	gchar				*path;
 	GimmixFileType			type;
 	gboolean 			added;
+	GimmixBatch			*batch = NULL;
 
 	model = gtk_tree_view_get_model (GTK_TREE_VIEW (library_treeview));
 	list = gtk_tree_selection_get_selected_rows (library_selection, &model);
@@ -974,26 +1585,19 @@ cb_library_dir_activated (G_GNUC_UNUSED gpointer data)
 		}
 		else if (type == GIMMIX_FILE_SONG)
 		{
-			mpd_playlist_add (gmo, path);
+			batch = gimmix_batch_new ();
+			gimmix_batch_add (batch, path);
 			added = true;
 		}
 		
 		g_free (path);
 	}
 	
-	if (gimmix_config_get_bool("play_on_add") && (added == true))
+	if (added == true)
 	{
-		/* If we're adding, there might already be a song playing. */
-		int state;
-
-		state = mpd_player_get_state (gmo);
-
-		if (state == MPD_PLAYER_PAUSE || state == MPD_PLAYER_STOP)
-		{	
-			mpd_player_play (gmo);
-		}
+		gimmix_library_play_on_add (batch);
+		gimmix_batch_commit (batch, NULL, NULL);
 	}
-	mpd_status_update (gmo);
 		
 	/* free the list */
 	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
@@ -1002,319 +1606,490 @@ cb_library_dir_activated (G_GNUC_UNUSED gpointer data)
 	return;
 }
 
+/* queue all selected songs and directories of the library browser */
 static void
-cb_library_popup_add_clicked (G_GNUC_UNUSED GtkWidget *widget,
-			      G_GNUC_UNUSED gpointer   data)
+gimmix_library_selection_add (GimmixBatch *batch)
 {
 	GtkTreeModel 		*model;
 	GtkTreeIter 		iter;
 	GList			*list;
+	GList			*node;
 	gchar			*path;
 	GimmixFileType		type;
 
 	model = gtk_tree_view_get_model (GTK_TREE_VIEW (library_treeview));
 	list = gtk_tree_selection_get_selected_rows (library_selection, &model);
 	
-	if (gtk_tree_selection_count_selected_rows (library_selection) == 1)
+	for (node = list; node != NULL; node = g_list_next (node))
 	{
-		gtk_tree_model_get_iter (model, &iter, list->data);
+		gtk_tree_model_get_iter (model, &iter, node->data);
 		gtk_tree_model_get (model, &iter, 2, &path, 3, &type, -1);
 		
-		if (type == GIMMIX_FILE_DIR)
-		{
-			mpd_playlist_queue_add (gmo, path);
-		}
-		else if (type == GIMMIX_FILE_SONG)
-		{
-			mpd_playlist_add (gmo, path);
+		if (type == GIMMIX_FILE_DIR || type == GIMMIX_FILE_SONG)
+		{	
+			gimmix_batch_add (batch, path);
 		}
-		
 		g_free (path);
 	}
-	else
-	while (list != NULL)
+		
+	/* free the list */
+	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
+	g_list_free (list);
+	
+	return;
+}
+
+/* start playback after adding songs if the user wants it */
+static void
+gimmix_library_play_on_add (GimmixBatch *batch)
+{
+	int state;
+
+	if (!gimmix_config_get_bool("play_on_add"))
+		return;
+
+	/* If we're adding, there might already be a song playing. */
+	state = mpd_player_get_state (gmo);
+	if (state == MPD_PLAYER_PAUSE || state == MPD_PLAYER_STOP)
+	{	
+		gimmix_batch_play (batch);
+	}
+
+	return;
+}
+
+static void
+cb_library_popup_add_clicked (G_GNUC_UNUSED GtkWidget *widget,
+			      G_GNUC_UNUSED gpointer   data)
+{
+	GimmixBatch		*batch;
+
+	batch = gimmix_batch_new ();
+	gimmix_library_selection_add (batch);
+	gimmix_library_play_on_add (batch);
+	gimmix_batch_commit (batch, NULL, NULL);
+	
+	return;
+}
+
+static void
+cd_library_popup_replace_clicked (G_GNUC_UNUSED GtkWidget *widget,
+				  G_GNUC_UNUSED gpointer   data)
+{
+	GimmixBatch		*batch;
+
+	batch = gimmix_batch_new ();
+	gimmix_current_playlist_clear_view (batch);
+	gimmix_library_selection_add (batch);
+	if (gimmix_config_get_bool("play_on_add"))
 	{
-		gtk_tree_model_get_iter (model, &iter, list->data);
-		gtk_tree_model_get (model, &iter, 2, &path, 3, &type, -1);
+		gimmix_batch_play (batch);
+	}
+	gimmix_batch_commit (batch, NULL, NULL);
 	
-		
-		if (type == GIMMIX_FILE_DIR)
-		{	
-			mpd_playlist_queue_add (gmo, path);
-			g_free (path);
+	return;
+}
+
+static void
+cb_playlist_activated (GtkTreeView *treeview)
+{
+	GtkTreeModel 		*model;
+	GtkTreeSelection 	*selection;
+	GtkTreeIter 		iter;
+	gchar 			*pl_name;
+	GimmixBatch		*batch;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW (treeview));
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (treeview));
+
+	if (!gtk_tree_selection_get_selected (selection, &model, &iter))
+		return;
+	gtk_tree_model_get (model, &iter, 1, &pl_name, -1);
+	
+	batch = gimmix_batch_new ();
+	gimmix_current_playlist_clear_view (batch);
+	gimmix_batch_load (batch, pl_name);
+	gimmix_batch_commit (batch, NULL, NULL);
+	
+	gimmix_load_playlist (pl_name);
+	g_free (pl_name);
+
+	return;
+}
+
+static void
+gimmix_load_playlist (gchar *pls)
+{
+	/* unload the old playlist */
+	if (loaded_playlist != NULL)
+		g_free (loaded_playlist);
+	
+	/* load the new playlist*/
+	loaded_playlist = g_strdup (pls);
+	
+	return;
+}
+
+static void
+gimmix_stored_playlist_free (StoredPlaylist *pls)
+{
+	g_free (pls->name);
+	g_free (pls->modified);
+	g_free (pls);
+
+	return;
+}
+
+/* has anything changed since the list was shown */
+static gboolean
+gimmix_stored_playlists_equal (GPtrArray *a, GPtrArray *b)
+{
+	guint i;
+
+	if (a == NULL || b == NULL || a->len != b->len)
+		return FALSE;
+
+	for (i = 0; i < a->len; i++)
+	{
+		StoredPlaylist *pa = g_ptr_array_index (a, i);
+		StoredPlaylist *pb = g_ptr_array_index (b, i);
+
+		if (strcmp (pa->name, pb->name) || g_strcmp0 (pa->modified, pb->modified))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+gimmix_update_playlists_treeview (void)
+{
+	GtkListStore	*pls_liststore;
+	GtkTreeIter	pls_treeiter;
+	GdkPixbuf	*icon;
+	guint		i;
+
+	icon = gimmix_get_pixbuf (GIMMIX_PLAYLIST_ICON, 16, 16);
+
+	pls_liststore = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW(playlists_treeview)));
+	gtk_list_store_clear (pls_liststore);
+	for (i = 0; i < stored_playlists->len; i++)
+	{
+		StoredPlaylist *pls = g_ptr_array_index (stored_playlists, i);
+
+		gtk_list_store_append (pls_liststore, &pls_treeiter);
+		gtk_list_store_set (pls_liststore, &pls_treeiter,
+							0, icon,
+							1, pls->name,
+							-1);
+	}
+	if (icon != NULL)
+		g_object_unref (icon);
+
+	return;
+}
+
+static void
+cb_stored_playlists_listed (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	GPtrArray	*list;
+	StoredPlaylist	*pls = NULL;
+	guint		i;
+
+	stored_playlists_pending = FALSE;
+	if (!reply->ok)
+	{
+		fprintf (stderr, "listplaylists: %s\n", reply->error);
+	}
+	else
+	{
+		list = g_ptr_array_new_with_free_func ((GDestroyNotify)gimmix_stored_playlist_free);
+		for (i = 0; reply->lines[i] != NULL; i++)
+		{
+			if (!strncmp (reply->lines[i], "playlist: ", 10))
+			{
+				pls = g_new0 (StoredPlaylist, 1);
+				pls->name = g_strdup (reply->lines[i] + 10);
+				g_ptr_array_add (list, pls);
+			}
+			else if (pls != NULL && !strncmp (reply->lines[i], "Last-Modified: ", 15))
+			{
+				pls->modified = g_strdup (reply->lines[i] + 15);
+			}
 		}
-		
-		if (type == GIMMIX_FILE_SONG)
+
+		if (gimmix_stored_playlists_equal (list, stored_playlists))
 		{
-			mpd_playlist_queue_add (gmo, path);
-			g_free (path);
+			g_ptr_array_free (list, TRUE);
+		}
+		else
+		{
+			if (stored_playlists != NULL)
+				g_ptr_array_free (stored_playlists, TRUE);
+			stored_playlists = list;
+			gimmix_update_playlists_treeview ();
 		}
-		
-		list = g_list_next (list);
 	}
-	
-	mpd_playlist_queue_commit (gmo);
-	if (gimmix_config_get_bool("play_on_add"))
+
+	/* something changed while the list was on its way, the new
+	 * request may also succeed where this one failed */
+	if (stored_playlists_again)
 	{
-		/* If we're adding, there might already be a song playing. */
-		int state;
+		stored_playlists_again = FALSE;
+		gimmix_stored_playlists_refresh ();
+	}
 
-		state = mpd_player_get_state (gmo);
+	return;
+}
 
-		if (state == MPD_PLAYER_PAUSE || state == MPD_PLAYER_STOP)
-		{	
-			mpd_player_play (gmo);
-		}
+void
+gimmix_stored_playlists_refresh (void)
+{
+	if (stored_playlists_pending)
+	{
+		stored_playlists_again = TRUE;
+		return;
 	}
-	mpd_status_update (gmo);
-		
-	/* free the list */
-	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
-	g_list_free (list);
-	
+
+	stored_playlists_pending = TRUE;
+	gimmix_mpdio_command (cb_stored_playlists_listed, NULL, "listplaylists");
+
 	return;
 }
 
+/* give a directory row an expander, its children are listed when
+ * the row is expanded for the first time */
 static void
-cd_library_popup_replace_clicked (G_GNUC_UNUSED GtkWidget *widget,
-				  G_GNUC_UNUSED gpointer   data)
+gimmix_library_add_placeholder (GtkTreeStore *store, GtkTreeIter *parent)
 {
+	GtkTreeIter iter;
 
-	GtkTreeModel 		*model;
-	GtkTreeIter 		iter;
-	GList			*list;
-	gchar			*path;
-	GimmixFileType		type;
+	gtk_tree_store_append (store, &iter, parent);
+	gtk_tree_store_set (store, &iter,
+				1, _("Loading..."),
+				3, GIMMIX_FILE_NONE,
+				-1);
 
-	model = gtk_tree_view_get_model (GTK_TREE_VIEW (library_treeview));
-	list = gtk_tree_selection_get_selected_rows (library_selection, &model);
+	return;
+}
 
-	gimmix_current_playlist_clear();	
-	mpd_status_update (gmo);
+/* put a directory listing below its row, replacing the placeholder */
+static void
+gimmix_library_fill_node (GtkTreeIter *parent, GPtrArray *entries)
+{
+	GtkTreeModel	*model;
+	GtkTreeStore	*store;
+	GtkTreeIter	placeholder;
+	GtkTreeIter	iter;
+	GdkPixbuf	*dir_pixbuf;
+	GdkPixbuf	*song_pixbuf;
+	gboolean	has_placeholder = FALSE;
+	gboolean	valid;
+	gint		type;
+	guint		i;
 
-	if (gtk_tree_selection_count_selected_rows (library_selection) == 1)
-	{
-		gtk_tree_model_get_iter (model, &iter, list->data);
-		gtk_tree_model_get (model, &iter, 2, &path, 3, &type, -1);
-		
-		if (type == GIMMIX_FILE_DIR)
-		{
-			mpd_playlist_queue_add (gmo, path);
-		}
-		else if (type == GIMMIX_FILE_SONG)
-		{
-			mpd_playlist_add (gmo, path);
-		}
-		
-		g_free (path);
-	}
-	else
-	while (list != NULL)
+	/* the placeholder is the first child, only the top level has the
+	 * ".." row in front of it */
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW (library_treeview));
+	store = GTK_TREE_STORE (model);
+	valid = gtk_tree_model_iter_children (model, &placeholder, parent);
+	while (valid)
 	{
-		gtk_tree_model_get_iter (model, &iter, list->data);
-		gtk_tree_model_get (model, &iter, 2, &path, 3, &type, -1);
-	
-		
-		if (type == GIMMIX_FILE_DIR)
-		{	
-			mpd_playlist_queue_add (gmo, path);
-			g_free (path);
-		}
-		
-		if (type == GIMMIX_FILE_SONG)
-		{
-			mpd_playlist_queue_add (gmo, path);
-			g_free (path);
-		}
-		
-		list = g_list_next (list);
+		gtk_tree_model_get (model, &placeholder, 3, &type, -1);
+		if ((has_placeholder = (type == GIMMIX_FILE_NONE)))
+			break;
+		valid = gtk_tree_model_iter_next (model, &placeholder);
 	}
+	/* filled by an earlier reply */
+	if (!has_placeholder)
+		return;
 
-	mpd_playlist_queue_commit (gmo);
-	
-	if (gimmix_config_get_bool("play_on_add"))
+	dir_pixbuf 	= gimmix_get_stock_pixbuf (library_treeview,
+							GTK_STOCK_DIRECTORY,
+							GTK_ICON_SIZE_BUTTON);
+	song_pixbuf = gimmix_get_pixbuf (GIMMIX_MEDIA_ICON, 16, 16);
+
+	for (i = 0; i < entries->len; i++)
 	{
-		gimmix_play(gmo);
+		GimmixLibraryEntry *entry = g_ptr_array_index (entries, i);
+
+		gtk_tree_store_append (store, &iter, parent);
+		gtk_tree_store_set (store, &iter,
+					0, (entry->type == GIMMIX_FILE_DIR) ? dir_pixbuf : song_pixbuf,
+					1, entry->name,
+					2, entry->path,
+					3, entry->type,
+					-1);
+		if (entry->type == GIMMIX_FILE_DIR)
+			gimmix_library_add_placeholder (store, &iter);
 	}
-	mpd_status_update (gmo);
-		
-	/* free the list */
-	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
-	g_list_free (list);
-	
+	/* removed last, an expanded row without children would collapse */
+	gtk_tree_store_remove (store, &placeholder);
+
+	if (dir_pixbuf != NULL)
+		g_object_unref (dir_pixbuf);
+	if (song_pixbuf != NULL)
+		g_object_unref (song_pixbuf);
+
 	return;
 }
 
 static void
-cb_playlist_activated (GtkTreeView *treeview)
+cb_library_listed (const GimmixMpdReply *reply, gpointer data)
 {
-	GtkTreeModel 		*model;
-	GtkTreeSelection 	*selection;
-	GtkTreeIter 		iter;
-	gchar 			*pl_name;
+	LibraryRequest	*req = data;
+	GtkTreeModel	*model;
+	GtkTreePath	*path;
+	GtkTreeIter	iter;
+	GPtrArray	*entries;
 
-	model = gtk_tree_view_get_model (GTK_TREE_VIEW (treeview));
-	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (treeview));
+	if (!reply->ok)
+	{
+		fprintf (stderr, "lsinfo: %s\n", reply->error);
+	}
+	else if (req->generation == library_cache_generation)
+	{
+		/* only listings asked for since the last refresh are
+		 * cached, older ones may show the database as it was */
+		entries = gimmix_library_parse_listing (reply);
+		g_hash_table_replace (library_cache, g_strdup (req->path), entries);
 
-	if ( gtk_tree_selection_get_selected (selection, &model, &iter) )
-		gtk_tree_model_get (model, &iter, 1, &pl_name, -1);
-	
-	mpd_playlist_queue_load (gmo, pl_name);
-	gimmix_current_playlist_clear ();
-	mpd_playlist_queue_commit (gmo);
-	
-	gimmix_load_playlist (pl_name);
-	g_free (pl_name);
+		/* the row is gone if the user navigated away in the meantime */
+		if (req->row == NULL)
+		{
+			if (req->serial == library_view_serial)
+				gimmix_library_fill_node (NULL, entries);
+		}
+		else if (gtk_tree_row_reference_valid (req->row))
+		{
+			model = gtk_tree_row_reference_get_model (req->row);
+			path = gtk_tree_row_reference_get_path (req->row);
+			if (gtk_tree_model_get_iter (model, &iter, path))
+				gimmix_library_fill_node (&iter, entries);
+			gtk_tree_path_free (path);
+		}
+	}
+	if (req->row != NULL)
+		gtk_tree_row_reference_free (req->row);
+	g_free (req->path);
+	g_free (req);
 
 	return;
 }
 
 static void
-gimmix_load_playlist (gchar *pls)
+gimmix_library_cache_init (void)
 {
-	/* unload the old playlist */
-	if (loaded_playlist != NULL)
-		g_free (loaded_playlist);
-	
-	/* load the new playlist*/
-	loaded_playlist = g_strdup (pls);
-	
+	if (library_cache == NULL)
+		library_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+
 	return;
 }
 
-static void
-gimmix_update_playlists_treeview (void)
+static gboolean
+cb_library_row_expand (GtkTreeView	*treeview,
+			GtkTreeIter	*iter,
+			GtkTreePath	*path,
+			G_GNUC_UNUSED gpointer data)
 {
-	GtkTreeModel	*pls_treemodel;
-	GtkTreeIter		pls_treeiter;
-	GtkListStore	*pls_liststore;
-	GdkPixbuf		*pls_pixbuf;
-	MpdData			*data;
-	gchar			*name;
-	gchar			*path;
-	
-	pls_treemodel = gtk_tree_view_get_model (GTK_TREE_VIEW(playlists_treeview));
-	pls_liststore = GTK_LIST_STORE (pls_treemodel);
-	
-	gtk_list_store_clear (pls_liststore);
-	
-	path = gimmix_get_full_image_path (GIMMIX_PLAYLIST_ICON);
-	pls_pixbuf	= gdk_pixbuf_new_from_file_at_size (path, 16, 16, NULL);
-	g_free (path);
-	
-	for (data = mpd_database_get_directory(gmo, NULL); data != NULL; data = mpd_data_get_next(data))
+	GtkTreeModel	*model;
+	GtkTreeIter	child;
+	LibraryRequest	*req;
+	GPtrArray	*entries;
+	gchar		*dir;
+	gchar		*arg;
+	gint		type;
+
+	model = gtk_tree_view_get_model (treeview);
+	if (!gtk_tree_model_iter_children (model, &child, iter))
+		return FALSE;
+	gtk_tree_model_get (model, &child, 3, &type, -1);
+	if (type != GIMMIX_FILE_NONE)
+		return FALSE;
+
+	gtk_tree_model_get (model, iter, 2, &dir, -1);
+	gimmix_library_cache_init ();
+
+	/* listed before, maybe as a sibling of a branch opened earlier */
+	entries = g_hash_table_lookup (library_cache, dir);
+	if (entries != NULL)
 	{
-		if (data->type == MPD_DATA_TYPE_PLAYLIST)
-		{
-			gtk_list_store_append (pls_liststore, &pls_treeiter);
-			name = (char*) data->playlist;
-			gtk_list_store_set (pls_liststore, &pls_treeiter,
-								0, pls_pixbuf,
-								1, name,
-								-1);
-		}
+		gimmix_library_fill_node (iter, entries);
+		g_free (dir);
+		return FALSE;
 	}
-	g_object_unref (pls_pixbuf);
-	mpd_data_free (data);
 
-	pls_treemodel = GTK_TREE_MODEL (pls_liststore);
-	gtk_tree_view_set_model (GTK_TREE_VIEW(playlists_treeview), pls_treemodel);
+	req = g_new0 (LibraryRequest, 1);
+	req->path = dir;
+	req->row = gtk_tree_row_reference_new (model, path);
+	req->generation = library_cache_generation;
+	arg = gimmix_mpd_quote (dir);
+	gimmix_mpdio_command (cb_library_listed, req, "lsinfo %s", arg);
+	g_free (arg);
 
-	return;
+	return FALSE;
 }
 
 static void
 gimmix_update_library_with_dir (gchar *dir)
 {
-	GtkTreeModel	*directory_model;
-	GtkListStore	*dir_store;
+	GtkTreeStore	*dir_store;
 	GtkTreeIter	dir_iter;
 	GdkPixbuf	*dir_pixbuf;
-	GdkPixbuf	*song_pixbuf;
-	MpdData		*data;
+	LibraryRequest	*req;
+	GPtrArray	*entries;
 	gchar		*parent;
-	gchar		*path;
-	gchar		*directory;
+	gchar		*arg;
 	
-	directory_model = gtk_tree_view_get_model (GTK_TREE_VIEW (library_treeview));
-	dir_store 	= GTK_LIST_STORE (directory_model);
+	dir_store = GTK_TREE_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (library_treeview)));
 
 	if (!strlen(dir))
 		dir = "/";
 
+	if (dir != library_current_dir)
+	{
+		g_free (library_current_dir);
+		library_current_dir = g_strdup (dir);
+	}
+	library_view_serial++;
+
 	/* Clear the stores */
-	gtk_list_store_clear (dir_store);
+	gtk_tree_store_clear (dir_store);
 
-	dir_pixbuf 	= gtk_widget_render_icon (GTK_WIDGET(library_treeview),
-							GTK_STOCK_DIRECTORY,
-							GTK_ICON_SIZE_BUTTON,
-							NULL);
-	path = gimmix_get_full_image_path (GIMMIX_MEDIA_ICON);
-	song_pixbuf = gdk_pixbuf_new_from_file_at_size (path, 16, 16, NULL);
-	g_free (path);
-	
 	if (strcmp(dir,"/"))
 	{	
+		dir_pixbuf = gimmix_get_stock_pixbuf (library_treeview,
+							GTK_STOCK_DIRECTORY,
+							GTK_ICON_SIZE_BUTTON);
 		parent = gimmix_path_get_parent_dir (dir);
-		gtk_list_store_append (dir_store, &dir_iter);
-		gtk_list_store_set (dir_store, &dir_iter,
+		gtk_tree_store_append (dir_store, &dir_iter, NULL);
+		gtk_tree_store_set (dir_store, &dir_iter,
 					0, dir_pixbuf,
 					1, "..",
 					2, parent,
 					3, GIMMIX_FILE_DIR,
 					-1);
 		g_free (parent);
+		if (dir_pixbuf != NULL)
+			g_object_unref (dir_pixbuf);
 	}
-	
-	for (data = mpd_database_get_directory(gmo, dir); data != NULL; data = mpd_data_get_next(data))
-	{	
-		if (data->type == MPD_DATA_TYPE_DIRECTORY)
-		{
-			directory = g_path_get_basename(data->directory);
-			gtk_list_store_append (dir_store, &dir_iter);
-			gtk_list_store_set (dir_store, &dir_iter,
-								0, dir_pixbuf,
-								1, directory,
-								2, data->directory,
-								3, GIMMIX_FILE_DIR,
-								-1);
-			g_free (directory);
-		}
-		else if (data->type == MPD_DATA_TYPE_SONG)
-		{
-			gchar *title;
-			
-			gtk_list_store_append (dir_store, &dir_iter);
-			if (data->song->title)
-			{
-				if (data->song->artist)
-					title = g_strdup_printf ("%s - %s", data->song->artist, data->song->title);
-				else
-					title = g_strdup (data->song->title);
-			}
-			else
-			{
-				title = g_path_get_basename (data->song->file);
-				gimmix_strip_file_ext (title);
-			}
-			gtk_list_store_set (dir_store, &dir_iter,
-								0, song_pixbuf,
-								1, title,
-								2, data->song->file,
-								3, GIMMIX_FILE_SONG,
-								-1);
-			g_free (title);
-		}
-		gtk_list_store_set (dir_store, &dir_iter, 4, data->song->id, -1);
+
+	/* the listing goes where the placeholder is, like an expanded row */
+	gimmix_library_add_placeholder (dir_store, NULL);
+	gimmix_library_cache_init ();
+	if ((entries = g_hash_table_lookup (library_cache, dir)) != NULL)
+	{
+		gimmix_library_fill_node (NULL, entries);
+		return;
 	}
-	
-	mpd_data_free (data);
 
-	directory_model = GTK_TREE_MODEL (dir_store);
-	gtk_tree_view_set_model (GTK_TREE_VIEW(library_treeview), directory_model);
-	
-	g_object_unref (dir_pixbuf);
-	g_object_unref (song_pixbuf);
+	req = g_new0 (LibraryRequest, 1);
+	req->path = g_strdup (dir);
+	req->serial = library_view_serial;
+	req->generation = library_cache_generation;
+	arg = gimmix_mpd_quote (dir);
+	gimmix_mpdio_command (cb_library_listed, req, "lsinfo %s", arg);
+	g_free (arg);
 	
 	return;
 }
@@ -1352,6 +2127,9 @@ gimmix_library_song_info (void)
 	gchar				*path;
 	gint				type = -1;
 	guint				id;
+	#ifndef HAVE_TAGEDITOR
+	mpd_Song			*info;
+	#endif
 
 	model = gtk_tree_view_get_model (GTK_TREE_VIEW(library_treeview));
 	
@@ -1359,7 +2137,7 @@ gimmix_library_song_info (void)
 	gtk_tree_model_get_iter (model, &iter, list->data);
 	gtk_tree_model_get (model, &iter, 2, &path, 3, &type, 4, &id, -1);
 
-	if (type == GIMMIX_FILE_DIR)
+	if (type != GIMMIX_FILE_SONG)
 	{
 		g_free (path);
 		return;
@@ -1376,7 +2154,8 @@ gimmix_library_song_info (void)
 	}
 	g_free (song_path);
 	#else
-	if (gimmix_tag_editor_populate (mpd_database_get_fileinfo(gmo,path)))
+	GIMMIX_MPD_CALL ("lsinfo", info = mpd_database_get_fileinfo (gmo, path));
+	if (gimmix_tag_editor_populate (info))
 	{
 		gtk_widget_show (tag_editor_window);
 	}
@@ -1395,6 +2174,66 @@ gimmix_library_song_info (void)
 	return;
 }
 
+#ifdef HAVE_TAGEDITOR
+static void
+gimmix_library_edit_tags (void)
+{
+	GtkTreeModel		*model;
+	GList			*list;
+	GList			*node;
+	GList			*files = NULL;
+	GtkTreeIter		iter;
+	gchar			*path;
+	gint			type;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW(library_treeview));
+	list = gtk_tree_selection_get_selected_rows (library_selection, &model);
+	for (node = list; node != NULL; node = node->next)
+	{
+		gtk_tree_model_get_iter (model, &iter, node->data);
+		gtk_tree_model_get (model, &iter, 2, &path, 3, &type, -1);
+		/* directories and playlists are skipped */
+		if (type == GIMMIX_FILE_SONG)
+			files = g_list_prepend (files, path);
+		else
+			g_free (path);
+	}
+	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
+	g_list_free (list);
+
+	gimmix_tag_editor_batch_show (g_list_reverse (files));
+
+	return;
+}
+
+static void
+gimmix_current_playlist_edit_tags (void)
+{
+	GtkTreeModel		*model;
+	GList			*list;
+	GList			*node;
+	GList			*files = NULL;
+	GtkTreeIter		iter;
+	gchar			*path;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
+	list = gtk_tree_selection_get_selected_rows (current_playlist_selection, &model);
+	for (node = list; node != NULL; node = node->next)
+	{
+		gtk_tree_model_get_iter (model, &iter, node->data);
+		gtk_tree_model_get (model, &iter, 1, &path, -1);
+		if (path != NULL)
+			files = g_list_prepend (files, path);
+	}
+	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
+	g_list_free (list);
+
+	gimmix_tag_editor_batch_show (g_list_reverse (files));
+
+	return;
+}
+#endif
+
 static void
 gimmix_current_playlist_song_info (void)
 {
@@ -1403,6 +2242,9 @@ gimmix_current_playlist_song_info (void)
 	GtkTreeIter			iter;
 	gchar				*path;
 	guint				id;
+	#ifndef HAVE_TAGEDITOR
+	mpd_Song			*info;
+	#endif
 
 	model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
 	if (gtk_tree_selection_count_selected_rows(current_playlist_selection) != 1)
@@ -1411,6 +2253,13 @@ gimmix_current_playlist_song_info (void)
 	list = gtk_tree_selection_get_selected_rows (current_playlist_selection, &model);
 	gtk_tree_model_get_iter (model, &iter, list->data);
 	gtk_tree_model_get (model, &iter, 1, &path, 2, &id, -1);
+	if (path == NULL)
+	{
+		/* not loaded yet */
+		g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
+		g_list_free (list);
+		return;
+	}
 	
 	#ifdef HAVE_TAGEDITOR
 	gchar *song_path = g_strdup_printf ("%s/%s", cfg_get_key_value(conf, "music_directory"), path);
@@ -1424,7 +2273,8 @@ gimmix_current_playlist_song_info (void)
 	}
 	g_free (song_path);
 	#else
-	if (gimmix_tag_editor_populate (mpd_playlist_get_song(gmo,id)))
+	GIMMIX_MPD_CALL ("playlistid", info = mpd_playlist_get_song (gmo, id));
+	if (gimmix_tag_editor_populate (info))
 	{
 		gtk_widget_show (tag_editor_window);
 	}
@@ -1442,28 +2292,66 @@ gimmix_current_playlist_song_info (void)
 	return;
 }
 
+/* id of a row, -1 if it belongs to a paged queue and is not loaded */
+static gint
+gimmix_current_playlist_row_id (GtkTreeModel *model, GtkTreePath *path)
+{
+	GtkTreeIter	iter;
+	gint		id = -1;
+
+	if (gtk_tree_model_get_iter (model, &iter, path))
+		gtk_tree_model_get (model, &iter, 2, &id, -1);
+
+	return id;
+}
+
+/* Delete the rows in paths (ascending, as the selection returns them).
+ * Loaded rows go by id, runs of unloaded rows by position. Working from
+ * the end keeps the positions of the remaining rows valid. */
+static void
+gimmix_current_playlist_delete_rows (GtkTreeModel *model, GList *paths, GimmixBatch *batch)
+{
+	GList	*node;
+	gint	id;
+	gint	pos;
+	gint	end;
+
+	for (node = g_list_last (paths); node != NULL; node = node->prev)
+	{
+		id = gimmix_current_playlist_row_id (model, node->data);
+		if (id >= 0)
+		{
+			gimmix_batch_delete_id (batch, id);
+			continue;
+		}
+		pos = gtk_tree_path_get_indices (node->data)[0];
+		end = pos + 1;
+		while (node->prev != NULL &&
+			gtk_tree_path_get_indices (node->prev->data)[0] == pos - 1 &&
+			gimmix_current_playlist_row_id (model, node->prev->data) < 0)
+		{
+			node = node->prev;
+			pos--;
+		}
+		gimmix_batch_delete_range (batch, pos, end);
+	}
+
+	return;
+}
+
 static void
 gimmix_current_playlist_remove_song (void)
 {
 	GtkTreeModel		*current_playlist_model;
-	GtkTreeIter			iter;
 	GList				*list;
-	gint				id;
+	GimmixBatch			*batch;
 
 	current_playlist_model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
 	list = gtk_tree_selection_get_selected_rows (current_playlist_selection, &current_playlist_model);
 	
-	while (list != NULL)
-	{
-		if (TRUE == gtk_tree_model_get_iter (current_playlist_model, &iter, list->data))
-		{
-			gtk_tree_model_get (current_playlist_model, &iter, 2, &id, -1);
-			mpd_playlist_queue_delete_id (gmo, id);
-		}
-		list = g_list_next (list);
-	}
-	mpd_playlist_queue_commit (gmo);
-	mpd_status_update (gmo);
+	batch = gimmix_batch_new ();
+	gimmix_current_playlist_delete_rows (current_playlist_model, list, batch);
+	gimmix_batch_commit (batch, NULL, NULL);
 	
 	/* free the list */
 	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
@@ -1479,33 +2367,25 @@ gimmix_current_playlist_crop_song (void)
 	GtkTreeIter			iter;
 	GList				*list;
 	GList				*all;
-	gint				id;
+	GList				*node;
+	GimmixBatch			*batch;
 
 	current_playlist_model = gtk_tree_view_get_model (GTK_TREE_VIEW(current_playlist_treeview));
 	list = gtk_tree_selection_get_selected_rows (current_playlist_selection, &current_playlist_model);
 	gtk_tree_selection_select_all (current_playlist_selection);
 
-	while (list != NULL)
+	for (node = list; node != NULL; node = g_list_next (node))
 	{
-		if (gtk_tree_model_get_iter (current_playlist_model, &iter, list->data))
+		if (gtk_tree_model_get_iter (current_playlist_model, &iter, node->data))
 		{
 			gtk_tree_selection_unselect_iter (current_playlist_selection, &iter);
 		}
-		list = g_list_next (list);
 	}
 
 	all = gtk_tree_selection_get_selected_rows (current_playlist_selection, &current_playlist_model);
-	while (all != NULL)
-	{
-		if (TRUE == gtk_tree_model_get_iter (current_playlist_model, &iter, all->data))
-		{
-			gtk_tree_model_get (current_playlist_model, &iter, 2, &id, -1);
-			mpd_playlist_queue_delete_id (gmo, id);
-		}
-		all = g_list_next (all);
-	}
-	mpd_playlist_queue_commit (gmo);
-	mpd_status_update (gmo);
+	batch = gimmix_batch_new ();
+	gimmix_current_playlist_delete_rows (current_playlist_model, all, batch);
+	gimmix_batch_commit (batch, NULL, NULL);
 	
 	/* free the list */
 	g_list_foreach (list, (GFunc)gtk_tree_path_free, NULL);
@@ -1518,7 +2398,7 @@ gimmix_current_playlist_crop_song (void)
 
 
 static void
-gimmix_current_playlist_clear (void)
+gimmix_current_playlist_clear_view (GimmixBatch *batch)
 {
 	GtkListStore	*current_playlist_store;
 	
@@ -1526,8 +2406,7 @@ gimmix_current_playlist_clear (void)
 	gtk_list_store_clear (GTK_LIST_STORE(current_playlist_store));
 	if (mpd_playlist_get_playlist_length (gmo) != 0)
 	{
-		mpd_playlist_clear (gmo);
-		mpd_status_update (gmo);
+		gimmix_batch_clear (batch);
 	}
 	if (loaded_playlist != NULL)
 	{
@@ -1537,6 +2416,18 @@ gimmix_current_playlist_clear (void)
 	return;
 }
 
+static void
+gimmix_current_playlist_clear (void)
+{
+	GimmixBatch	*batch;
+
+	batch = gimmix_batch_new ();
+	gimmix_current_playlist_clear_view (batch);
+	gimmix_batch_commit (batch, NULL, NULL);
+
+	return;
+}
+
 static void
 cb_gimmix_playlist_column_show_toggled (GtkCheckMenuItem *menu_item, gpointer data)
 {
@@ -1611,6 +2502,17 @@ gimmix_current_playlist_popup_menu (void)
 	g_signal_connect (G_OBJECT (menu_item), "activate", G_CALLBACK (gimmix_current_playlist_song_info), NULL);
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
 	gtk_widget_show (menu_item);
+
+	#ifdef HAVE_TAGEDITOR
+	if (gtk_tree_selection_count_selected_rows(current_playlist_selection) > 1)
+	{
+		menu_item = gtk_image_menu_item_new_with_label (_("Edit Tags"));
+		gtk_image_menu_item_set_image (GTK_IMAGE_MENU_ITEM(menu_item), GTK_WIDGET(get_image ("gtk-edit", GTK_ICON_SIZE_MENU)));
+		g_signal_connect (G_OBJECT (menu_item), "activate", G_CALLBACK (gimmix_current_playlist_edit_tags), NULL);
+		gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
+		gtk_widget_show (menu_item);
+	}
+	#endif
 	
 	menu_item = gtk_separator_menu_item_new ();
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
@@ -1620,6 +2522,13 @@ gimmix_current_playlist_popup_menu (void)
 	g_signal_connect (G_OBJECT (menu_item), "activate", G_CALLBACK (gimmix_current_playlist_clear), NULL);
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
 	gtk_widget_show (menu_item);
+
+	menu_item = gtk_image_menu_item_new_with_label (_("Apply Sort Order"));
+	gtk_image_menu_item_set_image (GTK_IMAGE_MENU_ITEM(menu_item), GTK_WIDGET(get_image ("gtk-sort-ascending", GTK_ICON_SIZE_MENU)));
+	g_signal_connect (G_OBJECT (menu_item), "activate", G_CALLBACK (gimmix_current_playlist_apply_order), NULL);
+	gtk_widget_set_sensitive (menu_item, playlist_sort_column != GIMMIX_SORT_NONE);
+	gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
+	gtk_widget_show (menu_item);
 	
 	menu_item = gtk_separator_menu_item_new ();
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
@@ -1727,6 +2636,16 @@ gimmix_library_popup_menu (void)
 		gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
 		gtk_widget_show (menu_item);
 	}
+	#ifdef HAVE_TAGEDITOR
+	else if (gtk_tree_selection_count_selected_rows(library_selection) > 1)
+	{
+		menu_item = gtk_image_menu_item_new_with_label (_("Edit Tags"));
+		gtk_image_menu_item_set_image (GTK_IMAGE_MENU_ITEM(menu_item), GTK_WIDGET(get_image ("gtk-edit", GTK_ICON_SIZE_MENU)));
+		g_signal_connect (G_OBJECT (menu_item), "activate", G_CALLBACK (gimmix_library_edit_tags), NULL);
+		gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
+		gtk_widget_show (menu_item);
+	}
+	#endif
 	
 	menu_item = gtk_separator_menu_item_new ();
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
@@ -1788,11 +2707,11 @@ cb_repeat_menu_toggled (GtkCheckMenuItem *item, G_GNUC_UNUSED gpointer data)
 	state = gtk_check_menu_item_get_active (item);
 	if (state == TRUE)
 	{
-		mpd_player_set_repeat (gmo, true);
+		gimmix_set_repeat (true);
 	}
 	else if (state == FALSE)
 	{
-		mpd_player_set_repeat (gmo, false);
+		gimmix_set_repeat (false);
 	}
 	
 	return;
@@ -1806,11 +2725,11 @@ cb_shuffle_menu_toggled (GtkCheckMenuItem *item, G_GNUC_UNUSED gpointer data)
 	state = gtk_check_menu_item_get_active (item);
 	if (state == TRUE)
 	{
-		mpd_player_set_random (gmo, true);
+		gimmix_set_random (true);
 	}
 	else if (state == FALSE)
 	{
-		mpd_player_set_random (gmo, false);
+		gimmix_set_random (false);
 	}
 	
 	return;
@@ -1819,28 +2738,55 @@ cb_shuffle_menu_toggled (GtkCheckMenuItem *item, G_GNUC_UNUSED gpointer data)
 void
 gimmix_library_update (void)
 {
-	mpd_database_update_dir (gmo, "/");
+	/* the status right behind the update already shows the job */
+	gimmix_mpdio_command (NULL, NULL, "update");
+	gimmix_mpdio_command (cb_library_update_status, NULL, "status");
 	gtk_label_set_text (GTK_LABEL(gimmix_statusbar), _("Updating Library..."));
 	gtk_widget_show (gimmix_statusbox);
 	/* disable the update button on the toolbar */
 	gtk_widget_set_sensitive (button_update, FALSE);
-	g_timeout_add (300, (GSourceFunc)gimmix_update_player_status, NULL);
+
+	return;
+}
+
+void
+gimmix_library_refresh (void)
+{
+	/* listings cached before the database changed are stale */
+	if (library_cache != NULL)
+		g_hash_table_remove_all (library_cache);
+	library_cache_generation++;
+	gimmix_update_library_with_dir (library_current_dir ? library_current_dir : "/");
+	gimmix_tagbrowser_refresh ();
 
 	return;
 }
 
 static gboolean
-gimmix_update_player_status (G_GNUC_UNUSED gpointer data)
+gimmix_library_update_poll (G_GNUC_UNUSED gpointer data)
 {
-	if (mpd_status_db_is_updating (gmo))
-		return TRUE;
-		
+	gimmix_mpdio_command (cb_library_update_status, NULL, "status");
+
+	return FALSE;
+}
+
+/* look at the status every 300 ms until the update job is gone */
+static void
+cb_library_update_status (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	if (reply->ok && gimmix_mpd_reply_get (reply, "updating_db") != NULL)
+	{
+		g_timeout_add (300, gimmix_library_update_poll, NULL);
+		return;
+	}
+
+	gimmix_status_refresh ();
 	gimmix_display_total_playlist_time (NULL);		
-	gimmix_update_library_with_dir ("/");
+	gimmix_update_library_with_dir (library_current_dir ? library_current_dir : "/");
 	/* re-enable the update button on the toolbar */
 	gtk_widget_set_sensitive (button_update, TRUE);	
 	
-	return FALSE;
+	return;
 }
 
 static gchar *
@@ -1904,10 +2850,13 @@ cb_gimmix_playlist_save_response (GtkDialog *dlg, gint arg1, gpointer dialog)
 {
 	if (arg1 == GTK_RESPONSE_ACCEPT)
 	{	
+		int ret;
+
 		if (loaded_playlist != NULL)
 		{
-			mpd_database_delete_playlist (gmo, loaded_playlist);
-			if ((mpd_database_save_playlist (gmo, loaded_playlist)) == MPD_DATABASE_PLAYLIST_EXIST)
+			GIMMIX_MPD_CALL ("rm", mpd_database_delete_playlist (gmo, loaded_playlist));
+			GIMMIX_MPD_CALL ("save", ret = mpd_database_save_playlist (gmo, loaded_playlist));
+			if (ret == MPD_DATABASE_PLAYLIST_EXIST)
 				g_print (_("playlist already exists.\n"));
 		}
 		else
@@ -1918,13 +2867,14 @@ cb_gimmix_playlist_save_response (GtkDialog *dlg, gint arg1, gpointer dialog)
 			widget_list = gtk_container_get_children (GTK_CONTAINER(GTK_DIALOG(dialog)->vbox));
 			widget_list = widget_list->next;
 			text = gtk_entry_get_text (GTK_ENTRY(widget_list->data));
-			if ((mpd_database_save_playlist (gmo, (char*)text)) == MPD_DATABASE_PLAYLIST_EXIST)
+			GIMMIX_MPD_CALL ("save", ret = mpd_database_save_playlist (gmo, (char*)text));
+			if (ret == MPD_DATABASE_PLAYLIST_EXIST)
 				g_print (_("playlist already exists.\n"));
 			
 			g_list_free (widget_list);
 			gimmix_load_playlist ((char*)text);
 		}
-		gimmix_update_playlists_treeview ();
+		gimmix_stored_playlists_refresh ();
 	}	
 
 	gtk_widget_destroy (GTK_WIDGET(dlg));
@@ -1951,13 +2901,13 @@ cb_gimmix_playlist_remove ()
 		gtk_tree_model_get (pls_treemodel, &iter,
 							1, &path,
 							-1);
-		mpd_database_delete_playlist (gmo, path);
+		GIMMIX_MPD_CALL ("rm", mpd_database_delete_playlist (gmo, path));
 	}
 	
 	if ((loaded_playlist != NULL) && (strcmp (path, loaded_playlist) == 0))
 			gimmix_current_playlist_clear ();
 	
-	gimmix_update_playlists_treeview ();
+	gimmix_stored_playlists_refresh ();
 	g_free (path);
 	
 	return;
@@ -1979,9 +2929,11 @@ cb_gimmix_playlist_load ()
 		gtk_tree_model_get (pls_treemodel, &iter,
 							1, &path,
 							-1);
-		mpd_playlist_queue_load (gmo, path);
-		gimmix_current_playlist_clear ();
-		mpd_playlist_queue_commit (gmo);
+		GimmixBatch *batch = gimmix_batch_new ();
+
+		gimmix_current_playlist_clear_view (batch);
+		gimmix_batch_load (batch, path);
+		gimmix_batch_commit (batch, NULL, NULL);
 	
 		gimmix_load_playlist (path);
 		g_free (path);
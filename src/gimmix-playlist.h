@@ -18,10 +18,18 @@ void gimmix_playlist_enable_controls (void);
 /* Initialize and populate playlists */
 void gimmix_playlist_init (void);
 
-/* update current playlist depending on the mpd playlist */
-void gimmix_update_current_playlist (MpdObj *mo, MpdData *pdata);
+/* update current playlist depending on the mpd playlist, long queues
+ * are only fetched as far as they are shown */
+void gimmix_update_current_playlist (MpdObj *mo);
 
 /* update library */
 void gimmix_library_update (void);
 
+/* reload the library browser from mpd */
+void gimmix_library_refresh (void);
+
+/* list the stored playlists again, the view is only rebuilt if one of
+ * them was added, removed or modified */
+void gimmix_stored_playlists_refresh (void);
+
 #endif
@@ -27,9 +27,9 @@
 #include "gimmix-interface.h"
 #include "gimmix-covers.h"
 #include "gimmix.h"
+#include "gimmix-stats.h"
 
 extern MpdObj		*gmo;
-extern GtkBuilder	*xml;
 extern ConfigFile	conf;
 
 GtkWidget *pref_window;
@@ -76,10 +76,16 @@ static void	cb_pref_coverart_disp_toggled (GtkToggleButton *button, gpointer dat
 void
 gimmix_prefs_init (void)
 {
+	GtkBuilder		*xml;
 	GtkListStore		*store = NULL;
 	GtkCellRenderer		*renderer = NULL;
 	GtkTreeViewColumn	*column = NULL;
 
+	/* the dialog is only built the first time it is needed */
+	if (pref_window != NULL)
+		return;
+
+	xml = gimmix_ui_load ("gimmix-prefs.ui");
 	pref_window = GTK_WIDGET (gtk_builder_get_object (xml, "prefs_window"));
 	pref_host_entry = GTK_WIDGET (gtk_builder_get_object (xml, "host_entry"));
 	pref_pass_entry = GTK_WIDGET (gtk_builder_get_object (xml, "password_entry"));
@@ -142,6 +148,8 @@ gimmix_prefs_init (void)
 	gtk_tree_view_append_column (GTK_TREE_VIEW(pref_outputdev_tvw), column);
 	
 	gtk_tree_view_set_model (GTK_TREE_VIEW(pref_outputdev_tvw), GTK_TREE_MODEL(store));
+	g_object_unref (store);
+	g_object_unref (xml);
 	
 	return;
 }
@@ -159,6 +167,7 @@ gimmix_prefs_dialog_show (void)
 	GtkTreeModel	*model = NULL;
 	gint		proxy_port;
 	
+	gimmix_prefs_init ();
 	port = g_strdup_printf ("%s", cfg_get_key_value (conf, "mpd_port"));
 
 	gtk_entry_set_text (GTK_ENTRY(pref_host_entry), cfg_get_key_value (conf, "mpd_hostname"));
@@ -233,7 +242,7 @@ gimmix_prefs_dialog_show (void)
 	model = gtk_tree_view_get_model (GTK_TREE_VIEW(pref_outputdev_tvw));
 	store = GTK_LIST_STORE (model);
 	gtk_list_store_clear (store);
-	d = mpd_server_get_output_devices (gmo);
+	GIMMIX_MPD_CALL ("outputs", d = mpd_server_get_output_devices (gmo));
 	while (d!=NULL)
 	{
 		gboolean enabled = d->output_dev->enabled;
@@ -323,7 +332,7 @@ cb_pref_outputdev_enable_toggled (G_GNUC_UNUSED GtkCellRendererToggle *toggle,
 	enabled ^= 1;
 	gtk_list_store_set (GTK_LIST_STORE(model), &iter, 0, enabled, -1);
 	state = (enabled)?1:0;
-	mpd_server_set_output_device (gmo, id, state);
+	GIMMIX_MPD_CALL ("enableoutput", mpd_server_set_output_device (gmo, id, state));
 	
 	return;
 }
@@ -367,11 +376,11 @@ cb_pref_apply_clicked (G_GNUC_UNUSED GtkWidget *widget,
 	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(pref_crossfade_check)))
 	{
 		gint val = gtk_spin_button_get_value (GTK_SPIN_BUTTON(pref_crossfade_spin));
-		mpd_status_set_crossfade (gmo, val);
+		GIMMIX_MPD_CALL ("crossfade", mpd_status_set_crossfade (gmo, val));
 	}
 	else
 	{
-		mpd_status_set_crossfade (gmo, 0);
+		GIMMIX_MPD_CALL ("crossfade", mpd_status_set_crossfade (gmo, 0));
 	}
 	
 	/* proxy server stuff */
@@ -492,9 +501,7 @@ cb_pref_coverart_disp_toggled (GtkToggleButton	     *button,
 {
 	if (gtk_toggle_button_get_active(button) == TRUE)
 	{
-		g_thread_new ("covers_plugin_update_cover",
-				(GThreadFunc)gimmix_covers_plugin_update_cover,
-				NULL);
+		gimmix_covers_plugin_update_cover (FALSE);
 		gtk_widget_show (gimmix_plcbox_frame);
 		cfg_add_key (&conf, "coverart_enable", "true");
 	}
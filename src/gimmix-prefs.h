@@ -7,7 +7,7 @@
 /* Display the preferences dialog */
 void gimmix_prefs_dialog_show (void);
 
-/* Initialize preferences dialog widget */
+/* Build the preferences dialog on first use */
 void gimmix_prefs_init (void);
 
 #endif
@@ -0,0 +1,310 @@
+/*
+ * gimmix-queue.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gimmix-queue.h"
+#include "gimmix-mpdio.h"
+
+/* rows per playlistinfo request */
+#define QUEUE_PAGE_SIZE		128
+
+/* pages loaded around the visible ones */
+#define QUEUE_READ_AHEAD	1
+
+/* pages kept before the least recently used ones are dropped */
+#define QUEUE_CACHE_PAGES	64
+
+typedef struct _gimmix_queue_page {
+	guint		index;
+	gboolean	loaded;
+	GList		*link;		/* in queue_lru */
+} QueuePage;
+
+/* identifies the queue a reply belongs to */
+typedef struct _gimmix_queue_request {
+	guint		generation;
+	guint		index;
+} QueueRequest;
+
+static GimmixQueueFillFunc	queue_fill = NULL;
+static GimmixQueueEvictFunc	queue_evict = NULL;
+static gpointer			queue_data = NULL;
+
+static GHashTable	*queue_pages = NULL;	/* page index -> QueuePage */
+static GQueue		queue_lru = G_QUEUE_INIT;	/* most recently used first */
+static guint		queue_length = 0;
+static guint		queue_generation = 0;
+
+void
+gimmix_queue_init (GimmixQueueFillFunc fill, GimmixQueueEvictFunc evict, gpointer data)
+{
+	queue_fill = fill;
+	queue_evict = evict;
+	queue_data = data;
+	queue_pages = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+	return;
+}
+
+static guint
+gimmix_queue_page_rows (guint index)
+{
+	guint first = index * QUEUE_PAGE_SIZE;
+
+	return MIN (QUEUE_PAGE_SIZE, queue_length - first);
+}
+
+static void
+gimmix_queue_page_drop (QueuePage *page)
+{
+	if (page->loaded && queue_evict != NULL)
+		queue_evict (page->index * QUEUE_PAGE_SIZE, gimmix_queue_page_rows (page->index), queue_data);
+	g_queue_delete_link (&queue_lru, page->link);
+	g_hash_table_remove (queue_pages, GUINT_TO_POINTER (page->index));
+
+	return;
+}
+
+void
+gimmix_queue_reset (guint length)
+{
+	if (queue_pages == NULL)
+		return;
+
+	/* the rows are rebuilt by the caller, nothing to evict */
+	g_hash_table_remove_all (queue_pages);
+	g_queue_clear (&queue_lru);
+	queue_length = length;
+	queue_generation++;
+
+	return;
+}
+
+GPtrArray *
+gimmix_queue_parse (const GimmixMpdReply *reply)
+{
+	GPtrArray	*songs;
+	mpd_Song	*song = NULL;
+	guint		i;
+
+	songs = g_ptr_array_new_with_free_func ((GDestroyNotify)mpd_freeSong);
+	for (i = 0; reply->lines[i] != NULL; i++)
+	{
+		const char	*line = reply->lines[i];
+		const char	*value = strstr (line, ": ");
+
+		if (value == NULL)
+			continue;
+		value += 2;
+		if (!strncmp (line, "file: ", 6))
+		{
+			song = mpd_newSong ();
+			song->file = strdup (value);
+			g_ptr_array_add (songs, song);
+		}
+		else if (song == NULL)
+			continue;
+		else if (!strncmp (line, "Title: ", 7) && song->title == NULL)
+			song->title = strdup (value);
+		else if (!strncmp (line, "Artist: ", 8) && song->artist == NULL)
+			song->artist = strdup (value);
+		else if (!strncmp (line, "Album: ", 7) && song->album == NULL)
+			song->album = strdup (value);
+		else if (!strncmp (line, "Time: ", 6))
+			song->time = atoi (value);
+		else if (!strncmp (line, "Pos: ", 5))
+			song->pos = atoi (value);
+		else if (!strncmp (line, "Id: ", 4))
+			song->id = atoi (value);
+	}
+
+	return songs;
+}
+
+static void
+gimmix_queue_page_done (const GimmixMpdReply *reply, gpointer data)
+{
+	QueueRequest	*req = data;
+	QueuePage	*page;
+	GPtrArray	*songs;
+
+	/* the queue changed while the page was on its way */
+	if (req->generation != queue_generation ||
+		(page = g_hash_table_lookup (queue_pages, GUINT_TO_POINTER (req->index))) == NULL)
+	{
+		g_free (req);
+		return;
+	}
+	g_free (req);
+
+	if (!reply->ok)
+	{
+		/* try again when it is needed next time */
+		fprintf (stderr, "queue: %s\n", reply->error);
+		gimmix_queue_page_drop (page);
+		return;
+	}
+
+	songs = gimmix_queue_parse (reply);
+	page->loaded = TRUE;
+	if (queue_fill != NULL)
+		queue_fill (page->index * QUEUE_PAGE_SIZE, songs, queue_data);
+	g_ptr_array_free (songs, TRUE);
+
+	return;
+}
+
+static void
+gimmix_queue_page_load (guint index)
+{
+	QueuePage	*page;
+	QueueRequest	*req;
+	guint		first;
+
+	page = g_hash_table_lookup (queue_pages, GUINT_TO_POINTER (index));
+	if (page != NULL)
+	{
+		/* already there or on its way, just mark it as used */
+		g_queue_unlink (&queue_lru, page->link);
+		g_queue_push_head_link (&queue_lru, page->link);
+		return;
+	}
+
+	/* make room, the tail has not been looked at for the longest time */
+	while (queue_lru.length >= QUEUE_CACHE_PAGES)
+		gimmix_queue_page_drop (g_queue_peek_tail (&queue_lru));
+
+	page = g_new0 (QueuePage, 1);
+	page->index = index;
+	g_queue_push_head (&queue_lru, page);
+	page->link = g_queue_peek_head_link (&queue_lru);
+	g_hash_table_insert (queue_pages, GUINT_TO_POINTER (index), page);
+
+	req = g_new (QueueRequest, 1);
+	req->generation = queue_generation;
+	req->index = index;
+	first = index * QUEUE_PAGE_SIZE;
+	gimmix_mpdio_command (gimmix_queue_page_done, req, "playlistinfo %u:%u",
+			first, first + gimmix_queue_page_rows (index));
+
+	return;
+}
+
+void
+gimmix_queue_request (guint first, guint last)
+{
+	guint	start;
+	guint	end;
+	guint	i;
+
+	if (queue_pages == NULL || queue_length == 0)
+		return;
+
+	last = MIN (last, queue_length - 1);
+	start = first / QUEUE_PAGE_SIZE;
+	end = last / QUEUE_PAGE_SIZE + QUEUE_READ_AHEAD;
+	start = (start > QUEUE_READ_AHEAD) ? start - QUEUE_READ_AHEAD : 0;
+	end = MIN (end, (queue_length - 1) / QUEUE_PAGE_SIZE);
+
+	/* the read-ahead pages first so the visible ones end up at the
+	 * head of the lru list */
+	for (i = start; i <= end; i++)
+	{
+		if (i * QUEUE_PAGE_SIZE + QUEUE_PAGE_SIZE <= first || i * QUEUE_PAGE_SIZE > last)
+			gimmix_queue_page_load (i);
+	}
+	for (i = first / QUEUE_PAGE_SIZE; i <= last / QUEUE_PAGE_SIZE; i++)
+		gimmix_queue_page_load (i);
+
+	return;
+}
+
+void
+gimmix_queue_update (guint length, const GArray *changed)
+{
+	GHashTableIter	iter;
+	QueuePage	*page;
+	GHashTable	*stale;
+	GList		*reload = NULL;
+	GList		*l;
+	guint		pages;
+	guint		i;
+
+	if (queue_pages == NULL)
+		return;
+
+	/* the pages holding a changed row, and the last one if the
+	 * length changed since it is not full any more or now overflows */
+	stale = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; i < changed->len; i++)
+		g_hash_table_add (stale, GUINT_TO_POINTER (g_array_index (changed, guint, i) / QUEUE_PAGE_SIZE));
+	if (length != queue_length && queue_length > 0)
+		g_hash_table_add (stale, GUINT_TO_POINTER ((queue_length - 1) / QUEUE_PAGE_SIZE));
+	pages = (length + QUEUE_PAGE_SIZE - 1) / QUEUE_PAGE_SIZE;
+
+	/* Pages on their way may show the queue from before, they are
+	 * requested again when needed. Loaded pages that changed keep
+	 * showing the old rows until they are back. */
+	g_hash_table_iter_init (&iter, queue_pages);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer*)&page))
+	{
+		if (page->loaded && page->index < pages && !g_hash_table_contains (stale, GUINT_TO_POINTER (page->index)))
+			continue;
+		if (page->loaded && page->index < pages)
+			reload = g_list_prepend (reload, GUINT_TO_POINTER (page->index));
+		g_queue_delete_link (&queue_lru, page->link);
+		g_hash_table_iter_remove (&iter);
+	}
+	g_hash_table_destroy (stale);
+
+	queue_length = length;
+	queue_generation++;
+	for (l = reload; l != NULL; l = l->next)
+		gimmix_queue_page_load (GPOINTER_TO_UINT (l->data));
+	g_list_free (reload);
+
+	return;
+}
+
+void
+gimmix_queue_invalidate (guint pos)
+{
+	QueuePage *page;
+
+	if (queue_pages == NULL || pos >= queue_length)
+		return;
+
+	page = g_hash_table_lookup (queue_pages, GUINT_TO_POINTER (pos / QUEUE_PAGE_SIZE));
+	if (page == NULL)
+		return;
+
+	/* the rows keep showing the old values until the page is back */
+	g_queue_delete_link (&queue_lru, page->link);
+	g_hash_table_remove (queue_pages, GUINT_TO_POINTER (page->index));
+	gimmix_queue_page_load (pos / QUEUE_PAGE_SIZE);
+
+	return;
+}
@@ -0,0 +1,41 @@
+#ifndef GIMMIX_QUEUE_H
+#define GIMMIX_QUEUE_H
+
+#include <glib.h>
+#include <libmpd/libmpd.h>
+
+#include "gimmix-mpdio.h"
+
+/* Windowed fetching of very long queues. Only the rows around the
+ * visible part of the view are requested from mpd, one page per ranged
+ * playlistinfo, and the least recently used pages are dropped once too
+ * many are loaded. */
+
+/* A page has arrived: songs (mpd_Song *) are the rows starting at first.
+ * The array is freed after the call. */
+typedef void (*GimmixQueueFillFunc) (guint first, GPtrArray *songs, gpointer data);
+
+/* A page has been dropped, rows first to first + n - 1 can be cleared */
+typedef void (*GimmixQueueEvictFunc) (guint first, guint n, gpointer data);
+
+void gimmix_queue_init (GimmixQueueFillFunc fill, GimmixQueueEvictFunc evict, gpointer data);
+
+/* forget all pages, the queue now has length rows */
+void gimmix_queue_reset (guint length);
+
+/* make sure rows first to last and some around them are loaded */
+void gimmix_queue_request (guint first, guint last);
+
+/* fetch the page containing row pos again, if it is loaded */
+void gimmix_queue_invalidate (guint pos);
+
+/* the queue now has length rows and the rows at the positions in
+ * changed (guint) hold other songs. Only the loaded pages with a
+ * changed row are fetched again, the caller adjusts the row count */
+void gimmix_queue_update (guint length, const GArray *changed);
+
+/* the songs (mpd_Song *) of a playlistinfo or search reply, the array
+ * frees them with itself */
+GPtrArray *gimmix_queue_parse (const GimmixMpdReply *reply);
+
+#endif
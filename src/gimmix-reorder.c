@@ -0,0 +1,239 @@
+/*
+ * gimmix-reorder.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "gimmix-reorder.h"
+
+/* Fenwick tree over the slots a song can be in, to count the songs in
+ * front of one as the queue changes */
+static void
+reorder_tree_add (gint *tree, guint size, guint slot, gint delta)
+{
+	for (slot++; slot <= size; slot += slot & -slot)
+		tree[slot - 1] += delta;
+
+	return;
+}
+
+static gint
+reorder_tree_count_before (const gint *tree, guint slot)
+{
+	gint count = 0;
+
+	for (; slot > 0; slot -= slot & -slot)
+		count += tree[slot - 1];
+
+	return count;
+}
+
+/* Marks in stay the songs of a longest increasing run of rank (the
+ * target positions in current order), through keep if that is one of
+ * the longest. O(n log n), with the tails of the runs found so far. */
+static void
+reorder_longest_run (const guint *rank, guint n, gint keep, gboolean *stay)
+{
+	gint	*len_end = g_new (gint, n);	/* longest run ending at i */
+	gint	*len_start = g_new (gint, n);	/* longest run starting at i */
+	gint	*pred = g_new (gint, n);
+	gint	*succ = g_new (gint, n);
+	guint	*tails = g_new (guint, n);
+	guint	len = 0;
+	guint	lo, hi, mid;
+	gint	best = 0;
+	gint	end = -1;
+	gint	i;
+
+	for (i = 0; i < (gint)n; i++)
+	{
+		for (lo = 0, hi = len; lo < hi; )
+		{
+			mid = (lo + hi) / 2;
+			if (rank[tails[mid]] < rank[i])
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		pred[i] = (lo > 0) ? (gint)tails[lo - 1] : -1;
+		tails[lo] = i;
+		len_end[i] = lo + 1;
+		if (lo == len)
+			len++;
+		if (len_end[i] > best)
+		{
+			best = len_end[i];
+			end = i;
+		}
+	}
+
+	/* the same from the back, for the runs that start at a song */
+	for (i = n - 1, len = 0; i >= 0; i--)
+	{
+		for (lo = 0, hi = len; lo < hi; )
+		{
+			mid = (lo + hi) / 2;
+			if (rank[tails[mid]] > rank[i])
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		succ[i] = (lo > 0) ? (gint)tails[lo - 1] : -1;
+		tails[lo] = i;
+		len_start[i] = lo + 1;
+		if (lo == len)
+			len++;
+	}
+
+	memset (stay, 0, n * sizeof (gboolean));
+	if (keep >= 0 && len_end[keep] + len_start[keep] - 1 == best)
+	{
+		for (i = succ[keep]; i >= 0; i = succ[i])
+			stay[i] = TRUE;
+		end = keep;
+	}
+	for (i = end; i >= 0; i = pred[i])
+		stay[i] = TRUE;
+
+	g_free (len_end);
+	g_free (len_start);
+	g_free (pred);
+	g_free (succ);
+	g_free (tails);
+
+	return;
+}
+
+GArray *
+gimmix_reorder_plan (const gint *current, const gint *target, guint n, gint keep)
+{
+	GHashTable		*index;
+	GArray			*moves;
+	guint			*rank;		/* target position of current[i] */
+	guint			*where;		/* current position of target[k] */
+	gboolean		*stay;
+	guint			*old_slot;
+	guint			*new_slot;
+	gint			*tree;
+	gint			keep_pos = -1;
+	guint			slots = 0;
+	guint			i, k;
+	gpointer		value;
+
+	moves = g_array_new (FALSE, FALSE, sizeof (GimmixReorderMove));
+	if (n == 0)
+		return moves;
+
+	index = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (k = 0; k < n; k++)
+		g_hash_table_insert (index, GINT_TO_POINTER(target[k]), GUINT_TO_POINTER(k));
+	rank = g_new (guint, n);
+	where = g_new (guint, n);
+	for (i = 0; i < n; i++)
+	{
+		if (!g_hash_table_lookup_extended (index, GINT_TO_POINTER(current[i]), NULL, &value))
+			break;
+		g_hash_table_remove (index, GINT_TO_POINTER(current[i]));
+		rank[i] = GPOINTER_TO_UINT (value);
+		where[rank[i]] = i;
+		if (current[i] == keep)
+			keep_pos = i;
+	}
+	g_hash_table_destroy (index);
+	if (i < n)
+	{
+		/* a song is missing or there twice */
+		g_free (rank);
+		g_free (where);
+		g_array_free (moves, TRUE);
+		return NULL;
+	}
+
+	stay = g_new (gboolean, n);
+	reorder_longest_run (rank, n, keep_pos, stay);
+
+	/* Every song that moves ends up right behind its predecessor in
+	 * the target, so the slots can be laid out in advance: the moved
+	 * songs that come before the first staying one, then each song's
+	 * current slot, followed by the songs moved behind it if it stays. */
+	old_slot = g_new (guint, n);
+	new_slot = g_new (guint, n);
+	for (k = 0; k < n && !stay[where[k]]; k++)
+		new_slot[k] = slots++;
+	for (i = 0; i < n; i++)
+	{
+		old_slot[i] = slots++;
+		if (!stay[i])
+			continue;
+		for (k = rank[i] + 1; k < n && !stay[where[k]]; k++)
+			new_slot[k] = slots++;
+	}
+
+	tree = g_new0 (gint, slots);
+	for (i = 0; i < n; i++)
+		reorder_tree_add (tree, slots, old_slot[i], 1);
+
+	/* in target order, so a song's predecessor is in place before it */
+	for (k = 0; k < n; k++)
+	{
+		GimmixReorderMove move;
+
+		i = where[k];
+		if (stay[i])
+			continue;
+		reorder_tree_add (tree, slots, old_slot[i], -1);
+		move.id = current[i];
+		move.pos = reorder_tree_count_before (tree, new_slot[k]);
+		reorder_tree_add (tree, slots, new_slot[k], 1);
+		g_array_append_val (moves, move);
+	}
+
+	g_free (rank);
+	g_free (where);
+	g_free (stay);
+	g_free (old_slot);
+	g_free (new_slot);
+	g_free (tree);
+
+	return moves;
+}
+
+gint
+gimmix_reorder_batch (GimmixBatch *batch, const gint *current, const gint *target, guint n, gint keep)
+{
+	GArray	*moves;
+	gint	count;
+	guint	i;
+
+	if ((moves = gimmix_reorder_plan (current, target, n, keep)) == NULL)
+		return -1;
+
+	for (i = 0; i < moves->len; i++)
+	{
+		GimmixReorderMove *move = &g_array_index (moves, GimmixReorderMove, i);
+
+		gimmix_batch_move_id (batch, move->id, move->pos);
+	}
+	count = moves->len;
+	g_array_free (moves, TRUE);
+
+	return count;
+}
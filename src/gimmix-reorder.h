@@ -0,0 +1,28 @@
+#ifndef GIMMIX_REORDER_H
+#define GIMMIX_REORDER_H
+
+#include <glib.h>
+
+#include "gimmix-batch.h"
+
+/* Turns the server queue into another order of the same songs with as
+ * few moves as possible. The songs along a longest run that is already
+ * in target order stay where they are, every other song is moved once,
+ * right behind the song that precedes it in the target. */
+
+typedef struct _gimmix_reorder_move {
+	gint	id;
+	gint	pos;	/* for "moveid id pos", at the time it is sent */
+} GimmixReorderMove;
+
+/* current and target are the same n song ids in two orders. If it
+ * costs no extra move, the song keep (e.g. the playing one, -1 for
+ * none) is left in place. Returns the moves in the order they have to
+ * be sent, or NULL if target is not a reordering of current. */
+GArray *gimmix_reorder_plan (const gint *current, const gint *target, guint n, gint keep);
+
+/* queue the moves of the plan on batch, returns their number or -1 if
+ * target is not a reordering of current */
+gint gimmix_reorder_batch (GimmixBatch *batch, const gint *current, const gint *target, guint n, gint keep);
+
+#endif
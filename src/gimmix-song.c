@@ -0,0 +1,105 @@
+/*
+ * gimmix-song.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gimmix-song.h"
+#include "gimmix-intern.h"
+
+/* the snapshot of the playing song, only touched from the main loop */
+static GimmixSong	*current_song = NULL;
+
+GimmixSong *
+gimmix_song_new (const mpd_Song *song)
+{
+	GimmixSong *ret;
+
+	ret = g_new0 (GimmixSong, 1);
+	ret->refs = 1;
+	ret->file = g_strdup (song->file);
+	ret->title = g_strdup (song->title);
+	ret->date = g_strdup (song->date);
+	ret->track = g_strdup (song->track);
+	/* shared with every other copy of these tags */
+	ret->artist = gimmix_intern (song->artist);
+	ret->album = gimmix_intern (song->album);
+	ret->performer = gimmix_intern (song->performer);
+	ret->genre = gimmix_intern (song->genre);
+	ret->time = song->time;
+	ret->pos = song->pos;
+	ret->id = song->id;
+
+	return ret;
+}
+
+GimmixSong *
+gimmix_song_ref (GimmixSong *song)
+{
+	if (song != NULL)
+		g_atomic_int_inc (&song->refs);
+
+	return song;
+}
+
+void
+gimmix_song_unref (GimmixSong *song)
+{
+	if (song == NULL || !g_atomic_int_dec_and_test (&song->refs))
+		return;
+
+	g_free ((gchar*)song->file);
+	g_free ((gchar*)song->title);
+	g_free ((gchar*)song->date);
+	g_free ((gchar*)song->track);
+	gimmix_intern_unref (song->artist);
+	gimmix_intern_unref (song->album);
+	gimmix_intern_unref (song->performer);
+	gimmix_intern_unref (song->genre);
+	g_free (song);
+
+	return;
+}
+
+void
+gimmix_song_set_current (const mpd_Song *song)
+{
+	if (song == NULL)
+		return;
+
+	/* same song, and its tags were not edited meanwhile */
+	if (current_song != NULL && current_song->id == song->id &&
+		!g_strcmp0 (current_song->file, song->file) &&
+		!g_strcmp0 (current_song->title, song->title) &&
+		!g_strcmp0 (current_song->artist, song->artist) &&
+		!g_strcmp0 (current_song->album, song->album))
+		return;
+
+	/* whoever still holds the old snapshot keeps it alive */
+	gimmix_song_unref (current_song);
+	current_song = gimmix_song_new (song);
+
+	return;
+}
+
+GimmixSong *
+gimmix_song_get_current (void)
+{
+	return gimmix_song_ref (current_song);
+}
@@ -0,0 +1,42 @@
+#ifndef GIMMIX_SONG_H
+#define GIMMIX_SONG_H
+
+#include <glib.h>
+#include <libmpd/libmpd.h>
+
+/* An immutable, reference counted copy of a song. The playing song is
+ * copied once when it changes and the same snapshot is handed to the
+ * song labels, the tray tooltip, the metadata panel, covers, lyrics and
+ * the tag editor, threads included. Tag values come from the string
+ * pool (see gimmix-intern.h). */
+typedef struct _gimmix_song {
+	const gchar	*file;
+	const gchar	*title;
+	const gchar	*artist;
+	const gchar	*album;
+	const gchar	*performer;
+	const gchar	*genre;
+	const gchar	*date;
+	const gchar	*track;
+	gint		time;
+	gint		pos;
+	gint		id;
+	/*< private >*/
+	gint		refs;
+} GimmixSong;
+
+/* copy a libmpd song, the snapshot starts with one reference */
+GimmixSong *gimmix_song_new (const mpd_Song *song);
+
+/* may be called from any thread, NULL is ignored */
+GimmixSong *gimmix_song_ref (GimmixSong *song);
+void gimmix_song_unref (GimmixSong *song);
+
+/* take a new snapshot of the playing song if it is a different one
+ * than last time, NULL keeps the previous one */
+void gimmix_song_set_current (const mpd_Song *song);
+
+/* a new reference to the playing song, or NULL */
+GimmixSong *gimmix_song_get_current (void);
+
+#endif
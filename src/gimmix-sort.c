@@ -0,0 +1,250 @@
+/*
+ * gimmix-sort.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "gimmix-sort.h"
+#include "gimmix-intern.h"
+
+typedef struct _sort_key {
+	gint		pos;
+	gint		time;
+	gchar		*file;
+	gchar		*title;		/* as given, to notice retagged songs */
+	const gchar	*artist;	/* pooled, compared by pointer */
+	const gchar	*album;
+	gchar		*title_key;
+	gchar		*artist_key;
+	gchar		*album_key;
+	guint		generation;
+} SortKey;
+
+struct _gimmix_sort_cache {
+	GHashTable	*keys;		/* id -> SortKey */
+	guint		generation;
+};
+
+typedef struct _sort_job {
+	SortKey			**rows;
+	GimmixSortColumn	column;
+	gint			sign;
+} SortJob;
+
+static void
+sort_key_free (SortKey *key)
+{
+	g_free (key->file);
+	g_free (key->title);
+	gimmix_intern_unref (key->artist);
+	gimmix_intern_unref (key->album);
+	g_free (key->title_key);
+	g_free (key->artist_key);
+	g_free (key->album_key);
+	g_slice_free (SortKey, key);
+
+	return;
+}
+
+/* untitled songs are sorted by their file name, numbers in it by value */
+static gchar *
+sort_title_key (const gchar *file, const gchar *title)
+{
+	const gchar	*name;
+	const gchar	*ext;
+	gchar		*base;
+	gchar		*key;
+
+	if (title != NULL)
+		return g_utf8_collate_key (title, -1);
+
+	name = strrchr (file, '/');
+	name = (name != NULL) ? name + 1 : file;
+	ext = strrchr (name, '.');
+	base = g_strndup (name, (ext != NULL) ? (gsize)(ext - name) : strlen (name));
+	key = g_utf8_collate_key_for_filename (base, -1);
+	g_free (base);
+
+	return key;
+}
+
+GimmixSortCache *
+gimmix_sort_cache_new (void)
+{
+	GimmixSortCache *cache;
+
+	cache = g_new0 (GimmixSortCache, 1);
+	cache->keys = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)sort_key_free);
+
+	return cache;
+}
+
+void
+gimmix_sort_cache_begin (GimmixSortCache *cache)
+{
+	cache->generation++;
+
+	return;
+}
+
+void
+gimmix_sort_cache_set (GimmixSortCache *cache,
+			gint id,
+			gint pos,
+			const gchar *file,
+			const gchar *title,
+			const gchar *artist,
+			const gchar *album,
+			gint time)
+{
+	SortKey		*key;
+	const gchar	*iartist;
+	const gchar	*ialbum;
+
+	if (file == NULL)
+		file = "";
+	iartist = gimmix_intern (artist);
+	ialbum = gimmix_intern (album);
+	key = g_hash_table_lookup (cache->keys, GINT_TO_POINTER(id));
+	if (key != NULL &&
+		key->artist == iartist &&
+		key->album == ialbum &&
+		!strcmp (key->file, file) &&
+		!g_strcmp0 (key->title, title))
+	{
+		/* nothing to collate, the song only moved */
+		gimmix_intern_unref (iartist);
+		gimmix_intern_unref (ialbum);
+		key->pos = pos;
+		key->time = time;
+		key->generation = cache->generation;
+		return;
+	}
+
+	key = g_slice_new (SortKey);
+	key->pos = pos;
+	key->time = time;
+	key->file = g_strdup (file);
+	key->title = g_strdup (title);
+	key->artist = iartist;
+	key->album = ialbum;
+	key->title_key = sort_title_key (file, title);
+	key->artist_key = g_utf8_collate_key ((artist != NULL) ? artist : "", -1);
+	key->album_key = g_utf8_collate_key ((album != NULL) ? album : "", -1);
+	key->generation = cache->generation;
+	g_hash_table_replace (cache->keys, GINT_TO_POINTER(id), key);
+
+	return;
+}
+
+static gboolean
+sort_key_is_stale (G_GNUC_UNUSED gpointer id, SortKey *key, GimmixSortCache *cache)
+{
+	return key->generation != cache->generation;
+}
+
+void
+gimmix_sort_cache_end (GimmixSortCache *cache)
+{
+	g_hash_table_foreach_remove (cache->keys, (GHRFunc)sort_key_is_stale, cache);
+
+	return;
+}
+
+static gint
+sort_compare_rows (gconstpointer a, gconstpointer b, gpointer data)
+{
+	SortJob	*job = data;
+	gint	ia = *(const gint*)a;
+	gint	ib = *(const gint*)b;
+	SortKey	*ka = job->rows[ia];
+	SortKey	*kb = job->rows[ib];
+	gint	res = 0;
+
+	if (ka == NULL || kb == NULL)
+	{
+		if (ka != kb)
+			return (ka == NULL) ? 1 : -1;
+		return ia - ib;
+	}
+
+	switch (job->column)
+	{
+		case GIMMIX_SORT_TITLE:
+			res = strcmp (ka->title_key, kb->title_key);
+			break;
+		case GIMMIX_SORT_ARTIST:
+			/* the albums of an artist stay together */
+			if ((res = strcmp (ka->artist_key, kb->artist_key)) == 0)
+				res = strcmp (ka->album_key, kb->album_key);
+			break;
+		case GIMMIX_SORT_ALBUM:
+			res = strcmp (ka->album_key, kb->album_key);
+			break;
+		case GIMMIX_SORT_LENGTH:
+			res = (ka->time > kb->time) - (ka->time < kb->time);
+			break;
+		case GIMMIX_SORT_NONE:
+			res = ka->pos - kb->pos;
+			break;
+	}
+
+	/* ties keep the order the rows had */
+	return (res != 0) ? res * job->sign : ia - ib;
+}
+
+gint *
+gimmix_sort_cache_order (GimmixSortCache *cache,
+			const gint *ids,
+			guint n,
+			GimmixSortColumn column,
+			gboolean descending)
+{
+	SortJob	job;
+	gint	*order;
+	guint	i;
+
+	job.rows = g_new (SortKey*, n);
+	job.column = column;
+	job.sign = descending ? -1 : 1;
+	order = g_new (gint, n);
+	for (i = 0; i < n; i++)
+	{
+		job.rows[i] = g_hash_table_lookup (cache->keys, GINT_TO_POINTER(ids[i]));
+		order[i] = i;
+	}
+	g_qsort_with_data (order, n, sizeof (gint), sort_compare_rows, &job);
+	g_free (job.rows);
+
+	return order;
+}
+
+void
+gimmix_sort_cache_free (GimmixSortCache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	g_hash_table_destroy (cache->keys);
+	g_free (cache);
+
+	return;
+}
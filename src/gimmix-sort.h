@@ -0,0 +1,47 @@
+#ifndef GIMMIX_SORT_H
+#define GIMMIX_SORT_H
+
+#include <glib.h>
+
+/* Sort keys for the rows of the queue view, kept per song id. The
+ * collation keys of a song are made once, when it is first seen or its
+ * tags change, so sorting the view again only compares bytes. */
+
+typedef enum {
+	GIMMIX_SORT_NONE = 0,	/* the order of the server queue */
+	GIMMIX_SORT_TITLE,
+	GIMMIX_SORT_ARTIST,
+	GIMMIX_SORT_ALBUM,
+	GIMMIX_SORT_LENGTH
+} GimmixSortColumn;
+
+typedef struct _gimmix_sort_cache GimmixSortCache;
+
+GimmixSortCache *gimmix_sort_cache_new (void);
+
+/* Songs are given between begin and end, every song of the queue once
+ * per refresh. Songs that were not given again are dropped at end. */
+void gimmix_sort_cache_begin (GimmixSortCache *cache);
+void gimmix_sort_cache_set (GimmixSortCache *cache,
+			gint id,
+			gint pos,
+			const gchar *file,
+			const gchar *title,
+			const gchar *artist,
+			const gchar *album,
+			gint time);
+void gimmix_sort_cache_end (GimmixSortCache *cache);
+
+/* The order of n rows showing the songs ids when sorted by column.
+ * Element i of the result is the index in ids of the row that goes to
+ * position i, as gtk_list_store_reorder() wants it. Equal rows keep
+ * their order, ids that are not in the cache go last. g_free() it. */
+gint *gimmix_sort_cache_order (GimmixSortCache *cache,
+			const gint *ids,
+			guint n,
+			GimmixSortColumn column,
+			gboolean descending);
+
+void gimmix_sort_cache_free (GimmixSortCache *cache);
+
+#endif
@@ -0,0 +1,323 @@
+/*
+ * gimmix-stats.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+
+#include "gimmix.h"
+#include "gimmix-stats.h"
+#include "gimmix-trace.h"
+
+/* upper bounds of the latency buckets in microseconds, anything
+ * slower ends up in the last bucket */
+static const gint64 stats_bucket_limit[] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+#define STATS_BUCKETS	(G_N_ELEMENTS (stats_bucket_limit) + 1)
+
+typedef struct _command_stats {
+	const char	*name;
+	guint		count;
+	gint64		total;
+	gint64		max;
+	guint		buckets[STATS_BUCKETS];
+	/* since the last log line */
+	guint		window_count;
+	gint64		window_total;
+} CommandStats;
+
+enum {
+	STATS_COLUMN_NAME,
+	STATS_COLUMN_COUNT,
+	STATS_COLUMN_AVG,
+	STATS_COLUMN_P50,
+	STATS_COLUMN_P99,
+	STATS_COLUMN_MAX,
+	STATS_COLUMNS
+};
+
+/* name -> CommandStats */
+static GHashTable	*stats_table = NULL;
+static GMutex		stats_mutex;
+static guint		stats_interval = 0;
+
+static GtkWidget	*stats_dialog = NULL;
+static GtkListStore	*stats_store = NULL;
+static guint		stats_refresh_source = 0;
+
+static gboolean gimmix_stats_log (gpointer data);
+
+void
+gimmix_stats_init (void)
+{
+	const char *interval = g_getenv ("GIMMIX_STATS");
+
+	if (interval != NULL && atoi (interval) > 0)
+	{
+		stats_interval = atoi (interval);
+		g_timeout_add_seconds (stats_interval, gimmix_stats_log, NULL);
+	}
+
+	return;
+}
+
+void
+gimmix_stats_record (const char *name, gint64 start)
+{
+	CommandStats	*cs;
+	gint64		usec;
+	guint		i;
+
+	usec = g_get_monotonic_time () - start;
+	gimmix_trace_event ("mpd", name, start);
+
+	for (i = 0; i < STATS_BUCKETS - 1; i++)
+	{
+		if (usec <= stats_bucket_limit[i])
+			break;
+	}
+
+	g_mutex_lock (&stats_mutex);
+	if (stats_table == NULL)
+		stats_table = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+	cs = g_hash_table_lookup (stats_table, name);
+	if (cs == NULL)
+	{
+		cs = g_new0 (CommandStats, 1);
+		cs->name = name;
+		g_hash_table_insert (stats_table, (gpointer)name, cs);
+	}
+	cs->count++;
+	cs->total += usec;
+	cs->max = MAX (cs->max, usec);
+	cs->buckets[i]++;
+	cs->window_count++;
+	cs->window_total += usec;
+	g_mutex_unlock (&stats_mutex);
+
+	return;
+}
+
+/* upper bound of the bucket holding the given fraction of the calls */
+static gint64
+gimmix_stats_percentile (const CommandStats *cs, gdouble fraction)
+{
+	guint	need;
+	guint	seen = 0;
+	guint	i;
+
+	need = MAX (1, (guint)(cs->count * fraction + 0.5));
+	for (i = 0; i < STATS_BUCKETS - 1; i++)
+	{
+		seen += cs->buckets[i];
+		if (seen >= need)
+			return MIN (stats_bucket_limit[i], cs->max);
+	}
+
+	return cs->max;
+}
+
+static gint
+gimmix_stats_compare_count (gconstpointer a, gconstpointer b)
+{
+	const CommandStats *ca = a;
+	const CommandStats *cb = b;
+
+	return (gint)cb->window_count - (gint)ca->window_count;
+}
+
+static gboolean
+gimmix_stats_log (G_GNUC_UNUSED gpointer data)
+{
+	GString	*line;
+	GList	*list;
+	GList	*l;
+	guint	total = 0;
+
+	g_mutex_lock (&stats_mutex);
+	list = stats_table ? g_hash_table_get_values (stats_table) : NULL;
+	list = g_list_sort (list, gimmix_stats_compare_count);
+	line = g_string_new (NULL);
+	for (l = list; l != NULL; l = l->next)
+	{
+		CommandStats *cs = l->data;
+
+		if (cs->window_count == 0)
+			continue;
+		total += cs->window_count;
+		g_string_append_printf (line, " %s %u (avg %.1f ms)",
+				cs->name,
+				cs->window_count,
+				cs->window_total / 1000.0 / cs->window_count);
+		cs->window_count = 0;
+		cs->window_total = 0;
+	}
+	g_mutex_unlock (&stats_mutex);
+	g_list_free (list);
+
+	g_message ("mpd: %u commands in %us:%s", total, stats_interval, line->str);
+	g_string_free (line, TRUE);
+
+	return TRUE;
+}
+
+static gchar *
+gimmix_stats_format_ms (gint64 usec)
+{
+	return g_strdup_printf ("%.2f", usec / 1000.0);
+}
+
+static gboolean
+gimmix_stats_dialog_refresh (G_GNUC_UNUSED gpointer data)
+{
+	GHashTableIter	iter;
+	CommandStats	*cs;
+	GtkTreeIter	row;
+
+	gtk_list_store_clear (stats_store);
+
+	g_mutex_lock (&stats_mutex);
+	if (stats_table != NULL)
+	{
+		g_hash_table_iter_init (&iter, stats_table);
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer*)&cs))
+		{
+			gchar *avg = gimmix_stats_format_ms (cs->total / MAX (cs->count, 1));
+			gchar *p50 = gimmix_stats_format_ms (gimmix_stats_percentile (cs, 0.5));
+			gchar *p99 = gimmix_stats_format_ms (gimmix_stats_percentile (cs, 0.99));
+			gchar *max = gimmix_stats_format_ms (cs->max);
+
+			gtk_list_store_append (stats_store, &row);
+			gtk_list_store_set (stats_store, &row,
+					STATS_COLUMN_NAME, cs->name,
+					STATS_COLUMN_COUNT, cs->count,
+					STATS_COLUMN_AVG, avg,
+					STATS_COLUMN_P50, p50,
+					STATS_COLUMN_P99, p99,
+					STATS_COLUMN_MAX, max,
+					-1);
+			g_free (avg);
+			g_free (p50);
+			g_free (p99);
+			g_free (max);
+		}
+	}
+	g_mutex_unlock (&stats_mutex);
+
+	return TRUE;
+}
+
+static void
+cb_gimmix_stats_dialog_response (GtkDialog		*dialog,
+				 gint			response,
+				 G_GNUC_UNUSED gpointer	data)
+{
+	if (response == GTK_RESPONSE_REJECT)
+	{
+		/* reset the counters */
+		g_mutex_lock (&stats_mutex);
+		if (stats_table != NULL)
+			g_hash_table_remove_all (stats_table);
+		g_mutex_unlock (&stats_mutex);
+		gimmix_stats_dialog_refresh (NULL);
+		return;
+	}
+
+	g_source_remove (stats_refresh_source);
+	stats_refresh_source = 0;
+	gtk_widget_destroy (GTK_WIDGET(dialog));
+	stats_dialog = NULL;
+	stats_store = NULL;
+
+	return;
+}
+
+static void
+gimmix_stats_add_column (GtkWidget *treeview, const gchar *title, gint column)
+{
+	GtkCellRenderer		*renderer;
+	GtkTreeViewColumn	*col;
+
+	renderer = gtk_cell_renderer_text_new ();
+	if (column != STATS_COLUMN_NAME)
+		g_object_set (G_OBJECT(renderer), "xalign", 1.0, NULL);
+	col = gtk_tree_view_column_new_with_attributes (title, renderer, "text", column, NULL);
+	gtk_tree_view_column_set_sort_column_id (col, column);
+	gtk_tree_view_append_column (GTK_TREE_VIEW(treeview), col);
+
+	return;
+}
+
+void
+gimmix_stats_dialog_show (GtkWindow *parent)
+{
+	GtkWidget	*scrolled;
+	GtkWidget	*treeview;
+
+	if (stats_dialog != NULL)
+	{
+		gtk_window_present (GTK_WINDOW(stats_dialog));
+		return;
+	}
+
+	stats_dialog = gtk_dialog_new_with_buttons (_("MPD command statistics"),
+					parent,
+					GTK_DIALOG_DESTROY_WITH_PARENT,
+					_("Reset"),
+					GTK_RESPONSE_REJECT,
+					GTK_STOCK_CLOSE,
+					GTK_RESPONSE_CLOSE,
+					NULL);
+	gtk_window_set_default_size (GTK_WINDOW(stats_dialog), 480, 320);
+
+	stats_store = gtk_list_store_new (STATS_COLUMNS,
+					G_TYPE_STRING,	/* command */
+					G_TYPE_UINT,	/* calls */
+					G_TYPE_STRING,	/* average ms */
+					G_TYPE_STRING,	/* median ms */
+					G_TYPE_STRING,	/* 99th percentile ms */
+					G_TYPE_STRING);	/* max ms */
+	gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE(stats_store),
+					STATS_COLUMN_COUNT,
+					GTK_SORT_DESCENDING);
+	treeview = gtk_tree_view_new_with_model (GTK_TREE_MODEL(stats_store));
+	g_object_unref (stats_store);
+	gimmix_stats_add_column (treeview, _("Command"), STATS_COLUMN_NAME);
+	gimmix_stats_add_column (treeview, _("Calls"), STATS_COLUMN_COUNT);
+	gimmix_stats_add_column (treeview, _("Avg (ms)"), STATS_COLUMN_AVG);
+	gimmix_stats_add_column (treeview, _("p50 (ms)"), STATS_COLUMN_P50);
+	gimmix_stats_add_column (treeview, _("p99 (ms)"), STATS_COLUMN_P99);
+	gimmix_stats_add_column (treeview, _("Max (ms)"), STATS_COLUMN_MAX);
+
+	scrolled = gtk_scrolled_window_new (NULL, NULL);
+	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW(scrolled), GTK_SHADOW_IN);
+	gtk_container_add (GTK_CONTAINER(scrolled), treeview);
+	gtk_container_set_border_width (GTK_CONTAINER(scrolled), 5);
+	gtk_box_pack_start (GTK_BOX(GTK_DIALOG(stats_dialog)->vbox), scrolled, TRUE, TRUE, 0);
+
+	g_signal_connect (stats_dialog, "response", G_CALLBACK(cb_gimmix_stats_dialog_response), NULL);
+	gimmix_stats_dialog_refresh (NULL);
+	stats_refresh_source = g_timeout_add_seconds (1, gimmix_stats_dialog_refresh, NULL);
+	gtk_widget_show_all (stats_dialog);
+
+	return;
+}
@@ -0,0 +1,30 @@
+#ifndef GIMMIX_STATS_H
+#define GIMMIX_STATS_H
+
+#include <gtk/gtk.h>
+
+/* Per command counters and latency histograms of the round trips to
+ * mpd. Setting GIMMIX_STATS to a number of seconds also logs a summary
+ * line at that interval. */
+
+/* read the environment and start the periodic log */
+void gimmix_stats_init (void);
+
+/* record a round trip that started at start (g_get_monotonic_time ())
+ * and has just finished, from any thread. name must be a static or
+ * interned string. The round trip is also added to the timeline. */
+void gimmix_stats_record (const char *name, gint64 start);
+
+/* show the statistics dialog */
+void gimmix_stats_dialog_show (GtkWindow *parent);
+
+/* measure a libmpd call, e.g.
+ * GIMMIX_MPD_CALL ("status", mpd_status_update (gmo)); */
+#define GIMMIX_MPD_CALL(name, stmt)					\
+	G_STMT_START {							\
+		gint64 mpd_call_start_ = g_get_monotonic_time ();	\
+		stmt;							\
+		gimmix_stats_record (name, mpd_call_start_);		\
+	} G_STMT_END
+
+#endif
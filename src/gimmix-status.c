@@ -0,0 +1,176 @@
+/*
+ * gimmix-status.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "gimmix.h"
+#include "gimmix-status.h"
+#include "gimmix-stats.h"
+#include "gimmix-mpdio.h"
+
+extern MpdObj		*gmo;
+
+static guint		refresh_source = 0;
+
+/* The poll asks for the status through the I/O thread. libmpd's copy
+ * of it, which emits the status_changed signals, is only brought up to
+ * date when something besides the play time has changed. */
+static gboolean		poll_pending = FALSE;
+static gchar		*poll_signature = NULL;
+static gint		poll_elapsed = -1;
+static gint		poll_total = -1;
+
+/* libmpd's own connection has to say something before mpd's
+ * connection_timeout (60 seconds by default) drops it */
+#define STATUS_KEEPALIVE	(30 * G_USEC_PER_SEC)
+static gint64		status_synced_at = 0;
+
+/* these change while a song plays without anything else changing */
+static const gchar	*poll_volatile[] = { "time: ", "elapsed: ", "bitrate: ", "audio: ", "duration: ", NULL };
+
+static void
+cb_status_polled (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	GString		*signature;
+	const gchar	*time;
+	guint		i, j;
+
+	poll_pending = FALSE;
+	if (!reply->ok)
+	{
+		/* mpd may be gone, libmpd finds out and runs the disconnect
+		 * path (connection box, reconnect) if it is */
+		gimmix_status_update ();
+		return;
+	}
+
+	signature = g_string_new (NULL);
+	for (i = 0; reply->lines[i] != NULL; i++)
+	{
+		for (j = 0; poll_volatile[j] != NULL; j++)
+			if (g_str_has_prefix (reply->lines[i], poll_volatile[j]))
+				break;
+		if (poll_volatile[j] == NULL)
+		{
+			g_string_append (signature, reply->lines[i]);
+			g_string_append_c (signature, '\n');
+		}
+	}
+
+	/* "time: <elapsed>:<total>" */
+	poll_elapsed = poll_total = -1;
+	if ((time = gimmix_mpd_reply_get (reply, "time")) != NULL)
+		sscanf (time, "%d:%d", &poll_elapsed, &poll_total);
+
+	if (g_strcmp0 (signature->str, poll_signature))
+	{
+		g_free (poll_signature);
+		poll_signature = g_string_free (signature, FALSE);
+		gimmix_status_update ();
+	}
+	else
+	{
+		g_string_free (signature, TRUE);
+		if (g_get_monotonic_time () - status_synced_at > STATUS_KEEPALIVE)
+			gimmix_status_update ();
+	}
+
+	return;
+}
+
+void
+gimmix_status_poll (void)
+{
+	if (gmo == NULL || !mpd_check_connected (gmo))
+		return;
+
+	if (!gimmix_mpdio_is_running ())
+	{
+		gimmix_status_update ();
+		return;
+	}
+	/* a slow server gets one poll at a time */
+	if (poll_pending)
+		return;
+	poll_pending = TRUE;
+	gimmix_mpdio_command (cb_status_polled, NULL, "status");
+
+	return;
+}
+
+gboolean
+gimmix_status_get_time (gint *elapsed, gint *total)
+{
+	if (poll_elapsed < 0 || poll_total < 0)
+		return FALSE;
+
+	*elapsed = poll_elapsed;
+	*total = poll_total;
+
+	return TRUE;
+}
+
+static gboolean
+gimmix_status_refresh_cb (G_GNUC_UNUSED gpointer data)
+{
+	refresh_source = 0;
+	gimmix_status_poll ();
+
+	return FALSE;
+}
+
+void
+gimmix_status_refresh (void)
+{
+	/* everything requested until the main loop is idle again is
+	 * served by one round trip */
+	if (refresh_source == 0)
+		refresh_source = g_idle_add_full (G_PRIORITY_HIGH_IDLE, gimmix_status_refresh_cb, NULL, NULL);
+
+	return;
+}
+
+gboolean
+gimmix_status_update (void)
+{
+	/* a pending refresh would only fetch the same status again */
+	if (refresh_source != 0)
+	{
+		g_source_remove (refresh_source);
+		refresh_source = 0;
+	}
+	if (gmo == NULL || !mpd_check_connected (gmo))
+		return FALSE;
+
+	GIMMIX_MPD_CALL ("status", mpd_status_update (gmo));
+	status_synced_at = g_get_monotonic_time ();
+
+	return TRUE;
+}
+
+void
+gimmix_status_flush (void)
+{
+	if (refresh_source != 0)
+		gimmix_status_update ();
+
+	return;
+}
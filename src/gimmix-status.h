@@ -0,0 +1,31 @@
+#ifndef GIMMIX_STATUS_H
+#define GIMMIX_STATUS_H
+
+#include <glib.h>
+
+/* Refreshing the cached mpd status. Code that changed something on
+ * the server asks for a refresh instead of calling mpd_status_update ()
+ * itself, all requests made in one main loop iteration are answered by
+ * a single poll. */
+
+/* schedule a status update for when the main loop is idle */
+void gimmix_status_refresh (void);
+
+/* update the status now, this also satisfies a scheduled refresh.
+ * Returns FALSE if not connected. */
+gboolean gimmix_status_update (void);
+
+/* run a scheduled refresh now, if there is one */
+void gimmix_status_flush (void);
+
+/* ask for the status without waiting for it, for the periodic timer.
+ * libmpd's status is updated when the reply shows that more than the
+ * play time has changed, when the poll failed (so that a lost server
+ * is noticed) and at least every 30 seconds to keep its connection */
+void gimmix_status_poll (void);
+
+/* play time of the current song from the last poll, FALSE if there
+ * is none */
+gboolean gimmix_status_get_time (gint *elapsed, gint *total);
+
+#endif
@@ -65,7 +65,6 @@ static gboolean cb_systray_leave_notify (GtkWidget *widget, GdkEventCrossing *ev
 void
 gimmix_create_systray_icon (void)
 {
-	gchar 		*icon_file;
 	GdkPixbuf	*icon_image;
 	GdkPixbuf	*icon_tooltip;
 	GtkWidget	*systray_icon;
@@ -73,9 +72,7 @@ gimmix_create_systray_icon (void)
 	
 	/* create the tray icon */
 	icon = egg_tray_icon_new (APPNAME);
-	icon_file = gimmix_get_full_image_path (GIMMIX_ICON);
-	icon_image = gdk_pixbuf_new_from_file_at_size (icon_file, 20, 20, NULL);
-	g_free (icon_file);
+	icon_image = gimmix_get_pixbuf (GIMMIX_ICON, 20, 20);
 	systray_icon = gtk_image_new_from_pixbuf (icon_image);
 	gtk_container_add (GTK_CONTAINER (icon), systray_icon);
 	g_object_unref (icon_image);
@@ -87,9 +84,7 @@ gimmix_create_systray_icon (void)
 	/* set the default tooltip */
 	tooltip = gimmix_tooltip_new ();
 	gimmix_tooltip_set_text1 (tooltip, APPNAME, TRUE);
-	icon_file = gimmix_get_full_image_path (GIMMIX_TOOLTIP_ICON);
-	icon_tooltip = gdk_pixbuf_new_from_file_at_size (icon_file, 32, 32, NULL);
-	g_free (icon_file);
+	icon_tooltip = gimmix_get_pixbuf (GIMMIX_TOOLTIP_ICON, 32, 32);
 	gimmix_tooltip_set_icon (tooltip, icon_tooltip);
 	g_object_unref (icon_tooltip);
 	
@@ -367,7 +362,7 @@ gimmix_destroy_systray_icon (void)
 }	
 
 void
-gimmix_update_systray_tooltip (mpd_Song *s)
+gimmix_update_systray_tooltip (GimmixSong *s)
 {
 	gchar		*text = NULL;
 	gchar		*artist_str = NULL;
@@ -410,11 +405,8 @@ void
 gimmix_systray_tooltip_set_default_image (void)
 {
 	GdkPixbuf	*pixbuf = NULL;
-	gchar		*icon_file = NULL;
 	
-	icon_file = gimmix_get_full_image_path (GIMMIX_TOOLTIP_ICON);
-	pixbuf = gdk_pixbuf_new_from_file_at_size (icon_file, 32, 32, NULL);
-	g_free (icon_file);
+	pixbuf = gimmix_get_pixbuf (GIMMIX_TOOLTIP_ICON, 32, 32);
 	if (!strncasecmp(cfg_get_key_value(conf, "enable_notification"),"true",4))
 		gimmix_tooltip_set_icon (tooltip, pixbuf);
 	g_object_unref (pixbuf);
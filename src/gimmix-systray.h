@@ -3,6 +3,7 @@
 
 #include <gtk/gtk.h>
 #include "gimmix.h"
+#include "gimmix-song.h"
 #include "eggtrayicon.h"
 #include "gimmix-tooltip.h"
 #include "sexy-tooltip.h"
@@ -20,7 +21,7 @@ void gimmix_disable_systray_icon (void);
 void gimmix_enable_systray_icon (void);
 
 /* update notification tooltip */
-void gimmix_update_systray_tooltip (mpd_Song *s);
+void gimmix_update_systray_tooltip (GimmixSong *s);
 
 /* destroy system tray icon */
 void gimmix_destroy_systray_icon (void);
@@ -0,0 +1,370 @@
+/*
+ * gimmix-tagbrowser.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include "gimmix-tagbrowser.h"
+#include "gimmix-core.h"
+#include "gimmix-tags.h"
+#include "gimmix-batch.h"
+#include "gimmix-arena.h"
+
+#define TAGS_DIR	".gimmix"
+#define TAGS_FILE	".gimmix/tags"
+
+/* page of the library notebook */
+#define TAGBROWSER_PAGE	1
+
+extern GtkBuilder	*xml;
+
+static GtkWidget	*tagbrowser_facet;
+static GtkWidget	*tagbrowser_values;
+static GtkWidget	*tagbrowser_albums;
+static GtkWidget	*tagbrowser_tracks;
+
+/* the index is only loaded once the page has been looked at */
+static gboolean		tagbrowser_used = FALSE;
+
+/* for the track titles, reset after every fill */
+static GimmixArena	*tagbrowser_arena = NULL;
+
+static void		cb_tagbrowser_ready (gpointer data);
+static void		cb_tagbrowser_page_switched (GtkNotebook *notebook, gpointer page, guint num, gpointer data);
+static void		cb_tagbrowser_facet_changed (GtkComboBox *combo, gpointer data);
+static void		cb_tagbrowser_value_changed (GtkTreeSelection *selection, gpointer data);
+static void		cb_tagbrowser_album_changed (GtkTreeSelection *selection, gpointer data);
+static void		cb_tagbrowser_row_activated (GtkTreeView *treeview, GtkTreePath *path, GtkTreeViewColumn *column, gpointer data);
+
+static void
+gimmix_tagbrowser_add_column (GtkWidget *treeview)
+{
+	GtkCellRenderer		*renderer;
+	GtkTreeViewColumn	*column;
+
+	renderer = gtk_cell_renderer_text_new ();
+	g_object_set (G_OBJECT(renderer), "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+	column = gtk_tree_view_column_new_with_attributes (NULL, renderer, "text", 0, NULL);
+	/* required by fixed height mode, which keeps long lists cheap */
+	gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_expand (column, TRUE);
+	gtk_tree_view_append_column (GTK_TREE_VIEW(treeview), column);
+
+	return;
+}
+
+void
+gimmix_tagbrowser_init (void)
+{
+	GtkTreeSelection	*selection;
+	GtkListStore		*store;
+	gchar			*path;
+
+	tagbrowser_facet = GTK_WIDGET (gtk_builder_get_object (xml, "tagbrowser_facet"));
+	tagbrowser_values = GTK_WIDGET (gtk_builder_get_object (xml, "tagbrowser_values"));
+	tagbrowser_albums = GTK_WIDGET (gtk_builder_get_object (xml, "tagbrowser_albums"));
+	tagbrowser_tracks = GTK_WIDGET (gtk_builder_get_object (xml, "tagbrowser_tracks"));
+
+	gimmix_tagbrowser_add_column (tagbrowser_values);
+	gimmix_tagbrowser_add_column (tagbrowser_albums);
+	gimmix_tagbrowser_add_column (tagbrowser_tracks);
+
+	/* the track list keeps the index of each song in the tag index */
+	store = gtk_list_store_new (2, G_TYPE_STRING, G_TYPE_UINT);
+	gtk_tree_view_set_model (GTK_TREE_VIEW(tagbrowser_tracks), GTK_TREE_MODEL(store));
+	g_object_unref (store);
+	store = gtk_list_store_new (1, G_TYPE_STRING);
+	gtk_tree_view_set_model (GTK_TREE_VIEW(tagbrowser_albums), GTK_TREE_MODEL(store));
+	g_object_unref (store);
+	gtk_tree_selection_set_mode (gtk_tree_view_get_selection (GTK_TREE_VIEW(tagbrowser_tracks)), GTK_SELECTION_MULTIPLE);
+
+	gtk_combo_box_set_active (GTK_COMBO_BOX(tagbrowser_facet), GIMMIX_TAG_ARTIST);
+	g_signal_connect (tagbrowser_facet, "changed", G_CALLBACK(cb_tagbrowser_facet_changed), NULL);
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW(tagbrowser_values));
+	g_signal_connect (selection, "changed", G_CALLBACK(cb_tagbrowser_value_changed), NULL);
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW(tagbrowser_albums));
+	g_signal_connect (selection, "changed", G_CALLBACK(cb_tagbrowser_album_changed), NULL);
+	g_signal_connect (tagbrowser_values, "row-activated", G_CALLBACK(cb_tagbrowser_row_activated), NULL);
+	g_signal_connect (tagbrowser_albums, "row-activated", G_CALLBACK(cb_tagbrowser_row_activated), NULL);
+	g_signal_connect (tagbrowser_tracks, "row-activated", G_CALLBACK(cb_tagbrowser_row_activated), NULL);
+	g_signal_connect (gtk_builder_get_object (xml, "library_notebook"), "switch-page", G_CALLBACK(cb_tagbrowser_page_switched), NULL);
+
+	path = cfg_get_path_to_config_file (TAGS_DIR);
+	g_mkdir_with_parents (path, 00755);
+	g_free (path);
+	path = cfg_get_path_to_config_file (TAGS_FILE);
+	gimmix_tags_init (path, cb_tagbrowser_ready, NULL);
+	g_free (path);
+
+	return;
+}
+
+static GimmixTagFacet
+gimmix_tagbrowser_get_facet (void)
+{
+	gint facet = gtk_combo_box_get_active (GTK_COMBO_BOX(tagbrowser_facet));
+
+	return (facet < 0) ? GIMMIX_TAG_ARTIST : facet;
+}
+
+/* the value of the selected row in a single selection list, or NULL */
+static gchar *
+gimmix_tagbrowser_get_selected (GtkWidget *treeview)
+{
+	GtkTreeSelection	*selection;
+	GtkTreeModel		*model;
+	GtkTreeIter		iter;
+	gchar			*value = NULL;
+
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW(treeview));
+	if (gtk_tree_selection_get_selected (selection, &model, &iter))
+		gtk_tree_model_get (model, &iter, 0, &value, -1);
+
+	return value;
+}
+
+static void
+gimmix_tagbrowser_fill_tracks (GArray *songs, const gchar *album)
+{
+	GtkTreeModel	*model;
+	GtkListStore	*store;
+	GtkTreeIter	iter;
+	guint		i;
+
+	if (tagbrowser_arena == NULL)
+		tagbrowser_arena = gimmix_arena_new ();
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW(tagbrowser_tracks));
+	store = GTK_LIST_STORE (model);
+	/* detached while it is filled, the view would update on every row */
+	g_object_ref (model);
+	gtk_tree_view_set_model (GTK_TREE_VIEW(tagbrowser_tracks), NULL);
+	gtk_list_store_clear (store);
+
+	for (i = 0; songs != NULL && i < songs->len; i++)
+	{
+		guint			index = g_array_index (songs, guint, i);
+		const GimmixTagSong	*song = gimmix_tags_get_song (index);
+		const gchar		*title;
+
+		if (album != NULL && g_strcmp0 (song->tags[GIMMIX_TAG_ALBUM], album))
+			continue;
+		if (song->title == NULL)
+			title = gimmix_arena_song_name (tagbrowser_arena, song->file);
+		else if (song->track > 0)
+			title = gimmix_arena_printf (tagbrowser_arena, "%02d. %s", song->track, song->title);
+		else
+			title = song->title;
+		gtk_list_store_append (store, &iter);
+		gtk_list_store_set (store, &iter, 0, title, 1, index, -1);
+	}
+	gimmix_arena_reset (tagbrowser_arena);
+
+	gtk_tree_view_set_model (GTK_TREE_VIEW(tagbrowser_tracks), model);
+	g_object_unref (model);
+
+	return;
+}
+
+static void
+gimmix_tagbrowser_fill_albums (GArray *songs)
+{
+	GtkListStore	*store;
+	GtkTreeIter	iter;
+	GHashTable	*seen;
+	guint		i;
+
+	store = gtk_list_store_new (1, G_TYPE_STRING);
+	/* album names are shared by the index, the pointer identifies them */
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; songs != NULL && i < songs->len; i++)
+	{
+		const GimmixTagSong *song = gimmix_tags_get_song (g_array_index (songs, guint, i));
+		const gchar *album = song->tags[GIMMIX_TAG_ALBUM];
+
+		if (album == NULL || g_hash_table_lookup (seen, album))
+			continue;
+		g_hash_table_insert (seen, (gpointer)album, (gpointer)album);
+		gtk_list_store_append (store, &iter);
+		gtk_list_store_set (store, &iter, 0, album, -1);
+	}
+	g_hash_table_destroy (seen);
+
+	gtk_tree_view_set_model (GTK_TREE_VIEW(tagbrowser_albums), GTK_TREE_MODEL(store));
+	g_object_unref (store);
+
+	return;
+}
+
+static void
+gimmix_tagbrowser_fill_values (void)
+{
+	GtkListStore	*store;
+	GtkTreeIter	iter;
+	GPtrArray	*values;
+	guint		i;
+
+	store = gtk_list_store_new (1, G_TYPE_STRING);
+	values = gimmix_tags_get_values (gimmix_tagbrowser_get_facet ());
+	for (i = 0; values != NULL && i < values->len; i++)
+	{
+		gtk_list_store_append (store, &iter);
+		gtk_list_store_set (store, &iter, 0, g_ptr_array_index (values, i), -1);
+	}
+	gtk_tree_view_set_model (GTK_TREE_VIEW(tagbrowser_values), GTK_TREE_MODEL(store));
+	g_object_unref (store);
+
+	gimmix_tagbrowser_fill_albums (NULL);
+	gimmix_tagbrowser_fill_tracks (NULL, NULL);
+
+	return;
+}
+
+static void
+cb_tagbrowser_ready (G_GNUC_UNUSED gpointer data)
+{
+	gimmix_tagbrowser_fill_values ();
+
+	return;
+}
+
+static void
+cb_tagbrowser_page_switched (G_GNUC_UNUSED GtkNotebook *notebook,
+				G_GNUC_UNUSED gpointer page,
+				guint num,
+				G_GNUC_UNUSED gpointer data)
+{
+	if (num != TAGBROWSER_PAGE || tagbrowser_used)
+		return;
+
+	tagbrowser_used = TRUE;
+	gimmix_tags_refresh ();
+
+	return;
+}
+
+static void
+cb_tagbrowser_facet_changed (G_GNUC_UNUSED GtkComboBox *combo, G_GNUC_UNUSED gpointer data)
+{
+	gimmix_tagbrowser_fill_values ();
+
+	return;
+}
+
+static void
+cb_tagbrowser_value_changed (G_GNUC_UNUSED GtkTreeSelection *selection, G_GNUC_UNUSED gpointer data)
+{
+	GArray	*songs;
+	gchar	*value;
+
+	value = gimmix_tagbrowser_get_selected (tagbrowser_values);
+	songs = gimmix_tags_get_songs (gimmix_tagbrowser_get_facet (), value);
+	gimmix_tagbrowser_fill_albums (songs);
+	gimmix_tagbrowser_fill_tracks (songs, NULL);
+	g_free (value);
+
+	return;
+}
+
+static void
+cb_tagbrowser_album_changed (G_GNUC_UNUSED GtkTreeSelection *selection, G_GNUC_UNUSED gpointer data)
+{
+	gchar	*value;
+	gchar	*album;
+
+	value = gimmix_tagbrowser_get_selected (tagbrowser_values);
+	album = gimmix_tagbrowser_get_selected (tagbrowser_albums);
+	gimmix_tagbrowser_fill_tracks (gimmix_tags_get_songs (gimmix_tagbrowser_get_facet (), value), album);
+	g_free (value);
+	g_free (album);
+
+	return;
+}
+
+/* add the songs of a value, of one of its albums or a single track */
+static void
+cb_tagbrowser_row_activated (GtkTreeView *treeview,
+				GtkTreePath *path,
+				G_GNUC_UNUSED GtkTreeViewColumn *column,
+				G_GNUC_UNUSED gpointer data)
+{
+	GimmixBatch	*batch;
+	GtkTreeModel	*model;
+	GtkTreeIter	iter;
+	GArray		*songs;
+	gchar		*value;
+	gchar		*album = NULL;
+	guint		index;
+	guint		i;
+
+	model = gtk_tree_view_get_model (treeview);
+	if (!gtk_tree_model_get_iter (model, &iter, path))
+		return;
+
+	batch = gimmix_batch_new ();
+	if (GTK_WIDGET(treeview) == tagbrowser_tracks)
+	{
+		gtk_tree_model_get (model, &iter, 1, &index, -1);
+		gimmix_batch_add (batch, gimmix_tags_get_song (index)->file);
+	}
+	else
+	{
+		if (GTK_WIDGET(treeview) == tagbrowser_albums)
+		{
+			gtk_tree_model_get (model, &iter, 0, &album, -1);
+			value = gimmix_tagbrowser_get_selected (tagbrowser_values);
+		}
+		else
+			gtk_tree_model_get (model, &iter, 0, &value, -1);
+
+		songs = gimmix_tags_get_songs (gimmix_tagbrowser_get_facet (), value);
+		for (i = 0; songs != NULL && i < songs->len; i++)
+		{
+			const GimmixTagSong *song = gimmix_tags_get_song (g_array_index (songs, guint, i));
+
+			if (album == NULL || !g_strcmp0 (song->tags[GIMMIX_TAG_ALBUM], album))
+				gimmix_batch_add (batch, song->file);
+		}
+		g_free (value);
+		g_free (album);
+	}
+	gimmix_batch_commit (batch, NULL, NULL);
+
+	return;
+}
+
+void
+gimmix_tagbrowser_refresh (void)
+{
+	if (tagbrowser_used)
+		gimmix_tags_refresh ();
+
+	return;
+}
+
+void
+gimmix_tagbrowser_cleanup (void)
+{
+	gimmix_tags_cleanup ();
+	gimmix_arena_free (tagbrowser_arena);
+	tagbrowser_arena = NULL;
+
+	return;
+}
@@ -0,0 +1,17 @@
+#ifndef GIMMIX_TAGBROWSER_H
+#define GIMMIX_TAGBROWSER_H
+
+#include <gtk/gtk.h>
+
+#include "gimmix.h"
+
+/* Set up the tag page of the library window, the index is only loaded
+ * when the page is shown for the first time */
+void gimmix_tagbrowser_init (void);
+
+/* the database changed, rebuild the index if it is in use */
+void gimmix_tagbrowser_refresh (void);
+
+void gimmix_tagbrowser_cleanup (void);
+
+#endif
@@ -25,18 +25,60 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <glib/gstdio.h>
 
 #include "gimmix.h"
 #include "gimmix-core.h"
 #include "gimmix-tagedit.h"
+#include "gimmix-dispatch.h"
+#include "gimmix-status.h"
+#include "gimmix-stats.h"
 
 extern MpdObj 		*gmo;
-extern GtkBuilder	*xml;
 extern ConfigFile	conf;
+extern GtkWidget	*main_window;
 
 #ifdef HAVE_TAGEDITOR
-TagLib_File 	*file = NULL;
-TagLib_Tag 	*tag = NULL;
+/* maximum number of files kept in the tag cache */
+#define TAG_CACHE_MAX	512
+
+/* tags and audio properties of a single file */
+typedef struct _tag_info {
+	gchar		*path;
+	time_t		mtime;
+	off_t		size;
+	guint		year;
+	guint		track;
+	gchar		*title;
+	gchar		*artist;
+	gchar		*album;
+	gchar		*comment;
+	gchar		*genre;
+	gint		length;
+	gint		bitrate;
+	gint		channels;
+	GList		*lru;		/* link in tag_cache_lru, cached entries only */
+} GimmixTagInfo;
+
+/* a pending tag read */
+typedef struct _tag_request {
+	gchar		*path;
+	guint		serial;
+	GimmixTagInfo	*info;
+} GimmixTagRequest;
+
+/* path -> GimmixTagInfo, validated against mtime and size */
+static GHashTable	*tag_cache = NULL;
+/* the cached entries, most recently used first */
+static GQueue		tag_cache_lru = G_QUEUE_INIT;
+static GMutex		tag_cache_mutex;
+
+/* taglib keeps its strings in a global list, serialize all access */
+static GMutex		taglib_mutex;
+
+/* the file currently shown in the tag editor */
+static gchar		*tag_editor_path = NULL;
+static guint		tag_request_serial = 0;
 #endif
 
 static GtkWidget	*tag_title;
@@ -50,12 +92,18 @@ static GtkWidget	*tag_genre;
 static GtkWidget	*tag_info_bitrate;
 static GtkWidget	*tag_info_channels;
 static GtkWidget	*tag_info_length;
-GtkWidget	*tag_editor_window;
+GtkWidget	*tag_editor_window = NULL;
 static GtkWidget	*tag_editor_cover_image;
+static GdkPixbuf	*tag_editor_cover = NULL;
+static GtkWidget	*tag_editor_save_button;
 
 #ifdef HAVE_TAGEDITOR
 /* Save action */
 static void	gimmix_tag_editor_save (GtkWidget *button, gpointer data);
+
+/* Read tags on a worker thread */
+static gpointer	gimmix_tag_editor_read_thread (GimmixTagRequest *req);
+static void	gimmix_tag_info_free (GimmixTagInfo *info);
 #endif
 
 /* Close action */
@@ -69,10 +117,28 @@ const gchar *dir_error = "You have specified an invalid music directory. Do you
 #endif
 
 void
+gimmix_tag_editor_init (void)
+{
+	#ifdef HAVE_TAGEDITOR
+	tag_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+					NULL,
+					(GDestroyNotify)gimmix_tag_info_free);
+	#endif
+	
+	return;
+}
+
+/* The tag editor window is built the first time a file is edited */
+static void
 gimmix_tag_editor_widgets_init (void)
 {
+	GtkBuilder *xml;
 	GtkWidget *widget;
 	
+	if (tag_editor_window != NULL)
+		return;
+	
+	xml = gimmix_ui_load ("gimmix-tagedit.ui");
 	tag_editor_window = GTK_WIDGET (gtk_builder_get_object (xml, "tag_editor_window"));
 	tag_title = GTK_WIDGET (gtk_builder_get_object (xml,"entry_title"));
 	tag_file = GTK_WIDGET (gtk_builder_get_object (xml,"entry_filename"));
@@ -87,11 +153,11 @@ gimmix_tag_editor_widgets_init (void)
 	tag_info_bitrate = GTK_WIDGET (gtk_builder_get_object (xml, "info_bitrate"));
 	tag_editor_cover_image = GTK_WIDGET (gtk_builder_get_object (xml, "gimmix_tagedit_cover_image"));
 	
-	widget = GTK_WIDGET (gtk_builder_get_object (xml, "tag_editor_save"));
+	tag_editor_save_button = GTK_WIDGET (gtk_builder_get_object (xml, "tag_editor_save"));
 	#ifdef HAVE_TAGEDITOR
-	g_signal_connect (G_OBJECT(widget), "clicked", G_CALLBACK(gimmix_tag_editor_save), NULL);
+	g_signal_connect (G_OBJECT(tag_editor_save_button), "clicked", G_CALLBACK(gimmix_tag_editor_save), NULL);
 	#else
-	gtk_widget_set_sensitive (widget, FALSE);
+	gtk_widget_set_sensitive (tag_editor_save_button, FALSE);
 	#endif
 
 	widget = GTK_WIDGET (gtk_builder_get_object (xml, "tag_editor_close"));
@@ -103,142 +169,358 @@ gimmix_tag_editor_widgets_init (void)
 				"delete-event",
 				G_CALLBACK(gtk_widget_hide_on_delete),
 				NULL);
+	g_object_unref (xml);
+	
+	/* cover art that arrived before the window existed */
+	if (tag_editor_cover != NULL)
+	{
+		gtk_image_set_from_pixbuf (GTK_IMAGE(tag_editor_cover_image), tag_editor_cover);
+		g_object_unref (tag_editor_cover);
+		tag_editor_cover = NULL;
+	}
 	
 	return;
 }
 
-/* Load the tag editor */
-gboolean
-gimmix_tag_editor_populate (const void *song)
+static void
+gimmix_tag_editor_set_fields (const gchar *path,
+			      guint	   year,
+			      guint	   track,
+			      const gchar *title,
+			      const gchar *artist,
+			      const gchar *album,
+			      const gchar *comment,
+			      const gchar *genre)
 {
 	GtkTreeModel 	*genre_model;
-	gchar 		*info;
 	gint 		n;
-	guint		year = 0;
-	guint		track = 0;
-	gchar		*title = NULL;
-	gchar		*artist = NULL;
-	gchar		*album = NULL;
-	gchar		*genre = NULL;
-	gchar		*comment = NULL;
-	
-	if (!song)
-		return FALSE;
-	
-	#ifdef HAVE_TAGEDITOR
-	const TagLib_AudioProperties *properties;
-	if (!g_file_test(song,G_FILE_TEST_EXISTS))
-		return FALSE;
 
-	file = taglib_file_new (song);
-	if (file == NULL)
-		return FALSE;
+	gtk_spin_button_set_value (GTK_SPIN_BUTTON(tag_year_spin), year);
+	gtk_spin_button_set_value (GTK_SPIN_BUTTON(tag_track_spin), track);
 
-	taglib_set_strings_unicode (FALSE);
-	
-	tag = taglib_file_tag (file);
-	properties = taglib_file_audioproperties (file);
-	#else
-	mpd_Song *foo = (mpd_Song*) g_malloc0 (sizeof(mpd_Song));
-	memcpy (foo, song, sizeof(mpd_Song));
-	#endif
-	
-	#ifdef HAVE_TAGEDITOR
-	year = taglib_tag_year (tag);
-	track = taglib_tag_track (tag);
-	title = g_strstrip (taglib_tag_title(tag));
-	artist = g_strstrip (taglib_tag_artist(tag));
-	album = g_strstrip (taglib_tag_album(tag));
-	comment = g_strstrip (taglib_tag_comment(tag));
-	genre = taglib_tag_genre (tag);
-	#else
-	if (foo->date)
-	{
-		year = atoi (foo->date);
-	}
-	if (foo->track)
+	gtk_entry_set_text (GTK_ENTRY(tag_file), path);
+	gtk_entry_set_text (GTK_ENTRY(tag_title), title ? title : "");
+	gtk_entry_set_text (GTK_ENTRY(tag_artist), artist ? artist : "");
+	gtk_entry_set_text (GTK_ENTRY(tag_album), album ? album : "");
+	gtk_entry_set_text (GTK_ENTRY(tag_comment), comment ? comment : "");
+	if (genre)
 	{
-		track = atoi (foo->track);
+		gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT(tag_genre), genre);
 	}
-	title = foo->title;
-	artist = foo->artist;
-	album = foo->album;
-	comment = foo->comment;
-	genre = foo->genre;
-	#endif
-	
-	gtk_spin_button_set_value (GTK_SPIN_BUTTON(tag_year_spin), year);
-	gtk_spin_button_set_value (GTK_SPIN_BUTTON(tag_track_spin), track);
 
-	gtk_entry_set_text (GTK_ENTRY(tag_file),
-				#ifdef HAVE_TAGEDITOR
-				song
-				#else
-				foo->file
-				#endif
-				);
-	if (title)
+	genre_model = gtk_combo_box_get_model (GTK_COMBO_BOX(tag_genre));
+	n = gtk_tree_model_iter_n_children (genre_model, NULL);
+	gtk_combo_box_set_active (GTK_COMBO_BOX(tag_genre), n-1);
+
+	return;
+}
+
+#ifdef HAVE_TAGEDITOR
+static void
+gimmix_tag_info_free (GimmixTagInfo *info)
+{
+	if (info == NULL)
+		return;
+
+	g_free (info->path);
+	g_free (info->title);
+	g_free (info->artist);
+	g_free (info->album);
+	g_free (info->comment);
+	g_free (info->genre);
+	g_free (info);
+
+	return;
+}
+
+static GimmixTagInfo*
+gimmix_tag_info_dup (const GimmixTagInfo *info)
+{
+	GimmixTagInfo *ret;
+
+	ret = g_memdup (info, sizeof(GimmixTagInfo));
+	ret->lru = NULL;
+	ret->path = g_strdup (info->path);
+	ret->title = g_strdup (info->title);
+	ret->artist = g_strdup (info->artist);
+	ret->album = g_strdup (info->album);
+	ret->comment = g_strdup (info->comment);
+	ret->genre = g_strdup (info->genre);
+
+	return ret;
+}
+
+/* Look up a cached entry, returns a copy or NULL if missing or stale */
+static GimmixTagInfo*
+gimmix_tag_cache_lookup (const gchar *path, const struct stat *st)
+{
+	GimmixTagInfo *info;
+	GimmixTagInfo *ret = NULL;
+
+	g_mutex_lock (&tag_cache_mutex);
+	info = g_hash_table_lookup (tag_cache, path);
+	if (info != NULL && info->mtime == st->st_mtime && info->size == st->st_size)
 	{
-		gtk_entry_set_text (GTK_ENTRY(tag_title), title);
+		g_queue_unlink (&tag_cache_lru, info->lru);
+		g_queue_push_head_link (&tag_cache_lru, info->lru);
+		ret = gimmix_tag_info_dup (info);
 	}
-	if (artist)
+	g_mutex_unlock (&tag_cache_mutex);
+
+	return ret;
+}
+
+/* drop an entry, the cache mutex is held */
+static void
+gimmix_tag_cache_remove_locked (const gchar *path)
+{
+	GimmixTagInfo *info;
+
+	if ((info = g_hash_table_lookup (tag_cache, path)) == NULL)
+		return;
+
+	g_queue_delete_link (&tag_cache_lru, info->lru);
+	g_hash_table_remove (tag_cache, path);
+
+	return;
+}
+
+static void
+gimmix_tag_cache_insert (const GimmixTagInfo *info)
+{
+	GimmixTagInfo *copy;
+
+	copy = gimmix_tag_info_dup (info);
+	g_mutex_lock (&tag_cache_mutex);
+	gimmix_tag_cache_remove_locked (copy->path);
+	/* make room by dropping the least recently used files only */
+	while (tag_cache_lru.length >= TAG_CACHE_MAX)
 	{
-		gtk_entry_set_text (GTK_ENTRY(tag_artist), artist);
+		GimmixTagInfo *oldest = g_queue_peek_tail (&tag_cache_lru);
+
+		gimmix_tag_cache_remove_locked (oldest->path);
 	}
-	if (album)
+	g_queue_push_head (&tag_cache_lru, copy);
+	copy->lru = tag_cache_lru.head;
+	g_hash_table_replace (tag_cache, copy->path, copy);
+	g_mutex_unlock (&tag_cache_mutex);
+
+	return;
+}
+
+static void
+gimmix_tag_cache_invalidate (const gchar *path)
+{
+	g_mutex_lock (&tag_cache_mutex);
+	gimmix_tag_cache_remove_locked (path);
+	g_mutex_unlock (&tag_cache_mutex);
+
+	return;
+}
+
+/* Read tags and audio properties of path, the result is owned by the caller */
+static GimmixTagInfo*
+gimmix_tag_info_read (const gchar *path)
+{
+	GimmixTagInfo			*info;
+	TagLib_File			*tfile;
+	TagLib_Tag			*ttag;
+	const TagLib_AudioProperties	*properties;
+	struct stat			st;
+
+	if (g_stat (path, &st) != 0 || !S_ISREG(st.st_mode))
+		return NULL;
+
+	if ((info = gimmix_tag_cache_lookup (path, &st)))
+		return info;
+
+	g_mutex_lock (&taglib_mutex);
+	taglib_set_strings_unicode (FALSE);
+	tfile = taglib_file_new (path);
+	if (tfile == NULL)
 	{
-		gtk_entry_set_text (GTK_ENTRY(tag_album), album);
+		g_mutex_unlock (&taglib_mutex);
+		return NULL;
 	}
-	if (comment)
+
+	info = g_new0 (GimmixTagInfo, 1);
+	info->path = g_strdup (path);
+	info->mtime = st.st_mtime;
+	info->size = st.st_size;
+
+	ttag = taglib_file_tag (tfile);
+	info->year = taglib_tag_year (ttag);
+	info->track = taglib_tag_track (ttag);
+	info->title = g_strstrip (g_strdup (taglib_tag_title (ttag)));
+	info->artist = g_strstrip (g_strdup (taglib_tag_artist (ttag)));
+	info->album = g_strstrip (g_strdup (taglib_tag_album (ttag)));
+	info->comment = g_strstrip (g_strdup (taglib_tag_comment (ttag)));
+	info->genre = g_strdup (taglib_tag_genre (ttag));
+
+	properties = taglib_file_audioproperties (tfile);
+	if (properties)
 	{
-		gtk_entry_set_text (GTK_ENTRY(tag_comment), comment);
+		info->length = taglib_audioproperties_length (properties);
+		info->bitrate = taglib_audioproperties_bitrate (properties);
+		info->channels = taglib_audioproperties_channels (properties);
 	}
-	if (genre)
+
+	taglib_tag_free_strings ();
+	taglib_file_free (tfile);
+	g_mutex_unlock (&taglib_mutex);
+
+	gimmix_tag_cache_insert (info);
+
+	return info;
+}
+
+/* Runs in the main loop once the worker is done */
+static void
+gimmix_tag_editor_read_done (GimmixTagRequest *req)
+{
+	GimmixTagInfo	*info = req->info;
+	gchar		*text;
+
+	/* the user has moved on to another file meanwhile */
+	if (req->serial != tag_request_serial)
+		return;
+
+	if (info == NULL)
 	{
-		gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT(tag_genre), genre);
+		gtk_widget_hide (tag_editor_window);
+		g_warning (_("Invalid music directory."));
+		gimmix_tag_editor_error (dir_error);
+		return;
 	}
 
-	genre_model = gtk_combo_box_get_model (GTK_COMBO_BOX(tag_genre));
-	n = gtk_tree_model_iter_n_children (genre_model, NULL);
-	gtk_combo_box_set_active (GTK_COMBO_BOX(tag_genre), n-1);
+	gimmix_tag_editor_set_fields (info->path,
+				info->year,
+				info->track,
+				info->title,
+				info->artist,
+				info->album,
+				info->comment,
+				info->genre);
 
 	/* Audio Information */
+	text = g_strdup_printf ("%02i:%02i", info->length / 60, info->length % 60);
+	gtk_label_set_text (GTK_LABEL(tag_info_length), text);
+	g_free (text);
+
+	text = g_strdup_printf ("%i Kbps", info->bitrate);
+	gtk_label_set_text (GTK_LABEL(tag_info_bitrate), text);
+	g_free (text);
+
+	text = g_strdup_printf ("%i", info->channels);
+	gtk_label_set_text (GTK_LABEL(tag_info_channels), text);
+	g_free (text);
+
+	gtk_widget_set_sensitive (tag_editor_save_button, TRUE);
+
+	return;
+}
+
+static void
+gimmix_tag_request_free (GimmixTagRequest *req)
+{
+	gimmix_tag_info_free (req->info);
+	g_free (req->path);
+	g_free (req);
+
+	return;
+}
+
+static const GimmixResultType tag_read_result_type = {
+	"tag_read",
+	(void (*) (gpointer))gimmix_tag_editor_read_done,
+	(GDestroyNotify)gimmix_tag_request_free,
+	TRUE
+};
+
+static gpointer
+gimmix_tag_editor_read_thread (GimmixTagRequest *req)
+{
+	req->info = gimmix_tag_info_read (req->path);
+	gimmix_dispatch_post (&tag_read_result_type, req);
+
+	return NULL;
+}
+#endif
+
+/* Load the tag editor.
+ * With tag editing support the file is read on a worker thread and the
+ * fields are filled in once its tags arrive.
+ */
+gboolean
+gimmix_tag_editor_populate (const void *song)
+{
+	if (!song)
+		return FALSE;
+	
+	gimmix_tag_editor_widgets_init ();
+	
 	#ifdef HAVE_TAGEDITOR
-	guint sec = taglib_audioproperties_length(properties) % 60;
-    	guint min = (taglib_audioproperties_length(properties) - sec) / 60;
-	info = g_strdup_printf ("%02i:%02i", min, sec);
-	gtk_label_set_text (GTK_LABEL(tag_info_length), info);
+	GimmixTagRequest *req;
+
+	g_free (tag_editor_path);
+	tag_editor_path = g_strdup (song);
+
+	/* clear the old values while the new ones are being read */
+	gimmix_tag_editor_set_fields (song, 0, 0, NULL, NULL, NULL, NULL, NULL);
+	gtk_label_set_text (GTK_LABEL(tag_info_length), "");
+	gtk_label_set_text (GTK_LABEL(tag_info_bitrate), "");
+	gtk_label_set_text (GTK_LABEL(tag_info_channels), "");
+	gtk_widget_set_sensitive (tag_editor_save_button, FALSE);
+
+	req = g_new0 (GimmixTagRequest, 1);
+	req->path = g_strdup (song);
+	req->serial = ++tag_request_serial;
+	g_thread_unref (g_thread_new ("tag_editor_read",
+				(GThreadFunc)gimmix_tag_editor_read_thread,
+				req));
 	#else
+	gchar		*info;
+	guint		year = 0;
+	guint		track = 0;
+	mpd_Song	*foo = (mpd_Song*) song;
+
+	if (foo->date)
+	{
+		year = atoi (foo->date);
+	}
+	if (foo->track)
+	{
+		track = atoi (foo->track);
+	}
+	gimmix_tag_editor_set_fields (foo->file,
+				year,
+				track,
+				foo->title,
+				foo->artist,
+				foo->album,
+				foo->comment,
+				foo->genre);
+
+	/* Audio Information */
 	char *tok = NULL;
 	info = (char*) g_malloc0 (sizeof(char)*32);
 	gimmix_get_progress_status (gmo, NULL, info);
 	tok = strtok (info, "/");
 	tok = strtok (NULL, "/");
-	g_strstrip (tok);
-	gtk_label_set_text (GTK_LABEL(tag_info_length), tok);
-	#endif
+	if (tok)
+	{
+		g_strstrip (tok);
+		gtk_label_set_text (GTK_LABEL(tag_info_length), tok);
+	}
 	g_free (info);
 
-	#ifdef HAVE_TAGEDITOR
-	info = g_strdup_printf ("%i Kbps", taglib_audioproperties_bitrate(properties));
-	#else
 	info = g_strdup_printf ("%i Kbps", mpd_status_get_bitrate(gmo));
-	#endif
 	gtk_label_set_text (GTK_LABEL(tag_info_bitrate), info);
 	g_free (info);
 	
-	#ifdef HAVE_TAGEDITOR
-	info = g_strdup_printf ("%i", taglib_audioproperties_channels(properties));
-	#else
 	info = g_strdup_printf ("%i", mpd_status_get_channels(gmo));
-	#endif
 	gtk_label_set_text (GTK_LABEL(tag_info_channels), info);
 	g_free (info);
-	
-	#ifdef HAVE_TAGEDITOR
-	taglib_tag_free_strings ();
-	#else
-	free (foo);
 	#endif
 	
 	return TRUE;
@@ -249,11 +531,8 @@ gimmix_tag_editor_close (G_GNUC_UNUSED GtkWidget *widget,
 			 G_GNUC_UNUSED gpointer	  data)
 {
 	#ifdef HAVE_TAGEDITOR
-	taglib_tag_free_strings ();
-	if (file)
-    	{
-    		taglib_file_free (file);
-    	}
+	/* drop any read still in flight */
+	tag_request_serial++;
 	#endif
 	gtk_widget_hide (tag_editor_window);
 
@@ -265,6 +544,8 @@ static void
 gimmix_tag_editor_save (G_GNUC_UNUSED GtkWidget *button,
 			G_GNUC_UNUSED gpointer	 data)
 {
+	TagLib_File	*tfile;
+	TagLib_Tag	*ttag;
 	gint		year;
 	gint		track;
 	gchar		*genre = NULL;
@@ -272,12 +553,27 @@ gimmix_tag_editor_save (G_GNUC_UNUSED GtkWidget *button,
 	gchar		*artist = NULL;
 	gchar		*album = NULL;
 	gchar		*comment = NULL;
+	GList		*written;
+
+	if (tag_editor_path == NULL)
+		return;
+
+	g_mutex_lock (&taglib_mutex);
+	taglib_set_strings_unicode (FALSE);
+	tfile = taglib_file_new (tag_editor_path);
+	if (tfile == NULL)
+	{
+		g_mutex_unlock (&taglib_mutex);
+		gimmix_error (_("Could not open the file for writing."));
+		return;
+	}
+	ttag = taglib_file_tag (tfile);
 
 	year = gtk_spin_button_get_value (GTK_SPIN_BUTTON(tag_year_spin));
-	taglib_tag_set_year (tag, year);
+	taglib_tag_set_year (ttag, year);
 
 	track = gtk_spin_button_get_value (GTK_SPIN_BUTTON(tag_track_spin));
-	taglib_tag_set_track (tag, track);
+	taglib_tag_set_track (ttag, track);
 
 	title = g_strdup (gtk_entry_get_text (GTK_ENTRY(tag_title)));
 	artist = g_strdup (gtk_entry_get_text (GTK_ENTRY(tag_artist)));
@@ -287,35 +583,46 @@ gimmix_tag_editor_save (G_GNUC_UNUSED GtkWidget *button,
 
 	if (title)
 	{
-		taglib_tag_set_title (tag, g_strchomp(title));
+		taglib_tag_set_title (ttag, g_strchomp(title));
 	}
 	if (artist)
 	{
-		taglib_tag_set_artist (tag, g_strchomp(artist));
+		taglib_tag_set_artist (ttag, g_strchomp(artist));
 	}
 	if (album)
 	{
-		taglib_tag_set_album (tag, g_strchomp(album));
+		taglib_tag_set_album (ttag, g_strchomp(album));
 	}
 	if (comment)
 	{
-		taglib_tag_set_comment (tag, g_strchomp(comment));
+		taglib_tag_set_comment (ttag, g_strchomp(comment));
+	}
+	if (genre)
+	{
+		taglib_tag_set_genre (ttag, genre);
 	}
-	taglib_tag_set_genre (tag, genre);
 	
-	/* update the mpd database */
-	mpd_database_update_dir (gmo, "/");
+	taglib_file_save (tfile);
+	taglib_tag_free_strings ();
+	taglib_file_free (tfile);
+	g_mutex_unlock (&taglib_mutex);
+
+	gimmix_tag_cache_invalidate (tag_editor_path);
+
+	/* rescan only the directory of the edited file */
+	written = g_list_prepend (NULL, (gpointer)gimmix_path_strip_music_dir (tag_editor_path));
+	gimmix_database_update_paths (gmo, written);
+	g_list_free (written);
 	
 	/* set the song info a few seconds after update */
-	mpd_status_update (gmo);
+	gimmix_status_refresh ();
 	
 	/* free the strings */
-	taglib_tag_free_strings ();
-	taglib_file_save (file);
 	g_free (title);
 	g_free (artist);
 	g_free (album);
 	g_free (comment);
+	g_free (genre);
 	
 	return;
 }
@@ -325,19 +632,27 @@ void
 gimmix_tag_editor_show (void)
 {
 	GimmixStatus 	status;
+	#if HAVE_TAGEDITOR
+	GimmixSong	*info;
+	#else
 	mpd_Song	*info;
+	#endif
 	gchar		*song = NULL;
 	
 	status = gimmix_get_status (gmo);
 	
 	if (status == PLAY || status == PAUSE)
 	{
-		info = mpd_playlist_get_current_song (gmo);
 		#if HAVE_TAGEDITOR
+		/* the file of the song shown in the main window */
+		if ((info = gimmix_song_get_current ()) == NULL)
+			return;
 		song = g_strdup_printf ("%s/%s", cfg_get_key_value(conf, "music_directory"), info->file);
+		gimmix_song_unref (info);
 		if (gimmix_tag_editor_populate (song))
 			gtk_widget_show (GTK_WIDGET(tag_editor_window));
 		#else
+		GIMMIX_MPD_CALL ("currentsong", info = mpd_playlist_get_current_song (gmo));
 		if (gimmix_tag_editor_populate (info))
 			gtk_widget_show (GTK_WIDGET(tag_editor_window));
 		#endif
@@ -359,6 +674,14 @@ gimmix_tag_editor_show (void)
 void
 gimmix_tag_editor_set_cover_image (GdkPixbuf *image)
 {
+	if (tag_editor_window == NULL)
+	{
+		/* keep it until the window is built */
+		if (tag_editor_cover != NULL)
+			g_object_unref (tag_editor_cover);
+		tag_editor_cover = image ? g_object_ref (image) : NULL;
+		return;
+	}
 	gtk_image_set_from_pixbuf (GTK_IMAGE(tag_editor_cover_image), image);
 	return;
 }
@@ -394,6 +717,7 @@ cb_gimmix_tag_editor_error_response (GtkDialog		   *dialog,
 	if (arg1 == GTK_RESPONSE_YES)
 	{
 		extern GtkWidget *pref_notebook;
+		gimmix_prefs_init ();
 		gtk_notebook_set_current_page (GTK_NOTEBOOK(pref_notebook), 2);
 		gimmix_prefs_dialog_show ();
 	}
@@ -403,3 +727,377 @@ cb_gimmix_tag_editor_error_response (GtkDialog		   *dialog,
 	return;
 }
 
+#ifdef HAVE_TAGEDITOR
+/* Batch tag editing.
+ * The field changes are applied to every selected file on a bounded
+ * pool of worker threads. Each worker reports back to the main loop,
+ * which updates the progress bar and collects the failed files.
+ */
+
+/* worker threads, they only overlap on checking the files since the
+ * taglib calls are serialized */
+#define TAG_BATCH_MAX_THREADS	4
+
+typedef struct _tag_batch {
+	/* fields to apply, NULL/0 if the field is left untouched */
+	gchar		*artist;
+	gchar		*album;
+	gchar		*genre;
+	guint		year;
+	gboolean	set_year;
+	gboolean	set_track;
+
+	guint		total;
+	guint		done;
+	gint		cancelled;
+	GPtrArray	*errors;
+	GList		*written;
+
+	GtkWidget	*dialog;
+	GtkWidget	*progressbar;
+} GimmixTagBatch;
+
+typedef struct _tag_batch_job {
+	GimmixTagBatch	*batch;
+	gchar		*path;
+	guint		track;
+	gboolean	success;
+	gboolean	skipped;	/* the batch was cancelled first */
+} GimmixTagBatchJob;
+
+typedef struct _tag_batch_form {
+	GList		*files;
+	GtkWidget	*artist_check;
+	GtkWidget	*artist_entry;
+	GtkWidget	*album_check;
+	GtkWidget	*album_entry;
+	GtkWidget	*year_check;
+	GtkWidget	*year_spin;
+	GtkWidget	*genre_check;
+	GtkWidget	*genre_entry;
+	GtkWidget	*track_check;
+	GtkWidget	*track_spin;
+} GimmixTagBatchForm;
+
+static GThreadPool	*tag_batch_pool = NULL;
+
+static void
+gimmix_tag_batch_free (GimmixTagBatch *batch)
+{
+	g_free (batch->artist);
+	g_free (batch->album);
+	g_free (batch->genre);
+	g_ptr_array_free (batch->errors, TRUE);
+	g_list_free_full (batch->written, g_free);
+	g_free (batch);
+
+	return;
+}
+
+static void
+gimmix_tag_batch_finish (GimmixTagBatch *batch)
+{
+	gtk_widget_destroy (batch->dialog);
+
+	/* let mpd pick up the new tags, one update per directory */
+	gimmix_database_update_paths (gmo, batch->written);
+	gimmix_status_refresh ();
+
+	if (batch->errors->len)
+	{
+		GString	*msg;
+		guint	i;
+
+		msg = g_string_new (NULL);
+		g_string_printf (msg, _("Could not write tags to %d of %d files:\n"),
+				batch->errors->len, batch->total);
+		for (i = 0; i < batch->errors->len && i < 20; i++)
+		{
+			g_string_append_printf (msg, "\n%s", (gchar*)g_ptr_array_index(batch->errors, i));
+		}
+		if (batch->errors->len > 20)
+			g_string_append (msg, "\n...");
+		gimmix_error (msg->str);
+		g_string_free (msg, TRUE);
+	}
+	gimmix_tag_batch_free (batch);
+
+	return;
+}
+
+/* Runs in the main loop for every file the pool has processed */
+static void
+gimmix_tag_batch_job_done (GimmixTagBatchJob *job)
+{
+	GimmixTagBatch	*batch = job->batch;
+	gchar		*text;
+
+	batch->done++;
+	if (job->skipped)
+	{
+		/* not an error, the user asked to stop */
+	}
+	else if (!job->success)
+	{
+		g_ptr_array_add (batch->errors, job->path);
+		job->path = NULL;
+	}
+	else
+	{
+		gimmix_tag_cache_invalidate (job->path);
+		batch->written = g_list_prepend (batch->written,
+					g_strdup (gimmix_path_strip_music_dir (job->path)));
+	}
+
+	text = g_strdup_printf (_("%d of %d files"), batch->done, batch->total);
+	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR(batch->progressbar),
+				(gdouble)batch->done / batch->total);
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR(batch->progressbar), text);
+	g_free (text);
+
+	if (batch->done == batch->total)
+		gimmix_tag_batch_finish (batch);
+
+	return;
+}
+
+static void
+gimmix_tag_batch_job_free (GimmixTagBatchJob *job)
+{
+	g_free (job->path);
+	g_free (job);
+
+	return;
+}
+
+static const GimmixResultType tag_batch_result_type = {
+	"tag_batch",
+	(void (*) (gpointer))gimmix_tag_batch_job_done,
+	(GDestroyNotify)gimmix_tag_batch_job_free,
+	FALSE
+};
+
+static void
+gimmix_tag_batch_write (GimmixTagBatchJob *job, G_GNUC_UNUSED gpointer data)
+{
+	GimmixTagBatch	*batch = job->batch;
+	TagLib_File	*tfile;
+	TagLib_Tag	*ttag;
+	struct stat	st;
+
+	job->success = FALSE;
+	if (g_atomic_int_get (&batch->cancelled))
+	{
+		job->skipped = TRUE;
+		goto done;
+	}
+
+	/* only the check for the file runs in parallel, taglib itself is
+	 * used by one thread at a time and in the same string mode as the
+	 * single file editor */
+	if (g_stat (job->path, &st) != 0 || !S_ISREG(st.st_mode))
+		goto done;
+
+	g_mutex_lock (&taglib_mutex);
+	taglib_set_strings_unicode (FALSE);
+	if ((tfile = taglib_file_new (job->path)) == NULL)
+	{
+		g_mutex_unlock (&taglib_mutex);
+		goto done;
+	}
+
+	ttag = taglib_file_tag (tfile);
+	if (batch->artist)
+		taglib_tag_set_artist (ttag, batch->artist);
+	if (batch->album)
+		taglib_tag_set_album (ttag, batch->album);
+	if (batch->genre)
+		taglib_tag_set_genre (ttag, batch->genre);
+	if (batch->set_year)
+		taglib_tag_set_year (ttag, batch->year);
+	if (batch->set_track)
+		taglib_tag_set_track (ttag, job->track);
+
+	job->success = taglib_file_save (tfile);
+	taglib_file_free (tfile);
+	g_mutex_unlock (&taglib_mutex);
+
+	done:
+	gimmix_dispatch_post (&tag_batch_result_type, job);
+
+	return;
+}
+
+static void
+cb_gimmix_tag_batch_progress_response (G_GNUC_UNUSED GtkDialog *dialog,
+				       G_GNUC_UNUSED gint	arg1,
+				       gpointer			data)
+{
+	GimmixTagBatch *batch = data;
+
+	/* the remaining jobs are skipped, the files already written stay */
+	g_atomic_int_set (&batch->cancelled, 1);
+
+	return;
+}
+
+static void
+gimmix_tag_batch_run (GimmixTagBatchForm *form)
+{
+	GimmixTagBatch	*batch;
+	GtkWidget	*vbox;
+	GList		*l;
+	guint		track;
+	const gchar	*music_dir;
+
+	/* the selection is relative to the music directory */
+	music_dir = cfg_get_key_value (conf, "music_directory");
+	if (music_dir == NULL || *music_dir == '\0')
+	{
+		gimmix_tag_editor_error (dir_error);
+		return;
+	}
+
+	batch = g_new0 (GimmixTagBatch, 1);
+	batch->errors = g_ptr_array_new_with_free_func (g_free);
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(form->artist_check)))
+		batch->artist = g_strstrip (g_strdup (gtk_entry_get_text (GTK_ENTRY(form->artist_entry))));
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(form->album_check)))
+		batch->album = g_strstrip (g_strdup (gtk_entry_get_text (GTK_ENTRY(form->album_entry))));
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(form->genre_check)))
+		batch->genre = g_strstrip (g_strdup (gtk_entry_get_text (GTK_ENTRY(form->genre_entry))));
+	if ((batch->set_year = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(form->year_check))))
+		batch->year = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON(form->year_spin));
+	batch->set_track = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(form->track_check));
+	track = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON(form->track_spin));
+	batch->total = g_list_length (form->files);
+
+	/* progress dialog */
+	batch->dialog = gtk_dialog_new_with_buttons (_("Writing tags"),
+					GTK_WINDOW(main_window),
+					GTK_DIALOG_DESTROY_WITH_PARENT,
+					GTK_STOCK_CANCEL,
+					GTK_RESPONSE_CANCEL,
+					NULL);
+	gtk_window_set_resizable (GTK_WINDOW(batch->dialog), FALSE);
+	g_signal_connect (batch->dialog, "response", G_CALLBACK(cb_gimmix_tag_batch_progress_response), batch);
+	g_signal_connect (batch->dialog, "delete-event", G_CALLBACK(gtk_true), NULL);
+	vbox = GTK_DIALOG(batch->dialog)->vbox;
+	gtk_container_set_border_width (GTK_CONTAINER(vbox), 10);
+	batch->progressbar = gtk_progress_bar_new ();
+	gtk_widget_set_size_request (batch->progressbar, 300, -1);
+	gtk_box_pack_start (GTK_BOX(vbox), batch->progressbar, FALSE, FALSE, 5);
+	gtk_widget_show_all (batch->dialog);
+
+	if (tag_batch_pool == NULL)
+	{
+		tag_batch_pool = g_thread_pool_new ((GFunc)gimmix_tag_batch_write,
+						NULL,
+						TAG_BATCH_MAX_THREADS,
+						FALSE,
+						NULL);
+	}
+
+	for (l = form->files; l != NULL; l = l->next)
+	{
+		GimmixTagBatchJob *job = g_new0 (GimmixTagBatchJob, 1);
+		job->batch = batch;
+		job->path = g_strdup_printf ("%s/%s", music_dir, (gchar*)l->data);
+		job->track = track++;
+		g_thread_pool_push (tag_batch_pool, job, NULL);
+	}
+
+	return;
+}
+
+static void
+cb_gimmix_tag_batch_check_toggled (GtkToggleButton *button, gpointer data)
+{
+	gtk_widget_set_sensitive (GTK_WIDGET(data), gtk_toggle_button_get_active (button));
+
+	return;
+}
+
+static void
+cb_gimmix_tag_batch_response (GtkDialog *dialog, gint arg1, gpointer data)
+{
+	GimmixTagBatchForm *form = data;
+
+	if (arg1 == GTK_RESPONSE_ACCEPT)
+		gimmix_tag_batch_run (form);
+
+	gtk_widget_destroy (GTK_WIDGET(dialog));
+	g_list_foreach (form->files, (GFunc)g_free, NULL);
+	g_list_free (form->files);
+	g_free (form);
+
+	return;
+}
+
+static void
+gimmix_tag_batch_form_add_row (GtkWidget   *table,
+			       guint	    row,
+			       const gchar *label,
+			       GtkWidget   *value,
+			       GtkWidget  **check)
+{
+	*check = gtk_check_button_new_with_label (label);
+	gtk_widget_set_sensitive (value, FALSE);
+	g_signal_connect (*check, "toggled", G_CALLBACK(cb_gimmix_tag_batch_check_toggled), value);
+	gtk_table_attach (GTK_TABLE(table), *check, 0, 1, row, row+1, GTK_FILL, GTK_FILL, 4, 2);
+	gtk_table_attach (GTK_TABLE(table), value, 1, 2, row, row+1, GTK_EXPAND|GTK_FILL, GTK_FILL, 4, 2);
+
+	return;
+}
+
+void
+gimmix_tag_editor_batch_show (GList *files)
+{
+	GimmixTagBatchForm	*form;
+	GtkWidget		*dialog;
+	GtkWidget		*table;
+	GtkWidget		*label;
+	gchar			*text;
+
+	if (files == NULL)
+		return;
+
+	form = g_new0 (GimmixTagBatchForm, 1);
+	form->files = files;
+
+	dialog = gtk_dialog_new_with_buttons (_("Edit tags"),
+					GTK_WINDOW(main_window),
+					GTK_DIALOG_DESTROY_WITH_PARENT,
+					GTK_STOCK_CANCEL,
+					GTK_RESPONSE_REJECT,
+					GTK_STOCK_SAVE,
+					GTK_RESPONSE_ACCEPT,
+					NULL);
+	gtk_window_set_resizable (GTK_WINDOW(dialog), FALSE);
+	gtk_container_set_border_width (GTK_CONTAINER(GTK_DIALOG(dialog)->vbox), 10);
+
+	text = g_strdup_printf (_("Only the checked fields will be changed in all %d files."), g_list_length (files));
+	label = gtk_label_new (text);
+	g_free (text);
+	gtk_misc_set_padding (GTK_MISC(label), 5, 5);
+	gtk_box_pack_start (GTK_BOX(GTK_DIALOG(dialog)->vbox), label, FALSE, FALSE, 0);
+
+	table = gtk_table_new (5, 2, FALSE);
+	form->artist_entry = gtk_entry_new ();
+	gimmix_tag_batch_form_add_row (table, 0, _("Artist"), form->artist_entry, &form->artist_check);
+	form->album_entry = gtk_entry_new ();
+	gimmix_tag_batch_form_add_row (table, 1, _("Album"), form->album_entry, &form->album_check);
+	form->year_spin = gtk_spin_button_new_with_range (0, 9999, 1);
+	gimmix_tag_batch_form_add_row (table, 2, _("Year"), form->year_spin, &form->year_check);
+	form->genre_entry = gtk_entry_new ();
+	gimmix_tag_batch_form_add_row (table, 3, _("Genre"), form->genre_entry, &form->genre_check);
+	form->track_spin = gtk_spin_button_new_with_range (1, 9999, 1);
+	gimmix_tag_batch_form_add_row (table, 4, _("Number tracks from"), form->track_spin, &form->track_check);
+	gtk_box_pack_start (GTK_BOX(GTK_DIALOG(dialog)->vbox), table, TRUE, TRUE, 0);
+
+	g_signal_connect (dialog, "response", G_CALLBACK(cb_gimmix_tag_batch_response), form);
+	gtk_widget_show_all (dialog);
+
+	return;
+}
+#endif
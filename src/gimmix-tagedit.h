@@ -10,8 +10,8 @@
 #include "gimmix.h"
 #include "gimmix-prefs.h"
 
-/* Initialize the tag editor signals */
-void gimmix_tag_editor_widgets_init (void);
+/* Initialize the tag editor, its window is built on first use */
+void gimmix_tag_editor_init (void);
 
 /* populate the tag editor window */
 gboolean gimmix_tag_editor_populate (const void *);
@@ -25,4 +25,10 @@ void gimmix_tag_editor_error (const gchar *);
 /* Set cover image */
 void gimmix_tag_editor_set_cover_image (GdkPixbuf *);
 
+#ifdef HAVE_TAGEDITOR
+/* Edit the tags of several files at once.
+ * Takes ownership of the list of paths (relative to the music directory) */
+void gimmix_tag_editor_batch_show (GList *);
+#endif
+
 #endif
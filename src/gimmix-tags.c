@@ -0,0 +1,629 @@
+/*
+ * gimmix-tags.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gimmix-tags.h"
+#include "gimmix-mpdio.h"
+#include "gimmix-intern.h"
+#include "gimmix-dispatch.h"
+#include "gimmix-trace.h"
+
+/* first line of the file the index is kept in */
+#define TAGS_MAGIC		"gimmix-tags 1"
+
+/* fields of a song line in that file, tab separated:
+ * file, title, track, time and the facets in GimmixTagFacet order */
+#define TAGS_FIELDS		(4 + GIMMIX_TAG_FACETS)
+
+typedef struct _tag_index {
+	GPtrArray	*songs;				/* GimmixTagSong, in browse order */
+	GHashTable	*values[GIMMIX_TAG_FACETS];	/* value -> GArray of song indices */
+	GPtrArray	*sorted[GIMMIX_TAG_FACETS];	/* values in display order, built on first use */
+	glong		db_update;
+} TagIndex;
+
+typedef struct _tag_sort_key {
+	gchar		*key;
+	const gchar	*value;
+} TagSortKey;
+
+/* Parsing, sorting, loading and saving an index of a large database
+ * takes long enough to be felt, a worker does it and hands the index
+ * back to the main loop. */
+typedef struct _tags_job {
+	gchar		*path;		/* cache file, may be NULL */
+	gchar		**lines;	/* listallinfo reply to build from, NULL to load the cache */
+	gboolean	build;
+	glong		stamp;
+	TagIndex	*index;		/* the result, NULL if there is none */
+} TagsJob;
+
+static GimmixTagsReady	tags_ready = NULL;
+static gpointer		tags_data = NULL;
+static gchar		*tags_path = NULL;
+
+static TagIndex		*tags_index = NULL;
+static gboolean		tags_disk_tried = FALSE;
+static glong		tags_stamp = -1;	/* update time of the database being listed */
+
+/* a refresh is on its way, another one was asked for meanwhile */
+static gboolean		tags_pending = FALSE;
+static gboolean		tags_again = FALSE;
+
+static void
+gimmix_tag_song_free (GimmixTagSong *song)
+{
+	g_free (song->file);
+	g_free (song->title);
+	g_free (song);
+
+	return;
+}
+
+static TagIndex *
+tag_index_new (void)
+{
+	TagIndex	*index;
+	gint		f;
+
+	index = g_new0 (TagIndex, 1);
+	index->songs = g_ptr_array_new_with_free_func ((GDestroyNotify)gimmix_tag_song_free);
+	for (f = 0; f < GIMMIX_TAG_FACETS; f++)
+		index->values[f] = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify)gimmix_intern_unref, (GDestroyNotify)g_array_unref);
+	index->db_update = -1;
+
+	return index;
+}
+
+static void
+tag_index_free (TagIndex *index)
+{
+	gint f;
+
+	if (index == NULL)
+		return;
+
+	/* songs point into the value tables, drop them first */
+	g_ptr_array_free (index->songs, TRUE);
+	for (f = 0; f < GIMMIX_TAG_FACETS; f++)
+	{
+		if (index->sorted[f] != NULL)
+			g_ptr_array_free (index->sorted[f], TRUE);
+		g_hash_table_destroy (index->values[f]);
+	}
+	g_free (index);
+
+	return;
+}
+
+/* every distinct value is listed once per facet, songs share it and
+ * the string itself comes from the pool the queue view uses too */
+static const gchar *
+tag_index_intern (TagIndex *index, GimmixTagFacet facet, const gchar *value)
+{
+	gpointer key;
+
+	if (value == NULL || *value == '\0')
+		return NULL;
+	if (g_hash_table_lookup_extended (index->values[facet], value, &key, NULL))
+		return key;
+
+	key = (gpointer)gimmix_intern (value);
+	g_hash_table_insert (index->values[facet], key, g_array_new (FALSE, FALSE, sizeof(guint)));
+
+	return key;
+}
+
+static const gchar *
+tag_index_intern_year (TagIndex *index, const gchar *date)
+{
+	gchar		year[5];
+	const gchar	*ret;
+
+	/* a date may be 2009-05-11, the facet only needs the year */
+	if (strlen (date) > 4 && g_ascii_isdigit (date[0]) && g_ascii_isdigit (date[1]) &&
+		g_ascii_isdigit (date[2]) && g_ascii_isdigit (date[3]))
+	{
+		memcpy (year, date, 4);
+		year[4] = '\0';
+		ret = tag_index_intern (index, GIMMIX_TAG_YEAR, year);
+	}
+	else
+		ret = tag_index_intern (index, GIMMIX_TAG_YEAR, date);
+
+	return ret;
+}
+
+static gint
+tag_song_compare (gconstpointer a, gconstpointer b)
+{
+	const GimmixTagSong	*sa = *(GimmixTagSong**)a;
+	const GimmixTagSong	*sb = *(GimmixTagSong**)b;
+	gint			ret;
+
+	if ((ret = g_strcmp0 (sa->tags[GIMMIX_TAG_ALBUM_ARTIST], sb->tags[GIMMIX_TAG_ALBUM_ARTIST])))
+		return ret;
+	if ((ret = g_strcmp0 (sa->tags[GIMMIX_TAG_ALBUM], sb->tags[GIMMIX_TAG_ALBUM])))
+		return ret;
+	if (sa->track != sb->track)
+		return (sa->track < sb->track) ? -1 : 1;
+
+	return strcmp (sa->file, sb->file);
+}
+
+/* put the songs in browse order and list them under their values, after
+ * this a selection is a single lookup */
+static void
+tag_index_finish (TagIndex *index)
+{
+	guint	i;
+	gint	f;
+
+	for (i = 0; i < index->songs->len; i++)
+	{
+		GimmixTagSong *song = g_ptr_array_index (index->songs, i);
+
+		/* mpd does the same when a song has no album artist */
+		if (song->tags[GIMMIX_TAG_ALBUM_ARTIST] == NULL)
+			song->tags[GIMMIX_TAG_ALBUM_ARTIST] = tag_index_intern (index, GIMMIX_TAG_ALBUM_ARTIST, song->tags[GIMMIX_TAG_ARTIST]);
+	}
+	g_ptr_array_sort (index->songs, tag_song_compare);
+
+	for (i = 0; i < index->songs->len; i++)
+	{
+		GimmixTagSong *song = g_ptr_array_index (index->songs, i);
+
+		for (f = 0; f < GIMMIX_TAG_FACETS; f++)
+		{
+			if (song->tags[f] != NULL)
+				g_array_append_val (g_hash_table_lookup (index->values[f], song->tags[f]), i);
+		}
+	}
+
+	return;
+}
+
+/* build an index from the lines of a listallinfo reply */
+static TagIndex *
+tag_index_parse (gchar **lines)
+{
+	TagIndex	*index;
+	GimmixTagSong	*song = NULL;
+	guint		i;
+
+	index = tag_index_new ();
+	for (i = 0; lines[i] != NULL; i++)
+	{
+		const char	*line = lines[i];
+		const char	*value = strstr (line, ": ");
+
+		if (value == NULL)
+			continue;
+		value += 2;
+		if (!strncmp (line, "file: ", 6))
+		{
+			song = g_new0 (GimmixTagSong, 1);
+			song->file = g_strdup (value);
+			g_ptr_array_add (index->songs, song);
+		}
+		else if (!strncmp (line, "directory: ", 11) || !strncmp (line, "playlist: ", 10))
+			song = NULL;
+		else if (song == NULL)
+			continue;
+		else if (!strncmp (line, "Title: ", 7) && song->title == NULL)
+			song->title = g_strdup (value);
+		else if (!strncmp (line, "Track: ", 7))
+			song->track = atoi (value);
+		else if (!strncmp (line, "Time: ", 6))
+			song->time = atoi (value);
+		else if (!strncmp (line, "Artist: ", 8) && song->tags[GIMMIX_TAG_ARTIST] == NULL)
+			song->tags[GIMMIX_TAG_ARTIST] = tag_index_intern (index, GIMMIX_TAG_ARTIST, value);
+		else if (!strncmp (line, "AlbumArtist: ", 13) && song->tags[GIMMIX_TAG_ALBUM_ARTIST] == NULL)
+			song->tags[GIMMIX_TAG_ALBUM_ARTIST] = tag_index_intern (index, GIMMIX_TAG_ALBUM_ARTIST, value);
+		else if (!strncmp (line, "Album: ", 7) && song->tags[GIMMIX_TAG_ALBUM] == NULL)
+			song->tags[GIMMIX_TAG_ALBUM] = tag_index_intern (index, GIMMIX_TAG_ALBUM, value);
+		else if (!strncmp (line, "Genre: ", 7) && song->tags[GIMMIX_TAG_GENRE] == NULL)
+			song->tags[GIMMIX_TAG_GENRE] = tag_index_intern (index, GIMMIX_TAG_GENRE, value);
+		else if (!strncmp (line, "Date: ", 6) && song->tags[GIMMIX_TAG_YEAR] == NULL)
+			song->tags[GIMMIX_TAG_YEAR] = tag_index_intern_year (index, value);
+	}
+	tag_index_finish (index);
+
+	return index;
+}
+
+static void
+tag_index_append_field (GString *out, const gchar *value)
+{
+	const gchar *p;
+
+	/* mpd values never hold a newline, tabs would split the field */
+	for (p = value ? value : ""; *p != '\0'; p++)
+		g_string_append_c (out, (*p == '\t') ? ' ' : *p);
+
+	return;
+}
+
+static void
+tag_index_save (TagIndex *index, const gchar *path)
+{
+	GString	*out;
+	GError	*error = NULL;
+	guint	i;
+	gint	f;
+
+	out = g_string_sized_new (index->songs->len * 128);
+	g_string_append_printf (out, "%s %ld %u\n", TAGS_MAGIC, index->db_update, index->songs->len);
+	for (i = 0; i < index->songs->len; i++)
+	{
+		GimmixTagSong *song = g_ptr_array_index (index->songs, i);
+
+		tag_index_append_field (out, song->file);
+		g_string_append_c (out, '\t');
+		tag_index_append_field (out, song->title);
+		g_string_append_printf (out, "\t%d\t%d", song->track, song->time);
+		for (f = 0; f < GIMMIX_TAG_FACETS; f++)
+		{
+			g_string_append_c (out, '\t');
+			tag_index_append_field (out, song->tags[f]);
+		}
+		g_string_append_c (out, '\n');
+	}
+
+	if (!g_file_set_contents (path, out->str, out->len, &error))
+	{
+		fprintf (stderr, "tags: %s\n", error->message);
+		g_error_free (error);
+	}
+	g_string_free (out, TRUE);
+
+	return;
+}
+
+/* read back what tag_index_save wrote, NULL if there is nothing usable */
+static TagIndex *
+tag_index_load (const gchar *path)
+{
+	TagIndex	*index;
+	gchar		*contents;
+	gchar		*line;
+	gchar		*next;
+	gchar		*field[TAGS_FIELDS];
+	glong		db_update;
+	guint		count;
+	gint		f;
+
+	if (!g_file_get_contents (path, &contents, NULL, NULL))
+		return NULL;
+	if (sscanf (contents, TAGS_MAGIC " %ld %u", &db_update, &count) != 2 ||
+		(line = strchr (contents, '\n')) == NULL)
+	{
+		g_free (contents);
+		return NULL;
+	}
+
+	index = tag_index_new ();
+	index->db_update = db_update;
+	for (line++; *line != '\0'; line = next)
+	{
+		GimmixTagSong	*song;
+
+		if ((next = strchr (line, '\n')) == NULL)
+			break;
+		*next++ = '\0';
+
+		/* split in place */
+		for (f = 0; f < TAGS_FIELDS; f++)
+		{
+			field[f] = line;
+			if ((line = strchr (line, '\t')) == NULL)
+				break;
+			*line++ = '\0';
+		}
+		if (f != TAGS_FIELDS - 1)
+			continue;
+
+		song = g_new0 (GimmixTagSong, 1);
+		song->file = g_strdup (field[0]);
+		song->title = *field[1] ? g_strdup (field[1]) : NULL;
+		song->track = atoi (field[2]);
+		song->time = atoi (field[3]);
+		for (f = 0; f < GIMMIX_TAG_FACETS; f++)
+			song->tags[f] = tag_index_intern (index, f, field[4 + f]);
+		g_ptr_array_add (index->songs, song);
+	}
+	g_free (contents);
+
+	/* a truncated file is as good as none */
+	if (index->songs->len != count)
+	{
+		tag_index_free (index);
+		return NULL;
+	}
+	/* saved in browse order already */
+	for (count = 0; count < index->songs->len; count++)
+	{
+		GimmixTagSong *song = g_ptr_array_index (index->songs, count);
+
+		for (f = 0; f < GIMMIX_TAG_FACETS; f++)
+		{
+			if (song->tags[f] != NULL)
+				g_array_append_val (g_hash_table_lookup (index->values[f], song->tags[f]), count);
+		}
+	}
+
+	return index;
+}
+
+void
+gimmix_tags_init (const gchar *cache_path, GimmixTagsReady ready, gpointer data)
+{
+	tags_path = g_strdup (cache_path);
+	tags_ready = ready;
+	tags_data = data;
+
+	return;
+}
+
+static void cb_tags_stats (const GimmixMpdReply *reply, gpointer data);
+
+static void
+gimmix_tags_job_done (TagsJob *job)
+{
+	if (job->index != NULL)
+	{
+		tag_index_free (tags_index);
+		tags_index = job->index;
+		job->index = NULL;
+		if (tags_ready != NULL)
+			tags_ready (tags_data);
+	}
+
+	/* the cache is loaded, now see whether it is still current */
+	if (!job->build)
+	{
+		gimmix_mpdio_command (cb_tags_stats, NULL, "stats");
+		return;
+	}
+
+	tags_pending = FALSE;
+	if (tags_again)
+	{
+		tags_again = FALSE;
+		gimmix_tags_refresh ();
+	}
+
+	return;
+}
+
+static void
+gimmix_tags_job_free (TagsJob *job)
+{
+	tag_index_free (job->index);
+	g_strfreev (job->lines);
+	g_free (job->path);
+	g_free (job);
+
+	return;
+}
+
+static const GimmixResultType tags_job_type = {
+	"tags",
+	(void (*) (gpointer))gimmix_tags_job_done,
+	(GDestroyNotify)gimmix_tags_job_free,
+	FALSE
+};
+
+static gpointer
+gimmix_tags_job_thread (TagsJob *job)
+{
+	gimmix_trace_thread_name ("tags");
+	if (job->build)
+	{
+		GIMMIX_TRACE ("tags", "parse", job->index = tag_index_parse (job->lines));
+		g_strfreev (job->lines);
+		job->lines = NULL;
+		job->index->db_update = job->stamp;
+		if (job->path != NULL)
+			GIMMIX_TRACE ("tags", "save", tag_index_save (job->index, job->path));
+	}
+	else
+	{
+		GIMMIX_TRACE ("tags", "load", job->index = tag_index_load (job->path));
+	}
+	gimmix_dispatch_post (&tags_job_type, job);
+
+	return NULL;
+}
+
+static void
+gimmix_tags_job_start (gchar **lines, glong stamp)
+{
+	TagsJob *job;
+
+	job = g_new0 (TagsJob, 1);
+	job->path = g_strdup (tags_path);
+	job->lines = lines;
+	job->build = (lines != NULL);
+	job->stamp = stamp;
+	g_thread_unref (g_thread_new ("tags", (GThreadFunc)gimmix_tags_job_thread, job));
+
+	return;
+}
+
+static void
+cb_tags_listed (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	if (!reply->ok)
+	{
+		fprintf (stderr, "listallinfo: %s\n", reply->error);
+		tags_pending = FALSE;
+		if (tags_again)
+		{
+			tags_again = FALSE;
+			gimmix_tags_refresh ();
+		}
+		return;
+	}
+
+	/* still pending until the worker is done with it */
+	gimmix_tags_job_start (gimmix_mpd_reply_steal_lines (reply), tags_stamp);
+
+	return;
+}
+
+static void
+cb_tags_stats (const GimmixMpdReply *reply, G_GNUC_UNUSED gpointer data)
+{
+	guint i;
+
+	tags_stamp = -1;
+	for (i = 0; reply->ok && reply->lines[i] != NULL; i++)
+	{
+		if (!strncmp (reply->lines[i], "db_update: ", 11))
+			tags_stamp = atol (reply->lines[i] + 11);
+	}
+
+	/* the index we have is still current */
+	if (!reply->ok || (tags_index != NULL && tags_index->db_update == tags_stamp))
+	{
+		tags_pending = FALSE;
+		if (tags_again)
+		{
+			tags_again = FALSE;
+			gimmix_tags_refresh ();
+		}
+		return;
+	}
+
+	gimmix_mpdio_command (cb_tags_listed, NULL, "listallinfo");
+
+	return;
+}
+
+void
+gimmix_tags_refresh (void)
+{
+	if (tags_pending)
+	{
+		tags_again = TRUE;
+		return;
+	}
+	tags_pending = TRUE;
+
+	/* the first time the cache is read before asking the server */
+	if (!tags_disk_tried)
+	{
+		tags_disk_tried = TRUE;
+		if (tags_path != NULL)
+		{
+			gimmix_tags_job_start (NULL, -1);
+			return;
+		}
+	}
+	gimmix_mpdio_command (cb_tags_stats, NULL, "stats");
+
+	return;
+}
+
+gboolean
+gimmix_tags_loaded (void)
+{
+	return (tags_index != NULL);
+}
+
+static gint
+tag_sort_key_compare (gconstpointer a, gconstpointer b)
+{
+	return strcmp (((TagSortKey*)a)->key, ((TagSortKey*)b)->key);
+}
+
+GPtrArray *
+gimmix_tags_get_values (GimmixTagFacet facet)
+{
+	GHashTableIter	iter;
+	TagSortKey	*keys;
+	GPtrArray	*sorted;
+	gpointer	value;
+	guint		n;
+	guint		i;
+
+	if (tags_index == NULL)
+		return NULL;
+	if (tags_index->sorted[facet] != NULL)
+		return tags_index->sorted[facet];
+
+	/* collation keys are made once per value instead of per comparison */
+	n = g_hash_table_size (tags_index->values[facet]);
+	keys = g_new (TagSortKey, n);
+	g_hash_table_iter_init (&iter, tags_index->values[facet]);
+	for (i = 0; g_hash_table_iter_next (&iter, &value, NULL); i++)
+	{
+		keys[i].value = value;
+		keys[i].key = g_utf8_collate_key (value, -1);
+	}
+	qsort (keys, n, sizeof(TagSortKey), tag_sort_key_compare);
+
+	sorted = g_ptr_array_sized_new (n);
+	for (i = 0; i < n; i++)
+	{
+		g_ptr_array_add (sorted, (gpointer)keys[i].value);
+		g_free (keys[i].key);
+	}
+	g_free (keys);
+	tags_index->sorted[facet] = sorted;
+
+	return sorted;
+}
+
+GArray *
+gimmix_tags_get_songs (GimmixTagFacet facet, const gchar *value)
+{
+	if (tags_index == NULL || value == NULL)
+		return NULL;
+
+	return g_hash_table_lookup (tags_index->values[facet], value);
+}
+
+const GimmixTagSong *
+gimmix_tags_get_song (guint index)
+{
+	if (tags_index == NULL || index >= tags_index->songs->len)
+		return NULL;
+
+	return g_ptr_array_index (tags_index->songs, index);
+}
+
+void
+gimmix_tags_cleanup (void)
+{
+	tag_index_free (tags_index);
+	tags_index = NULL;
+	g_free (tags_path);
+	tags_path = NULL;
+
+	return;
+}
@@ -0,0 +1,51 @@
+#ifndef GIMMIX_TAGS_H
+#define GIMMIX_TAGS_H
+
+#include <glib.h>
+
+/* An in-memory index of the whole database by tag, built from one
+ * listallinfo and kept on disk between sessions. It is only fetched
+ * again when mpd reports a different database update time. */
+
+typedef enum {
+	GIMMIX_TAG_ARTIST = 0,
+	GIMMIX_TAG_ALBUM_ARTIST,
+	GIMMIX_TAG_ALBUM,
+	GIMMIX_TAG_GENRE,
+	GIMMIX_TAG_YEAR,
+	GIMMIX_TAG_FACETS
+} GimmixTagFacet;
+
+typedef struct _gimmix_tag_song {
+	gchar		*file;
+	gchar		*title;
+	gint		track;
+	gint		time;
+	const gchar	*tags[GIMMIX_TAG_FACETS];	/* owned by the index, NULL if unset */
+} GimmixTagSong;
+
+/* Called from the main loop whenever the index has been (re)built */
+typedef void (*GimmixTagsReady) (gpointer data);
+
+/* cache_path is where the index is kept between sessions */
+void gimmix_tags_init (const gchar *cache_path, GimmixTagsReady ready, gpointer data);
+
+/* load the index from disk the first time and check it against the
+ * server, it is rebuilt if the database changed. Both happen in the
+ * background, ready is called once the index is there */
+void gimmix_tags_refresh (void);
+
+gboolean gimmix_tags_loaded (void);
+
+/* distinct values of a facet in display order, owned by the index */
+GPtrArray *gimmix_tags_get_values (GimmixTagFacet facet);
+
+/* indices of the songs tagged with value, ordered by album artist,
+ * album and track. NULL if there are none */
+GArray *gimmix_tags_get_songs (GimmixTagFacet facet, const gchar *value);
+
+const GimmixTagSong *gimmix_tags_get_song (guint index);
+
+void gimmix_tags_cleanup (void);
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * gimmix-trace.c
+ *
+ * Copyright (C) 2006-2009 Priyank Gosalia
+ * Copyright (C) 2012-2013 Christoph Mende
+ *
+ * Gimmix is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * Gimmix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Gimmix; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "gimmix-trace.h"
+
+/* Events are kept in memory and only written out on exit, so tracing
+ * costs a timestamp and an array append per span. With GIMMIX_TRACE
+ * unset gimmix_trace_now () returns 0 and nothing is recorded.
+ */
+
+typedef struct _trace_event {
+	const char	*cat;
+	const char	*name;
+	gint64		start;
+	gint64		dur;
+	guint		tid;
+} TraceEvent;
+
+typedef struct _trace_thread {
+	guint		tid;
+	const char	*name;
+} TraceThread;
+
+static gchar		*trace_file = NULL;
+static gint64		trace_origin = 0;
+static GArray		*trace_events = NULL;
+static GPtrArray	*trace_threads = NULL;
+static GMutex		trace_mutex;
+static guint		trace_next_tid = 0;
+
+/* the TraceThread of the calling thread, owned by trace_threads */
+static GPrivate		trace_thread_key = G_PRIVATE_INIT (NULL);
+
+void
+gimmix_trace_init (void)
+{
+	const char *file = g_getenv ("GIMMIX_TRACE");
+
+	if (file == NULL || *file == '\0')
+		return;
+
+	trace_file = g_strdup (file);
+	trace_origin = g_get_monotonic_time ();
+	trace_events = g_array_sized_new (FALSE, FALSE, sizeof(TraceEvent), 1024);
+	trace_threads = g_ptr_array_new_with_free_func (g_free);
+	gimmix_trace_thread_name ("main");
+
+	return;
+}
+
+gint64
+gimmix_trace_now (void)
+{
+	if (trace_file == NULL)
+		return 0;
+
+	return g_get_monotonic_time ();
+}
+
+/* call with trace_mutex held */
+static TraceThread*
+gimmix_trace_get_thread (void)
+{
+	TraceThread *thread = g_private_get (&trace_thread_key);
+
+	if (thread == NULL)
+	{
+		thread = g_new0 (TraceThread, 1);
+		thread->tid = ++trace_next_tid;
+		g_ptr_array_add (trace_threads, thread);
+		g_private_set (&trace_thread_key, thread);
+	}
+
+	return thread;
+}
+
+void
+gimmix_trace_thread_name (const char *name)
+{
+	if (trace_file == NULL)
+		return;
+
+	g_mutex_lock (&trace_mutex);
+	if (trace_threads != NULL)
+		gimmix_trace_get_thread ()->name = name;
+	g_mutex_unlock (&trace_mutex);
+
+	return;
+}
+
+void
+gimmix_trace_event (const char *cat, const char *name, gint64 start)
+{
+	TraceEvent	ev;
+	gint64		now;
+
+	if (start == 0 || trace_file == NULL)
+		return;
+
+	now = g_get_monotonic_time ();
+	ev.cat = cat;
+	ev.name = name;
+	ev.start = start - trace_origin;
+	ev.dur = now - start;
+
+	g_mutex_lock (&trace_mutex);
+	if (trace_events != NULL)
+	{
+		ev.tid = gimmix_trace_get_thread ()->tid;
+		g_array_append_val (trace_events, ev);
+	}
+	g_mutex_unlock (&trace_mutex);
+
+	return;
+}
+
+static void
+gimmix_trace_write_string (FILE *fp, const char *str)
+{
+	fputc ('"', fp);
+	for (; str && *str; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			fputc ('\\', fp);
+		if ((guchar)*str < 0x20)
+			fprintf (fp, "\\u%04x", *str);
+		else
+			fputc (*str, fp);
+	}
+	fputc ('"', fp);
+
+	return;
+}
+
+void
+gimmix_trace_cleanup (void)
+{
+	FILE		*fp;
+	const char	*sep = "";
+	int		pid;
+	guint		i;
+
+	if (trace_file == NULL)
+		return;
+
+	g_mutex_lock (&trace_mutex);
+	fp = fopen (trace_file, "w");
+	if (fp == NULL)
+	{
+		g_warning ("Could not write trace to %s", trace_file);
+	}
+	else
+	{
+		pid = getpid ();
+		fprintf (fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		for (i = 0; i < trace_threads->len; i++)
+		{
+			TraceThread *thread = g_ptr_array_index (trace_threads, i);
+
+			fprintf (fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":",
+				sep, pid, thread->tid);
+			gimmix_trace_write_string (fp, thread->name ? thread->name : "worker");
+			fprintf (fp, "}}");
+			sep = ",\n";
+		}
+		for (i = 0; i < trace_events->len; i++)
+		{
+			TraceEvent *ev = &g_array_index (trace_events, TraceEvent, i);
+
+			fprintf (fp, "%s{\"ph\":\"X\",\"cat\":", sep);
+			gimmix_trace_write_string (fp, ev->cat);
+			fprintf (fp, ",\"name\":");
+			gimmix_trace_write_string (fp, ev->name);
+			fprintf (fp, ",\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%u}",
+				ev->start, ev->dur, pid, ev->tid);
+			sep = ",\n";
+		}
+		fprintf (fp, "\n]}\n");
+		fclose (fp);
+	}
+
+	g_array_free (trace_events, TRUE);
+	trace_events = NULL;
+	g_ptr_array_free (trace_threads, TRUE);
+	trace_threads = NULL;
+	g_free (trace_file);
+	trace_file = NULL;
+	g_mutex_unlock (&trace_mutex);
+
+	return;
+}
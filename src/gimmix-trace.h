@@ -0,0 +1,35 @@
+#ifndef GIMMIX_TRACE_H
+#define GIMMIX_TRACE_H
+
+#include <glib.h>
+
+/* Tracing is enabled by pointing GIMMIX_TRACE at the output file.
+ * The timeline is written in Chrome's trace event format on exit and
+ * can be loaded in chrome://tracing or Perfetto. */
+
+/* read the environment, call before anything is traced */
+void gimmix_trace_init (void);
+
+/* write the trace file and stop tracing */
+void gimmix_trace_cleanup (void);
+
+/* current timestamp for gimmix_trace_event (), 0 when tracing is off */
+gint64 gimmix_trace_now (void);
+
+/* record a span from start until now on the calling thread.
+ * name must be a static or interned string */
+void gimmix_trace_event (const char *cat, const char *name, gint64 start);
+
+/* name the calling thread in the timeline */
+void gimmix_trace_thread_name (const char *name);
+
+/* trace a statement, e.g.
+ * GIMMIX_TRACE ("startup", "gimmix_config_init", gimmix_config_init ()); */
+#define GIMMIX_TRACE(cat, name, stmt)				\
+	G_STMT_START {						\
+		gint64 trace_start_ = gimmix_trace_now ();	\
+		stmt;						\
+		gimmix_trace_event (cat, name, trace_start_);	\
+	} G_STMT_END
+
+#endif
@@ -26,6 +26,7 @@
 #include <locale.h>
 #include <getopt.h>
 #include <libgen.h>
+#include <unistd.h>
 
 #ifdef HAVE_CONFIG_H
 #	include "config.h"
@@ -35,8 +36,14 @@
 #include "gimmix-firstrun.h"
 #include "gimmix-interface.h"
 #include "gimmix-playlist.h"
+#include "gimmix-dispatch.h"
+#include "gimmix-mpdio.h"
+#include "gimmix-net.h"
+#include "gimmix-trace.h"
+#include "gimmix-stats.h"
 
-#define UI_FILE		"share/gimmix/gimmix.ui"
+#define UI_DIR		"share/gimmix"
+#define UI_FILE		"gimmix.ui"
 #define GIMMIX_ICON	"gimmix.png"
 
 MpdObj 		*gmo = NULL;
@@ -48,7 +55,31 @@ GtkWidget	*connection_box = NULL;
 extern GtkWidget	*main_window;
 extern ConfigFile 	conf;
 
+/* reconnect backoff, in milliseconds */
+#define RECONNECT_DELAY_MIN	500
+#define RECONNECT_DELAY_MAX	30000
+
+/* the mpd object of a dropped connection, freed on the next attempt */
+static MpdObj	*stale_gmo = NULL;
+static guint	reconnect_source = 0;
+static guint	reconnect_attempt = 0;
+static gboolean	connect_job_running = FALSE;
+
+/* overall timeout of a connection attempt, in milliseconds */
+#define CONNECT_TIMEOUT		5000
+
+typedef struct _gimmix_connect_job {
+	gchar		*host;
+	gchar		*pass;
+	int		port;
+	gchar		*addr;		/* numeric address that answered */
+	int		fd;		/* its socket, handed to the I/O thread */
+	MpdObj		*mo;		/* NULL if the attempt failed */
+	gchar		*error;
+} GimmixConnectJob;
+
 static void gimmix_mpd_connection_changed_callback (MpdObj *mo, int connect, void *userdata);
+static void gimmix_reconnect_schedule (void);
 
 void
 gimmix_error (const char *error_str)
@@ -103,10 +134,13 @@ gimmix_mpd_connection_changed_callback (G_GNUC_UNUSED MpdObj *mo,
 	if (!connect) /* disconnected */
 	{
 		g_print ("disconnected from mpd\n");
-		//mpd_free (gmo);
+		gimmix_mpdio_stop ();
+		/* we're inside a callback of gmo, free it later */
+		stale_gmo = gmo;
 		gmo = NULL;
 		gimmix_interface_disable_controls ();
 		gtk_widget_show (connection_box);
+		gimmix_reconnect_schedule ();
 	}
 	else /* connected */
 	{
@@ -118,51 +152,195 @@ gimmix_mpd_connection_changed_callback (G_GNUC_UNUSED MpdObj *mo,
 	return;
 }
 
-bool
-gimmix_connect (void)
+/* Runs in the main loop when a connection attempt has finished */
+static void
+gimmix_connect_done (GimmixConnectJob *job)
 {
-	char 	*host = NULL;
-	char	*pass = NULL;
-	int	port;
-
-	host = cfg_get_key_value (conf, "mpd_hostname");
-	pass = cfg_get_key_value (conf, "mpd_password");
-	port = atoi (cfg_get_key_value (conf, "mpd_port"));
-	gmo = mpd_new (host, port, pass);
+	connect_job_running = FALSE;
+
+	if (job->mo == NULL)
+	{
+		printf ("%s\n", job->error);
+		g_free (last_error);
+		last_error = g_strdup (job->error);
+		gtk_widget_show (connection_box);
+		reconnect_attempt++;
+		gimmix_reconnect_schedule ();
+		return;
+	}
+
+	printf ("connected to mpd\n");
+	reconnect_attempt = 0;
+	gmo = job->mo;
+	job->mo = NULL;
 	mpd_signal_connect_error (gmo, (ErrorCallback)gimmix_mpd_connection_error_callback, NULL);
-	
-	if (mpd_connect(gmo) == MPD_OK)
+	mpd_signal_connect_connection_changed (gmo, (ConnectionChangedCallback)gimmix_mpd_connection_changed_callback, NULL);
+	/* commands from the interface go through their own connection */
+	gimmix_mpdio_start (job->addr, job->port, job->pass, job->fd);
+	job->fd = -1;
+
+	/* sets up the interface on the first connect, afterwards only
+	 * refreshes what changed while we were away */
+	GIMMIX_TRACE ("startup", "gimmix_resync", gimmix_resync ());
+	gimmix_interface_enable_controls ();
+	gtk_widget_hide (connection_box);
+
+	return;
+}
+
+static void
+gimmix_connect_job_free (GimmixConnectJob *job)
+{
+	if (job->mo)
+		mpd_free (job->mo);
+	if (job->fd >= 0)
+		close (job->fd);
+	g_free (job->host);
+	g_free (job->pass);
+	g_free (job->addr);
+	g_free (job->error);
+	g_free (job);
+
+	return;
+}
+
+static const GimmixResultType connect_result_type = {
+	"connect",
+	(void (*) (gpointer))gimmix_connect_done,
+	(GDestroyNotify)gimmix_connect_job_free,
+	FALSE
+};
+
+static gpointer
+gimmix_connect_thread (GimmixConnectJob *job)
+{
+	MpdObj	*mo;
+	gchar	*where;
+	int	ret;
+
+	gimmix_trace_thread_name ("connect");
+	if (gimmix_net_is_local (job->host))
+		where = g_strdup (job->host);
+	else
+		where = g_strdup_printf ("%s:%d", job->host, job->port);
+
+	/* find an address that answers, then let libmpd connect to it.
+	 * The socket we found it with becomes the I/O thread's connection */
+	GIMMIX_TRACE ("startup", "net_connect",
+		job->fd = gimmix_net_connect (job->host, job->port, CONNECT_TIMEOUT, &job->addr));
+	if (job->fd < 0)
 	{
-		if (mpd_send_password (gmo) != MPD_OK)
-		{
-			return false;
-		}
+		if (!gimmix_net_is_supported (job->host))
+			job->error = g_strdup_printf (_("%s is not supported, use a host name or the path of a unix socket"), job->host);
 		else
-		{
-			printf ("connected to mpd\n");
-			mpd_signal_connect_connection_changed (gmo, (ConnectionChangedCallback)gimmix_mpd_connection_changed_callback, NULL);
-			return true;
-		}
+			job->error = g_strdup_printf (_("Could not connect to %s"), where);
+		goto done;
 	}
-	else
+
+	mo = mpd_new (job->addr, job->port, job->pass);
+	mpd_set_connection_timeout (mo, CONNECT_TIMEOUT / 1000.0);
+	GIMMIX_MPD_CALL ("connect", ret = mpd_connect (mo));
+	if (ret != MPD_OK)
 	{
-		mpd_free (gmo);
-		gmo = NULL;
+		job->error = g_strdup_printf (_("Could not connect to %s"), where);
+		mpd_free (mo);
+		goto done;
+	}
+	GIMMIX_MPD_CALL ("password", ret = mpd_send_password (mo));
+	if (ret != MPD_OK)
+	{
+		job->error = g_strdup (_("Wrong password"));
+		mpd_free (mo);
+		goto done;
 	}
+	job->mo = mo;
 
-	return false;
+	done:
+	g_free (where);
+	gimmix_dispatch_post (&connect_result_type, job);
+
+	return NULL;
+}
+
+void
+gimmix_connect (void)
+{
+	GimmixConnectJob	*job;
+	gchar			*markup;
+
+	if (connect_job_running)
+		return;
+
+	/* the worker gets its own copy of the settings */
+	job = g_new0 (GimmixConnectJob, 1);
+	job->host = g_strdup (cfg_get_key_value (conf, "mpd_hostname"));
+	job->pass = g_strdup (cfg_get_key_value (conf, "mpd_password"));
+	job->port = atoi (cfg_get_key_value (conf, "mpd_port"));
+	job->fd = -1;
+
+	markup = g_markup_printf_escaped (_("<span size=\"medium\"weight=\"bold\">Connecting to %s...</span>"), job->host);
+	gtk_label_set_markup (GTK_LABEL(error_label), markup);
+	g_free (markup);
+
+	connect_job_running = TRUE;
+	g_thread_unref (g_thread_new ("connect",
+				(GThreadFunc)gimmix_connect_thread,
+				job));
+
+	return;
+}
+
+static gboolean
+gimmix_reconnect (G_GNUC_UNUSED gpointer data)
+{
+	reconnect_source = 0;
+	if (stale_gmo != NULL)
+	{
+		mpd_free (stale_gmo);
+		stale_gmo = NULL;
+	}
+	gimmix_connect ();
+
+	return FALSE;
+}
+
+static void
+gimmix_reconnect_schedule (void)
+{
+	guint	delay;
+	gchar	*markup;
+
+	if (reconnect_source)
+		return;
+
+	/* exponential backoff with jitter so that a restarted server is
+	 * not hit by all clients at the same moment */
+	delay = RECONNECT_DELAY_MIN << MIN (reconnect_attempt, 6);
+	delay = MIN (delay, RECONNECT_DELAY_MAX);
+	delay = g_random_int_range (delay / 2, delay + 1);
+
+	markup = g_markup_printf_escaped (_("<span size=\"medium\"weight=\"bold\">Error: not connected, retrying in %d seconds</span>"),
+					(delay + 999) / 1000);
+	gtk_label_set_markup (GTK_LABEL(error_label), markup);
+	g_free (markup);
+
+	reconnect_source = g_timeout_add (delay, gimmix_reconnect, NULL);
+
+	return;
 }
 
 static void
 cb_gimmix_connect_button_clicked (G_GNUC_UNUSED GtkWidget *widget,
 				  G_GNUC_UNUSED gpointer   data)
 {
-	if (gimmix_connect())
+	/* the user doesn't want to wait for the next attempt */
+	if (reconnect_source)
 	{
-		gimmix_interface_enable_controls ();
-		gimmix_init ();
-		gtk_widget_hide (connection_box);
+		g_source_remove (reconnect_source);
+		reconnect_source = 0;
 	}
+	reconnect_attempt = 0;
+	gimmix_reconnect (NULL);
 	
 	return;
 }
@@ -183,7 +361,6 @@ void
 gimmix_about_show (void)
 {
 	GdkPixbuf		*about_pixbuf;
-	gchar			*path;
 	static gchar		*license = 
 	("Gimmix is free software; you can redistribute it and/or "
 	"modify it under the terms of the GNU General Public Licence as "
@@ -200,9 +377,7 @@ gimmix_about_show (void)
 	"Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, "
 	"MA  02110-1301  USA");
 	
-	path = gimmix_get_full_image_path (GIMMIX_ICON);
-	about_pixbuf = gdk_pixbuf_new_from_file (path, NULL);
-	g_free (path);
+	about_pixbuf = gimmix_get_pixbuf (GIMMIX_ICON, -1, -1);
 
 	gchar *authors[] = { "Author(s):\nPriyank M. Gosalia <priyankmg@gmail.com>",
 				"\nwejpconfig (Gimmix's configuration system)\nJohannes Heimansberg <wejpilot@gmail.com>",
@@ -238,15 +413,39 @@ gimmix_about_show (void)
 	return;
 }
 
+GtkBuilder*
+gimmix_ui_load (const char *file)
+{
+	GtkBuilder	*builder;
+	GError		*error = NULL;
+	gchar		*path;
+	guint		ret;
+
+	path = g_strdup_printf ("%s/%s/%s", PREFIX, UI_DIR, file);
+	builder = gtk_builder_new ();
+	GIMMIX_TRACE ("startup", g_intern_string (file),
+		ret = gtk_builder_add_from_file (builder, path, &error));
+	if (!ret)
+	{
+		g_error (_("Failed to initialize interface: %s"), error->message);
+		g_error_free (error);
+		exit_cleanup ();
+	}
+	g_free (path);
+
+	gtk_builder_connect_signals (builder, NULL);
+
+	return builder;
+}
+
 int
 main (int argc, char *argv[])
 {
-	gchar 		*path;
 	char		*lang;
 	int		opt;
 	int		longopt_index;
-	bool		constatus = false;
 	
+	gimmix_trace_init ();
 	lang = getenv ("LC_ALL");
 	if (lang==NULL || lang[0]=='\0')
 		lang = getenv ("LANG");
@@ -281,21 +480,10 @@ main (int argc, char *argv[])
 		}
 	}
 	
-	gdk_threads_init ();
-
-	gtk_init (&argc, &argv);
+	GIMMIX_TRACE ("startup", "gtk_init", gtk_init (&argc, &argv));
+	gimmix_stats_init ();
 	
-	path = g_strdup_printf ("%s/%s", PREFIX, UI_FILE);
-	xml = gtk_builder_new ();
-	GError* error;
-	if (!gtk_builder_add_from_file (xml, path, &error)) {
-		g_error (_("Failed to initialize interface: %s"), error->message);
-		g_error_free(error);
-		exit_cleanup ();
-	}
-	g_free (path);
-	
-	gtk_builder_connect_signals (xml, NULL);
+	xml = gimmix_ui_load (UI_FILE);
 	connection_box = GTK_WIDGET (gtk_builder_get_object (xml, "gimmix_connectionbox"));
 	main_window = GTK_WIDGET (gtk_builder_get_object (xml, "main_window"));
 	error_label = GTK_WIDGET (gtk_builder_get_object (xml, "gimmix_error_label"));
@@ -309,29 +497,23 @@ main (int argc, char *argv[])
 			NULL);
 	if (gimmix_config_exists())
 	{
-		gimmix_config_init (); /* initialize configuration */
-		gimmix_interface_widgets_init ();
+		/* initialize configuration */
+		GIMMIX_TRACE ("startup", "gimmix_config_init", gimmix_config_init ());
+		GIMMIX_TRACE ("startup", "gimmix_interface_widgets_init", gimmix_interface_widgets_init ());
 		gimmix_interface_disable_controls ();
-		constatus = gimmix_connect ();
-		if (constatus)
-		{
-			gimmix_init ();
-			gimmix_interface_enable_controls ();
-			gtk_widget_hide (connection_box);
-		}
-		else
-		{
-			gtk_widget_show (connection_box);
-		}
+		/* the window comes up right away, the connection box tells
+		 * the user what happened to the attempt */
+		gtk_widget_show (connection_box);
+		gimmix_connect ();
 	}
 	else
 	{
 		/* display the first run dialog */
 		gimmix_show_firstrun_dialog (); 
 	}
-	gdk_threads_enter ();
+	/* all widgets are only touched from the main loop, workers hand
+	 * their results over through gimmix-dispatch */
 	gtk_main ();
-	gdk_threads_leave ();
 	
 	cleanup:
 	exit_cleanup ();
@@ -343,9 +525,12 @@ void
 exit_cleanup ()
 {
 	gimmix_interface_cleanup ();
+	gimmix_mpdio_stop ();
+	gimmix_dispatch_cleanup ();
 	if (gmo != NULL)
 		gimmix_disconnect (gmo);
 	gimmix_config_free ();
+	gimmix_trace_cleanup ();
 	
 	return;
 }
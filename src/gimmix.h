@@ -19,8 +19,9 @@
 #define APPNAME 		"Gimmix"
 #define APPURL			"http://cmende.github.com/gimmix"
 
-/* main connect function */
-bool gimmix_connect (void);
+/* main connect function, connects in the background and sets up
+ * the interface once the connection is established */
+void gimmix_connect (void);
 
 /* display connection error */
 void gimmix_connect_error (void);
@@ -31,6 +32,11 @@ void gimmix_error (const char *error_str);
 /* displays the about dialog */
 void gimmix_about_show (void);
 
+/* Load one of the installed interface definitions and connect its
+ * signals. Windows survive the builder, other toplevels must be
+ * packed before it is released. */
+GtkBuilder *gimmix_ui_load (const char *file);
+
 /* Finalize */
 void exit_cleanup (void);
 